@@ -0,0 +1,50 @@
+/*
+ *  ircd-hybrid: an advanced, lightweight Internet Relay Chat Daemon (ircd)
+ *
+ *  Copyright (c) 1997-2022 ircd-hybrid development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ *  USA
+ */
+
+/*! \file ban_index.h
+ * \brief Lookup structures over channel ban, exception and invex lists.
+ * \version $Id$
+ */
+
+#ifndef INCLUDED_ban_index_h
+#define INCLUDED_ban_index_h
+
+struct Ban;
+struct BanList;
+struct Channel;
+struct Client;
+struct Extban;
+
+/*! \brief Bans of one list sharing the fixed tail of their host mask */
+struct BanHost
+{
+  const struct BanList *owner;  /**< List the bans are on */
+  uint32_t hash;  /**< Hash of BanHost::owner and BanHost::suffix */
+  unsigned int len;  /**< Length of BanHost::suffix */
+  dlink_list bans;
+  char suffix[];  /**< Host mask after its last wildcard and the '.' following it; in lower case */
+};
+
+extern void ban_index_add(struct BanList *, struct Ban *);
+extern void ban_index_del(struct BanList *, struct Ban *);
+extern struct Ban *ban_index_find(const struct BanList *, struct Client *, struct Channel *, const struct Extban *);
+extern void ban_index_count_memory(unsigned int *const, size_t *const);
+#endif  /* INCLUDED_ban_index_h */
@@ -55,6 +55,8 @@ enum
 #define ClearJoinFloodNoticed(x) ((x)->flags &= ~JOIN_FLOOD_NOTICED)
 
 struct Client;
+struct BanIndex;
+struct ResvItem;
 
 /*! \brief Mode structure for channels */
 struct Mode
@@ -64,12 +66,18 @@ struct Mode
   char key[KEYLEN + 1];    /**< +k key */
 };
 
+/*! \brief A channel's ban, exception or invex list */
+struct BanList
+{
+  dlink_list list;  /**< All entries, most recently set first */
+  struct BanIndex *index;  /**< Lookup structures over BanList::list, see ban_index.c; NULL while empty */
+};
+
 /*! \brief Channel structure */
 struct Channel
 {
   dlink_node node;
 
-  struct Channel *hnextch;
   struct Mode mode;
 
   char topic[TOPICLEN + 1];
@@ -87,14 +95,20 @@ struct Channel
   dlink_list members_local;  /*!< local members are here too */
   dlink_list members;
   dlink_list invites;
-  dlink_list banlist;
-  dlink_list exceptlist;
-  dlink_list invexlist;
+  struct BanList banlist;
+  struct BanList exceptlist;
+  struct BanList invexlist;
+  uint64_t ban_generation;  /**< Renewed whenever Channel::banlist or Channel::exceptlist change; see clear_ban_cache_channel() */
+
+  const struct ResvItem *resv;  /**< RESV matching Channel::name, or NULL; valid while Channel::resv_generation is current */
+  uint64_t resv_generation;  /**< resv_chan_get_generation() when Channel::resv was looked up */
 
   float number_joined;
 
   char name[CHANNELLEN + 1];
+  char name_folded[CHANNELLEN + 1];  /**< Channel::name in lower case, see irc_fold() */
   size_t name_len;
+  uint32_t name_hash;  /**< hash_folded() of Channel::name_folded */
 };
 
 /*! \brief ChannelMember structure */
@@ -106,6 +120,7 @@ struct ChannelMember
   struct Channel *channel;  /**< Channel pointer */
   struct Client *client;  /**< Client pointer */
   unsigned int flags;  /**< user/channel flags, e.g. CHFL_CHANOP */
+  uint64_t ban_generation;  /**< When the CHFL_BAN_* cache flags were last reset; see check_ban_cache() */
 };
 
 enum { BANSTRLEN = 200 }; /* XXX */
@@ -120,6 +135,12 @@ struct Ban
   char user[USERLEN + 1];
   char host[HOSTLEN + 1];
   char who[NICKLEN + USERLEN + HOSTLEN + 3];
+  struct match_mask *name_mask;  /**< Ban::name, compiled; NULL for matching extbans */
+  struct match_mask *user_mask;  /**< Ban::user, compiled; NULL for matching extbans */
+  struct match_mask *host_mask;  /**< Ban::host, compiled */
+  dlink_node index_node;  /**< Link into the BanList::index bucket the ban is filed in */
+  void *index_bucket;  /**< That bucket */
+  unsigned int index_type;  /**< Kind of bucket; see ban_index.c */
   size_t banstr_len;  /**< Cached string length of Ban::banstr */
   uintmax_t when;  /**< Time this ban has been set; real time */
   struct irc_ssaddr addr;
@@ -131,13 +152,17 @@ extern const dlink_list *channel_get_list(void);
 extern bool channel_check_name(const char *, bool);
 extern int can_send(struct Channel *, struct Client *, struct ChannelMember *, const char *, bool);
 extern bool is_banned(struct Channel *, struct Client *);
-extern bool find_bmask(struct Client *, struct Channel*, const dlink_list *, struct Extban *);
+extern bool find_bmask(struct Client *, struct Channel*, const struct BanList *, struct Extban *);
+extern bool ban_matches(struct Client *, struct Channel *, struct Ban *);
 extern bool member_has_flags(const struct ChannelMember *, const unsigned int);
 
 extern void channel_do_join(struct Client *, char *, char *);
 extern void channel_do_part(struct Client *, char *, const char *);
-extern void remove_ban(struct Ban *, dlink_list *);
-extern void add_user_to_channel(struct Channel *, struct Client *, unsigned int, bool);
+extern struct Ban *ban_make(void);
+extern void ban_free(struct Ban *);
+extern void add_ban(struct Ban *, struct BanList *);
+extern void remove_ban(struct Ban *, struct BanList *);
+extern struct ChannelMember *add_user_to_channel(struct Channel *, struct Client *, unsigned int, bool);
 extern void remove_user_from_channel(struct ChannelMember *);
 extern void channel_demote_members(struct Channel *, const struct Client *);
 extern void channel_send_namereply(struct Client *, struct Channel *);
@@ -126,7 +126,9 @@ extern const struct chan_mode *cmode_map[];
 extern const struct chan_mode  cmode_tab[];
 
 extern void channel_mode_init(void);
-extern const char *add_id(struct Client *, struct Channel *, const char *, dlink_list *, unsigned int);
+extern const char *add_id(struct Client *, struct Channel *, const char *, struct BanList *, unsigned int);
 extern void channel_mode_set(struct Client *, struct Channel *, struct ChannelMember *, int, char **);
-extern void clear_ban_cache_list(dlink_list *);
+extern void clear_ban_cache_channel(struct Channel *);
+extern void clear_ban_cache_client(struct Client *);
+extern void check_ban_cache(struct ChannelMember *);
 #endif  /* INCLUDED_channel_mode_h */
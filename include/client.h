@@ -137,7 +137,8 @@ enum
   FLAGS_TLS           = 1 << 21,  /**< User is connected via TLS (Transport Layer Security) */
   FLAGS_SQUIT         = 1 << 22,
   FLAGS_EXEMPTXLINE   = 1 << 23,  /**< Client is exempt from x-lines */
-  FLAGS_CAP302        = 1 << 24  /**< Client supports the IRCv3 CAP 302 extension */
+  FLAGS_CAP302        = 1 << 24,  /**< Client supports the IRCv3 CAP 302 extension */
+  FLAGS_FLUSH         = 1 << 25  /**< Client is on the list of send queues to be flushed */
 };
 
 #define HasFlag(x, y) ((x)->flags &   (y))
@@ -270,7 +271,8 @@ struct ListTask
   dlink_list show_mask;  /**< Channels to show */
   dlink_list hide_mask;  /**< Channels to hide */
 
-  unsigned int hash_index;  /**< The hash bucket we are currently in */
+  unsigned int hash_index;  /**< Position in the channel table, see hash_iterate() */
+  unsigned int hash_hold;  /**< Token from hash_iterate_hold(); 0 if not holding */
   unsigned int users_min;
   unsigned int users_max;
   unsigned int created_min;  /**< Real time */
@@ -288,6 +290,8 @@ struct ListTask
 struct Connection
 {
   dlink_node lclient_node;
+  dlink_node flush_node;  /**< Used to link into the list of send queues to be flushed */
+  struct timer ping_timer;  /**< Fires once the next ping or registration deadline has been reached */
 
   unsigned int registration;
   unsigned int cap;  /**< Client CAP bit-field */
@@ -299,7 +303,7 @@ struct Connection
   uintmax_t serial;  /**< Used to enforce 1 send per nick */
   uintmax_t last_data;  /**< Last time data read from socket; monotonic time */
   uintmax_t last_ping;  /**< Last time data read from socket; currently this is a copy of last_data
-                             which can be modified by check_pings_list; monotonic time */
+                             which can be modified by client_check_ping; monotonic time */
   uintmax_t created_real;  /**< Time client was created; real time */
   uintmax_t created_monotonic;  /**< Time client was created; monotonic time */
   uintmax_t last_caller_id_time;  /**< Monotonic time */
@@ -351,37 +355,27 @@ struct Connection
 /*! \brief Client structure */
 struct Client
 {
-  dlink_node node;
-  dlink_node lnode;  /**< Used for Server->servers/users */
-
+  /*
+   * Everything looked at while routing a message to or through a client
+   * is kept within its first 64 bytes; client_cache hands out clients
+   * aligned to that. Strings most clients never have, or that are only
+   * ever shown by commands like WHOIS, are stored out of line in the
+   * string caches, see client_string_set(). Strings many clients have in
+   * common are interned instead and set with intern_set().
+   */
+  struct Client *from;  /**< == self, if Local Client, *NEVER* NULL! */
   struct Connection *connection;  /**< Connection structure associated with this client */
-  struct Client *hnext;  /**< For client hash table lookups by name */
-  struct Client *idhnext;  /**< For SID hash table lookups by sid */
-  struct Server *serv;  /**< ...defined, if this is a server */
   struct Client *servptr;  /**< Points to server this Client is on */
-  struct Client *from;  /**< == self, if Local Client, *NEVER* NULL! */
-
-  uintmax_t tsinfo;  /**< Timestamp on this nick; real time */
-
   unsigned int flags;  /**< Client flags */
   unsigned int umodes;  /**< User modes this client has set */
-  unsigned int hopcount;  /**< Number of servers to this 0 = local */
   unsigned int status;  /**< Client type */
   unsigned int handler;  /**< Handler index */
+  uint32_t name_hash;  /**< hash_folded() of Client::name_folded */
+  unsigned int name_len;  /**< Length of Client::name */
+  char id[IDLEN + 1];  /**< Client ID, unique ID per client */
 
-  dlink_list whowas_list;
-  dlink_list channel;  /**< Chain of channel pointer blocks */
-  dlink_list svstags;  /**< List of ServicesTag items */
-
-  struct irc_ssaddr ip;  /**< Real IP address */
-
-  char *tls_certfp;  /**< TLS certificate fingerprint */
-  char *tls_cipher;  /**< Exact copy of tls_get_cipher() */
-
-  char away[AWAYLEN + 1];  /**< Client's AWAY message. Can be set/unset via AWAY command */
+  /* Used to build the prefix of messages sent to local clients */
   char name[HOSTLEN + 1];  /**< Unique name for a client nick or host */
-  char id[IDLEN + 1];  /**< Client ID, unique ID per client */
-  char account[ACCOUNTLEN + 1];  /**< Services account */
 
   /*
    * client->username is the username from ident or the USER message,
@@ -390,35 +384,57 @@ struct Client
    * tilde depending on the auth{} block. Once a client has registered,
    * this field should be considered read-only.
    */
-  char username[USERLEN + 1];  /**< client's username */
+  const char *username;  /**< client's username; interned */
 
   /*
    * client->host contains the resolved name or ip address as a string
    * for the user, it may be fiddled with for oper spoofing etc.
    * once it's changed the *real* address goes away.
    */
-  char host[HOSTLEN + 1];  /**< Client's hostname. Can be faked/spoofed */
+  const char *host;  /**< Client's hostname. Can be faked/spoofed; interned */
 
-  /*
-   * client->realhost contains the resolved name or ip address as a string
-   * for the user. Once a client has registered, this field should be
-   * considered read-only.
-   */
-  char realhost[HOSTLEN + 1];  /**< Client's real hostname */
+  dlink_node node;
+  dlink_node lnode;  /**< Used for Server->servers/users */
+  dlink_list channel;  /**< Chain of channel pointer blocks */
 
+  struct Server *serv;  /**< ...defined, if this is a server */
+  uintmax_t tsinfo;  /**< Timestamp on this nick; real time */
+  unsigned int hopcount;  /**< Number of servers to this 0 = local */
+
+  char name_folded[HOSTLEN + 1];  /**< Client::name in lower case, see irc_fold() */
+  const char *account;  /**< Services account; interned */
+  uint64_t ban_generation;  /**< Renewed whenever nick, host, account or certificate fingerprint change; see clear_ban_cache_client() */
+
+  dlink_list whowas_list;
+  dlink_list svstags;  /**< List of ServicesTag items */
+
+  /* The strings below are never NULL; "" if unset */
+  const char *away;  /**< Client's AWAY message. Can be set/unset via AWAY command */
 
   /*
    * client->info for unix clients will normally contain the info from the
    * gcos field in /etc/passwd but anything can go here.
    */
-  char info[REALLEN + 1];  /**< Free form additional client info */
+  const char *info;  /**< Free form additional client info */
+
+  /*
+   * client->realhost contains the resolved name or ip address as a string
+   * for the user. Once a client has registered, this field should be
+   * considered read-only.
+   */
+  const char *realhost;  /**< Client's real hostname; interned */
 
   /*
    * client->sockhost contains the ip address gotten from the socket as a
    * string, this field should be considered read-only once the connection
    * has been made. (set in s_bsd.c only)
    */
-  char sockhost[HOSTIPLEN + 1];  /**< This is the host name from the socket ip address as string */
+  const char *sockhost;  /**< This is the host name from the socket ip address as string; interned */
+
+  char *tls_certfp;  /**< TLS certificate fingerprint */
+  char *tls_cipher;  /**< Exact copy of tls_get_cipher() */
+
+  struct irc_ssaddr ip;  /**< Real IP address */
 };
 
 
@@ -448,12 +464,14 @@ extern void accept_clear_list(dlink_list *);
 extern void exit_client(struct Client *, const char *);
 extern void conf_try_ban(struct Client *, int, const char *);
 extern void check_conf_klines(void);
-extern void client_init(void);
 extern void dead_link_on_write(struct Client *, int);
 extern void dead_link_on_read(struct Client *, int);
 extern void exit_aborted_clients(void);
 extern void free_exited_clients(void);
 extern struct Client *client_make(struct Client *);
+extern void client_set_name(struct Client *, const char *);
+extern void client_string_set(const char **, const char *, size_t);
+extern void client_ping_schedule(struct Client *);
 extern struct Client *find_chasing(struct Client *, const char *);
 extern struct Client *find_person(const struct Client *, const char *);
 extern const char *client_get_name(const struct Client *, enum addr_mask_type);
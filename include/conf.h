@@ -137,6 +137,8 @@ struct MaskItem
   char              *name;
   char              *user;     /* user part of user@host */
   char              *host;     /* host part of user@host */
+  struct match_mask *user_mask;  /* user, compiled; set by add_conf_by_address() */
+  struct match_mask *host_mask;  /* host, compiled; set by add_conf_by_address() for HM_HOST */
   char              *passwd;
   char              *spasswd;  /* Password to send. */
   char              *reason;
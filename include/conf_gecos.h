@@ -27,10 +27,14 @@
 #ifndef INCLUDED_conf_gecos_h
 #define INCLUDED_conf_gecos_h
 
+#include "match_set.h"
+
 struct GecosItem
 {
   dlink_node node;
+  struct match_set_entry set_entry;  /**< Link to the set of all X-line masks */
   char *mask;
+  struct match_mask *mask_compiled;  /**< GecosItem::mask, compiled */
   char *reason;
   uintmax_t expire;
   uintmax_t setat;
@@ -39,8 +43,10 @@ struct GecosItem
 
 extern const dlink_list *gecos_get_list(void);
 extern void gecos_delete(struct GecosItem *, bool);
-extern struct GecosItem *gecos_make(void);
+extern struct GecosItem *gecos_make(const char *);
+extern bool gecos_match(const struct GecosItem *, const char *);
 extern struct GecosItem *gecos_find(const char *, int (*)(const char *, const char *));
 extern void gecos_clear(void);
 extern void gecos_expire(void);
+extern void gecos_count_memory(unsigned int *const, size_t *const);
 #endif  /* INCLUDED_conf_gecos_h */
@@ -39,6 +39,6 @@ struct PseudoItem
 };
 
 extern const dlink_list *pseudo_get_list(void);
-extern void pseudo_register(const char *, const char *, const char *, const char *, const char *);
+extern bool pseudo_register(const char *, const char *, const char *, const char *, const char *);
 extern void pseudo_clear(void);
 #endif  /* INCLUDED_conf_pseudo_h */
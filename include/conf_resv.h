@@ -27,12 +27,16 @@
 #ifndef INCLUDED_conf_resv_h
 #define INCLUDED_conf_resv_h
 
+#include "match_set.h"
+
 struct ResvItem
 {
   dlink_node node;
+  struct match_set_entry set_entry;  /**< Link to the set of masks of ResvItem::list */
   dlink_list *list;
   dlink_list exempt_list;
   char *mask;
+  struct match_mask *mask_compiled;  /**< ResvItem::mask, compiled */
   char *reason;
   uintmax_t expire;
   uintmax_t setat;
@@ -52,10 +56,12 @@ struct ResvExemptItem
 
 extern const dlink_list *resv_chan_get_list(void);
 extern const dlink_list *resv_nick_get_list(void);
+extern uint64_t resv_chan_get_generation(void);
 extern void resv_delete(struct ResvItem *, bool);
 extern struct ResvItem *resv_make(const char *, const char *, const dlink_list *);
 extern bool resv_exempt_find(const struct Client *, const struct ResvItem *);
 extern struct ResvItem *resv_find(const char *, int (*)(const char *, const char *));
 extern void resv_clear(void);
 extern void resv_expire(void);
+extern void resv_count_memory(unsigned int *const, size_t *const);
 #endif  /* INCLUDED_conf_resv_h */
@@ -28,29 +28,58 @@
 #define INCLUDED_dbuf_h
 
 #define dbuf_length(x) ((x)->total_size)
-#define dbuf_clear(x) dbuf_delete(x, dbuf_length(x))
+#define dbuf_count(x) ((x)->count)
+#define dbuf_nth(x, n) ((x)->ring[((x)->head + (n)) & ((x)->ring_size - 1)])
 
-enum { DBUF_BLOCK_SIZE = 1024 };
+/** Block pools, each with its own block size */
+enum
+{
+  DBUF_POOL_SMALL,  /**< A single formatted protocol message; see send_format() */
+  DBUF_POOL_LARGE,  /**< Bulk data appended with dbuf_put() */
+  DBUF_POOL_COUNT
+};
+
+enum
+{
+  DBUF_BLOCK_SIZE_SMALL = 512,
+  DBUF_BLOCK_SIZE_LARGE = 4096,
+  DBUF_SPARE_MAX = 4  /**< Spare blocks dbuf_map_free() offers beyond the last one */
+};
 
 struct dbuf_block
 {
+  struct dbuf_block *next;  /**< Next block on the pool's free list */
   int refs;
+  unsigned int pool;  /**< Pool this block has been taken from */
   size_t size;
-  char data[DBUF_BLOCK_SIZE];
+  size_t capacity;  /**< Size of data[] */
+  char data[];
 };
 
+struct iovec;
+
 struct dbuf_queue
 {
-  dlink_list blocks;
+  struct dbuf_block **ring;  /**< Circular array of references to the queued blocks */
+  unsigned int ring_size;  /**< Number of slots in ring[]; zero or a power of two */
+  unsigned int head;  /**< Slot of the first block */
+  unsigned int count;  /**< Number of blocks in the queue */
   size_t total_size;
-  size_t pos;
+  size_t pos;  /**< Bytes of the first block that have already been consumed */
 };
 
 extern struct dbuf_block *dbuf_alloc(void);
+extern void dbuf_pool_stats(unsigned int, size_t *, unsigned int *, unsigned int *, unsigned int *);
 extern void dbuf_ref_free(struct dbuf_block *);
 extern void dbuf_add(struct dbuf_queue *, struct dbuf_block *);
 extern void dbuf_delete(struct dbuf_queue *, size_t);
+extern void dbuf_clear(struct dbuf_queue *);
+extern struct dbuf_block *dbuf_tail(struct dbuf_queue *, size_t);
+extern void dbuf_commit(struct dbuf_queue *, size_t);
 extern void dbuf_put_fmt(struct dbuf_block *, const char *, ...);
 extern void dbuf_put_args(struct dbuf_block *, const char *, va_list);
 extern void dbuf_put(struct dbuf_queue *, const char *, size_t);
+extern int dbuf_map(const struct dbuf_queue *, struct iovec *, int);
+extern int dbuf_map_free(const struct dbuf_queue *, struct iovec *, int);
+extern void dbuf_commit_free(struct dbuf_queue *, size_t);
 #endif  /* INCLUDED_dbuf_h */
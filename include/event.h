@@ -34,6 +34,7 @@ struct event_base
   struct
   {
     uintmax_t sec_real, sec_monotonic;
+    uintmax_t msec_monotonic;
   } time;
 };
 
@@ -44,17 +45,19 @@ struct event
   /* public */
   const char *name;
   void (*handler)(void *);
-  uintmax_t when;
+  uintmax_t when;  /**< Interval in milliseconds */
   bool oneshot;
 
   /* private */
-  uintmax_t next;
+  uintmax_t next;  /**< Next execution in milliseconds; monotonic time */
   void *data;
   bool active;
-  dlink_node node;
+  unsigned int index;  /**< Position in the event heap */
 };
 
-extern const dlink_list *event_get_list(void);
+extern unsigned int event_count(void);
+extern const struct event *event_get(unsigned int);
+extern uintmax_t event_next(void);
 extern void event_add(struct event *, void *);
 extern void event_addish(struct event *, void *);
 extern void event_delete(struct event *);
@@ -29,6 +29,7 @@
 
 #include "ircd_defs.h"
 #include "tls.h"
+#include "timer.h"
 
 
 enum { FD_DESC_SIZE = 80 };  /* HOSTLEN + comment */
@@ -53,11 +54,11 @@ typedef struct _fde
 
   void (*timeout_handler)(struct _fde *, void *);
   void *timeout_data;
-  uintmax_t timeout;
+  struct timer timeout;
 
   void (*flush_handler)(struct _fde *, void *);
   void *flush_data;
-  uintmax_t flush_timeout;
+  struct timer flush;
 
   struct
   {
@@ -27,36 +27,72 @@
 #ifndef INCLUDED_hash_h
 #define INCLUDED_hash_h
 
-#define FNV1_32_INIT 0x811c9dc5
-#define FNV1_32_BITS 16
-#define FNV1_32_SIZE (1 << FNV1_32_BITS)  /* 2^16 = 65536 */
-#define HASHSIZE FNV1_32_SIZE
+#define HASHSIZE 65536  /* Size of the tables indexed by strhash(); a power of two */
 
 struct Client;
 struct Channel;
+struct BanList;
+struct BanHost;
+struct ChannelMember;
+struct InternString;
+struct Whowas;
 
 enum
 {
   HASH_TYPE_ID,
   HASH_TYPE_CLIENT,
-  HASH_TYPE_CHANNEL
+  HASH_TYPE_CHANNEL,
+  HASH_TYPE_MEMBER,
+  HASH_TYPE_STRING,
+  HASH_TYPE_WHOWAS,
+  HASH_TYPE_BAN
 };
 
+struct hash_stats
+{
+  unsigned int count;  /**< Number of entries */
+  unsigned int size;  /**< Number of slots */
+  size_t memory;  /**< Bytes allocated for slots, including the table being resized from */
+  unsigned int migrating;  /**< Entries still in the table being resized from */
+  uintmax_t probes_total;  /**< Sum of the probe lengths of all migrated entries */
+  unsigned int probes_max;  /**< Longest probe length */
+};
+
+extern void hash_init(void);
+
 extern void hash_add_client(struct Client *);
 extern void hash_del_client(struct Client *);
 extern void hash_add_channel(struct Channel *);
 extern void hash_del_channel(struct Channel *);
 extern void hash_add_id(struct Client *);
 extern void hash_del_id(struct Client *);
+extern void hash_add_member(struct ChannelMember *);
+extern void hash_del_member(struct ChannelMember *);
+extern void hash_add_string(struct InternString *);
+extern void hash_del_string(struct InternString *);
+extern void hash_add_whowas(struct Whowas *);
+extern void hash_del_whowas(struct Whowas *);
+extern void hash_add_ban_host(struct BanHost *);
+extern void hash_del_ban_host(struct BanHost *);
 
 extern struct Client *hash_find_id(const char *);
 extern struct Client *hash_find_client(const char *);
 extern struct Client *hash_find_server(const char *);
 extern struct Channel *hash_find_channel(const char *);
-extern void *hash_get_bucket(int, unsigned int);
+extern struct ChannelMember *hash_find_member(const struct Client *, const struct Channel *);
+extern struct InternString *hash_find_string(const char *, size_t, uint32_t);
+extern struct Whowas *hash_find_whowas(const char *);
+extern struct BanHost *hash_find_ban_host(const struct BanList *, const char *, size_t);
+extern void *hash_iterate(int, unsigned int *);
+extern unsigned int hash_iterate_hold(int);
+extern void hash_iterate_release(int, unsigned int);
+extern void hash_get_stats(int, struct hash_stats *);
 
 extern void free_list_task(struct Client *);
 extern void safe_list_channels(struct Client *, bool);
 
+extern uint32_t hash_folded(const char *, size_t);
+extern uint32_t hash_string(const char *);
+extern uint32_t hash_ban_host(const struct BanList *, const char *, size_t);
 extern unsigned int strhash(const char *);
 #endif  /* INCLUDED_hash_h */
@@ -0,0 +1,45 @@
+/*
+ *  ircd-hybrid: an advanced, lightweight Internet Relay Chat Daemon (ircd)
+ *
+ *  Copyright (c) 1997-2022 ircd-hybrid development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ *  USA
+ */
+
+
+/*! \file intern.h
+ * \brief A pool of shared, reference counted strings.
+ * \version $Id$
+ */
+
+#ifndef INCLUDED_intern_h
+#define INCLUDED_intern_h
+
+/*! \brief An interned string; handed out as a pointer to InternString::data */
+struct InternString
+{
+  uint32_t hash;  /**< hash_folded() of the bytes in data; case-sensitive */
+  unsigned int refcount;  /**< Number of intern_string()/intern_ref() calls not yet released */
+  unsigned int len;  /**< strlen() of data */
+  char data[];
+};
+
+extern const char *intern_string(const char *, size_t);
+extern const char *intern_ref(const char *);
+extern void intern_release(const char *);
+extern void intern_set(const char **, const char *, size_t);
+extern void intern_count_memory(unsigned int *const, size_t *const, uintmax_t *const);
+#endif  /* INCLUDED_intern_h */
@@ -30,8 +30,13 @@
 #include "config.h"
 
 
+struct match_mask;
+
 extern bool has_wildcards(const char *);
 extern int match(const char *, const char *);
+extern struct match_mask *match_compile(const char *);
+extern void match_mask_free(struct match_mask *);
+extern int match_compiled(const struct match_mask *, const char *);
 
 extern unsigned int token_vector(char *, char, char *[], unsigned int);
 
@@ -56,6 +61,12 @@ extern int irccmp(const char *, const char *);
  */
 extern int ircncmp(const char *, const char *, size_t);
 
+/*
+ * irc_fold - copies src to dst in lower case, the way irccmp() sees it;
+ *            returns strlen(src) like strlcpy() does
+ */
+extern size_t irc_fold(char *, const char *, size_t);
+
 #ifndef HAVE_STRLCPY
 extern size_t strlcpy(char *, const char *, size_t);
 #endif
@@ -56,6 +56,7 @@ struct ServerStatistics
   uintmax_t is_sbr;  /**< Bytes received from servers */
   uintmax_t is_cti;  /**< Time spent connected by clients */
   uintmax_t is_sti;  /**< Time spent connected by servers */
+  uintmax_t is_ctl;  /**< Changes made to the kernel's I/O interest set */
   unsigned int is_cl;  /**< Number of client connections */
   unsigned int is_sv;  /**< Number of server connections */
   unsigned int is_ni;  /**< Connection but no idea who it was */
@@ -0,0 +1,65 @@
+/*
+ *  ircd-hybrid: an advanced, lightweight Internet Relay Chat Daemon (ircd)
+ *
+ *  Copyright (c) 1997-2022 ircd-hybrid development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ *  USA
+ */
+
+/*! \file match_set.h
+ * \brief Sets of wildcard masks searched all at once.
+ * \version $Id$
+ */
+
+#ifndef INCLUDED_match_set_h
+#define INCLUDED_match_set_h
+
+#include "list.h"
+
+struct match_mask;
+struct match_set_node;
+
+/*! \brief A mask in a match_set; embedded in the item the mask belongs to */
+struct match_set_entry
+{
+  dlink_node node;  /**< Link to the trie node or match_set::residual */
+  const struct match_mask *mask;  /**< Compiled mask the entry stands for */
+  void *data;  /**< Item returned by match_set_find() */
+  uint64_t seq;  /**< Order of addition; later entries win */
+  uint64_t mark;  /**< match_set::lookup when last verified */
+  unsigned int trie_node;  /**< Node its fragment ends at; 0 if residual */
+};
+
+/*! \brief Masks indexed by their longest literal fragment */
+struct match_set
+{
+  struct match_set_node *node;  /**< Trie nodes; node[0] is the root */
+  unsigned int nodes;  /**< Number of match_set::node in use, free ones included */
+  unsigned int size;  /**< Number of match_set::node allocated */
+  unsigned int free;  /**< First node of the free list, or 0 */
+  unsigned int root[256];  /**< Children of the root by character */
+  bool dirty;  /**< Failure links need to be rebuilt */
+  dlink_list residual;  /**< Entries without a usable fragment */
+  uint64_t seq;
+  uint64_t lookup;
+};
+
+extern void match_set_add(struct match_set *, struct match_set_entry *, const char *,
+                          const struct match_mask *, void *);
+extern void match_set_del(struct match_set *, struct match_set_entry *);
+extern void *match_set_find(struct match_set *, const char *);
+extern void match_set_count_memory(const struct match_set *, unsigned int *const, size_t *const);
+#endif  /* INCLUDED_match_set_h */
@@ -27,10 +27,43 @@
 #ifndef INCLUDED_memory_h
 #define INCLUDED_memory_h
 
+#include "list.h"
+
+/*! \brief A cache of equally sized objects, carved out of slabs
+ *
+ * Caches are meant to be defined statically with only name and size
+ * filled in, e.g.:
+ *   static struct mem_cache client_cache = { .name = "Client", .size = sizeof(struct Client) };
+ * The remaining fields are set up on the first allocation.
+ */
+struct mem_cache
+{
+  dlink_node node;  /**< Link in the list returned by mem_cache_get_list() */
+  const char *name;  /**< Type name as reported by STATS z */
+  size_t size;  /**< Size of an object as requested */
+  size_t align;  /**< Object alignment if stricter than the default; a power of two */
+  size_t stride;  /**< Size of an object rounded up to the alignment */
+  size_t offset;  /**< Offset of the first object from the start of a slab */
+  unsigned int per_slab;  /**< Number of objects in a slab */
+  dlink_list partial;  /**< Slabs with both used and free objects */
+  dlink_list full;  /**< Slabs without free objects */
+  dlink_list empty;  /**< Slabs without used objects */
+  unsigned int live;  /**< Objects handed out */
+  unsigned int peak;  /**< Highest value 'live' ever had */
+};
+
 extern void outofmemory(void);
 extern void *xcalloc(size_t);
 extern void *xrealloc(void *, size_t);
 extern void xfree(void *);
 extern void *xstrdup(const char *);
 extern void *xstrndup(const char *, size_t);
+extern void *mem_cache_alloc(struct mem_cache *);
+extern void mem_cache_free(struct mem_cache *, void *);
+extern void mem_cache_trim(void);
+extern void *mem_string_alloc(size_t);
+extern char *mem_strndup(const char *, size_t);
+extern void mem_strfree(const void *);
+extern size_t mem_cache_slab_size(void);
+extern const dlink_list *mem_cache_get_list(void);
 #endif  /* INCLUDED_memory_h */
@@ -90,6 +90,8 @@ struct Message
   unsigned int rcount;  /**< Number of times command used by server */
   unsigned int ecount;  /**< Number of times command has been issued via ENCAP */
   uintmax_t bytes;  /**< Bytes received for this message */
+  uintmax_t dispatched;  /**< Number of times a handler has been called */
+  uintmax_t dispatch_time;  /**< Cumulative time spent in handlers; nanoseconds */
 
   /* handlers:
    * UNREGISTERED, CLIENT, SERVER, ENCAP, OPER, LAST
@@ -98,7 +100,7 @@ struct Message
 };
 
 extern void parse(struct Client *, char *, char *);
-extern void mod_add_cmd(struct Message *);
+extern bool mod_add_cmd(struct Message *);
 extern void mod_del_cmd(struct Message *);
 extern struct Message *find_command(const char *);
 extern void report_messages(struct Client *);
@@ -91,6 +91,7 @@ extern patricia_node_t *patricia_try_search_exact(patricia_tree_t *, const char
 extern patricia_node_t *patricia_try_search_best(patricia_tree_t *, const char *);
 extern patricia_node_t *patricia_try_search_exact_addr(patricia_tree_t *, struct sockaddr *, int);
 extern patricia_node_t *patricia_try_search_best_addr(patricia_tree_t *, struct sockaddr *, int);
+extern int patricia_search_all_addr(patricia_tree_t *, struct sockaddr *, patricia_node_t **);
 
 /* { from demo.c */
 extern patricia_node_t *patricia_make_and_lookup(patricia_tree_t *, const char *);
@@ -46,7 +46,7 @@ enum
   COMM_SELECT_WRITE = 1 << 1
 };
 
-/* How long can comm_select() wait for network events [milliseconds] */
+/* How long can comm_select() wait for network events while channel listings are in progress [milliseconds] */
 enum { SELECT_DELAY = 500 };
 
 struct Client;
@@ -58,9 +58,9 @@ extern void report_error(int, const char *, const char *, int);
 extern int comm_get_sockerr(fde_t *);
 extern bool comm_ignore_errno(int);
 
+extern int comm_select_timeout(void);
 extern void comm_settimeout(fde_t *, uintmax_t, void (*)(fde_t *, void *), void *);
 extern void comm_setflush(fde_t *, uintmax_t, void (*)(fde_t *, void *), void *);
-extern void comm_checktimeouts(void *);
 extern void comm_connect_tcp(fde_t *, const struct irc_ssaddr *, unsigned short, const struct irc_ssaddr *, void (fde_t *, int, void *), void *, uintmax_t);
 extern const char *comm_errstr(int);
 extern int comm_socket(int, int, int);
@@ -70,5 +70,10 @@ extern int comm_accept(fde_t *, struct irc_ssaddr *);
 extern void comm_select_init(void);
 extern void comm_setselect(fde_t *, unsigned int, void (*)(fde_t *, void *), void *, uintmax_t);
 extern void comm_select(void);
+#if USE_IOPOLL_MECHANISM == __IOPOLL_MECHANISM_IOURING
+extern void comm_select_init_epoll(void);
+extern void comm_setselect_epoll(fde_t *, unsigned int, void (*)(fde_t *, void *), void *, uintmax_t);
+extern void comm_select_epoll(void);
+#endif
 extern void remove_ipv6_mapping(struct irc_ssaddr *);
 #endif  /* INCLUDED_s_bsd_h */
@@ -0,0 +1,53 @@
+/*
+ *  ircd-hybrid: an advanced, lightweight Internet Relay Chat Daemon (ircd)
+ *
+ *  Copyright (c) 1997-2022 ircd-hybrid development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ *  USA
+ */
+
+/*! \file scan.h
+ * \brief Byte scanning kernels with vectorized implementations.
+ * \version $Id$
+ */
+
+#ifndef INCLUDED_scan_h
+#define INCLUDED_scan_h
+
+/*! \brief A set of bytes, laid out for both the scalar and the vectorized kernels */
+struct scan_set
+{
+  unsigned char map[256];  /**< Non-zero if the byte is a member of the set */
+  unsigned char low_ascii[16];  /**< Bytes 0x00-0x7f; indexed by low nibble, one bit per high nibble */
+  unsigned char low_high[16];  /**< Bytes 0x80-0xff; indexed by low nibble, one bit per high nibble */
+};
+
+extern struct scan_set scan_set_eol;  /* CR, LF */
+extern struct scan_set scan_set_token;  /* Space and NUL; ends a protocol token */
+extern struct scan_set scan_set_nick;  /* IsNickChar() */
+extern struct scan_set scan_set_user;  /* IsUserChar() */
+extern struct scan_set scan_set_ident;  /* IsUser2Char() and ident specials */
+extern struct scan_set scan_set_ident_special;  /* '-', '_', '.' */
+
+extern void scan_set_add(struct scan_set *, unsigned char);
+extern void scan_set_add_attr(struct scan_set *, unsigned int);
+extern const char *scan_find(const char *, size_t, const struct scan_set *);
+extern size_t scan_span(const char *, size_t, const struct scan_set *);
+extern const char *scan_find_ctrl(const char *, size_t);
+extern const char *scan_get_kernel(void);
+extern bool scan_set_kernel(const char *);
+extern void scan_init(void);
+#endif  /* INCLUDED_scan_h */
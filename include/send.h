@@ -60,6 +60,7 @@ struct Client;
 /* send.c prototypes */
 extern void sendq_unblocked(fde_t *, void *);
 extern void send_queued_write(struct Client *);
+extern void send_queued_all(void);
 extern void sendto_one(struct Client *, const char *, ...) AFP(2,3);
 extern void sendto_one_numeric(struct Client *, const struct Client *, enum irc_numerics, ...);
 extern void sendto_one_notice(struct Client *, const struct Client *, const char *, ...) AFP(3,4);
@@ -0,0 +1,46 @@
+/*
+ *  ircd-hybrid: an advanced, lightweight Internet Relay Chat Daemon (ircd)
+ *
+ *  Copyright (c) 1997-2022 ircd-hybrid development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ *  USA
+ */
+
+/*! \file timer.h
+ * \brief A hierarchical timer wheel with millisecond resolution.
+ * \version $Id$
+ */
+
+#ifndef INCLUDED_timer_h
+#define INCLUDED_timer_h
+
+#include "list.h"
+
+struct timer
+{
+  void (*handler)(void *);  /**< Function to call once the timer expires */
+  void *data;  /**< Argument passed to handler */
+  uintmax_t expires;  /**< Expiry time in milliseconds; monotonic time */
+  dlink_list *bucket;  /**< Wheel bucket the timer is linked into; NULL if inactive */
+  dlink_node node;  /**< Embedded list node used to link into the bucket */
+};
+
+extern void timer_add(struct timer *, uintmax_t, void (*)(void *), void *);
+extern void timer_del(struct timer *);
+extern void timer_run(void);
+extern uintmax_t timer_next(void);
+extern void timer_init(void);
+#endif  /* INCLUDED_timer_h */
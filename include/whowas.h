@@ -33,27 +33,28 @@
 
 struct Whowas
 {
-  dlink_node hash_node;  /**< List node; linked into whowas_hash */
-  dlink_node list_node;  /**< List node; linked into whowas_list */
-  dlink_node client_list_node;  /**< List node; linked into client->whowas_list */
-  unsigned int hash_value;  /**< Hash value derived from Whowas::name */
+  uintmax_t seq;  /**< Position in the history, counting from 1; 0 if the slot is unused */
+  uintmax_t next;  /**< Whowas::seq of the previous entry for the same name; 0 if none */
   uintmax_t logoff;  /**< When the client logged off; real time */
+  uint32_t hash;  /**< Client::name_hash of the client; hash of the folded name */
   bool server_hidden;  /**< Client's server is hidden */
-  char account[ACCOUNTLEN + 1];  /**< Services account */
-  char name[NICKLEN + 1];  /**< Client's nick name */
-  char username[USERLEN + 1];  /**< Client's user name */
-  char hostname[HOSTLEN + 1];  /**< Client's host name */
-  char realhost[HOSTLEN + 1];  /**< Client's real host name */
-  char sockhost[HOSTIPLEN + 1];  /**< Client's IP address as string */
-  char realname[REALLEN + 1];  /**< Client's real name/gecos */
-  char servername[HOSTLEN + 1];  /**< Name of the server the client is using */
+  const char *name;  /**< Client's nick name; interned */
+  const char *account;  /**< Services account; interned */
+  const char *username;  /**< Client's user name; interned */
+  const char *hostname;  /**< Client's host name; interned */
+  const char *realhost;  /**< Client's real host name; interned */
+  const char *sockhost;  /**< Client's IP address as string; interned */
+  const char *realname;  /**< Client's real name/gecos; interned */
+  const char *servername;  /**< Name of the server the client is using; interned */
   struct Client *client;  /**< Pointer to new nick name for chasing or NULL */
+  dlink_node client_list_node;  /**< List node; linked into client->whowas_list */
 };
 
-extern const dlink_list *whowas_get_hash(unsigned int);
-extern void whowas_trim(void);
+extern void whowas_resize(void);
 extern void whowas_add_history(struct Client *, bool);
 extern void whowas_off_history(struct Client *);
 extern struct Client *whowas_get_history(const char *, uintmax_t);
+extern const struct Whowas *whowas_find(const char *);
+extern const struct Whowas *whowas_next(const struct Whowas *);
 extern void whowas_count_memory(unsigned int *const, size_t *const);
 #endif  /* INCLUDED_whowas_h */
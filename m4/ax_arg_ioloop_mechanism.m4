@@ -6,6 +6,7 @@ AC_DEFUN([AX_ARG_IOLOOP_MECHANISM],[
   AC_ARG_ENABLE([epoll],  [AS_HELP_STRING([--enable-epoll],  [Force epoll usage.])],  [desired_iopoll_mechanism="epoll"])
   AC_ARG_ENABLE([devpoll],[AS_HELP_STRING([--enable-devpoll],[Force devpoll usage.])],[desired_iopoll_mechanism="devpoll"])
   AC_ARG_ENABLE([poll],   [AS_HELP_STRING([--enable-poll],   [Force poll usage.])],   [desired_iopoll_mechanism="poll"])
+  AC_ARG_ENABLE([iouring],[AS_HELP_STRING([--enable-iouring],[Force io_uring usage (falls back to epoll at run time).])],[desired_iopoll_mechanism="iouring"])
 
   AC_MSG_CHECKING([for optimal/desired iopoll mechanism])
 
@@ -35,6 +36,12 @@ AC_DEFUN([AX_ARG_IOLOOP_MECHANISM],[
   AC_DEFINE_UNQUOTED([__IOPOLL_MECHANISM_POLL],[$iopoll_mechanism_poll],[poll mechanism])
   AC_LINK_IFELSE([AC_LANG_FUNC_LINK_TRY([poll])],[is_poll_mechanism_available="yes"],[is_poll_mechanism_available="no"])
 
+  iopoll_mechanism_iouring=5
+  AC_DEFINE_UNQUOTED([__IOPOLL_MECHANISM_IOURING],[$iopoll_mechanism_iouring],[io_uring mechanism])
+  AC_LINK_IFELSE([AC_LANG_PROGRAM([[#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/io_uring.h>]], [[struct io_uring_params p = { .flags = 0 }; struct io_uring_sqe sqe = { .opcode = IORING_OP_POLL_ADD, .len = IORING_POLL_ADD_MULTI }; (void)sqe; syscall(__NR_io_uring_setup, 1, &p); return !(p.features & (IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS));]])],[is_iouring_mechanism_available="$is_epoll_mechanism_available"],[is_iouring_mechanism_available="no"])
+
   optimal_iopoll_mechanism="none"
   for mechanism in "kqueue" "epoll" "devpoll" "poll" ; do # order is important
     eval "is_optimal_iopoll_mechanism_available=\$is_${mechanism}_mechanism_available"
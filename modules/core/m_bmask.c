@@ -60,7 +60,7 @@ ms_bmask(struct Client *source_p, int parc, char *parv[])
   char banbuf[IRCD_BUFSIZE] = "";
   const char *mask;
   char *s, *t, *mbuf, *pbuf;
-  dlink_list *list = NULL;
+  struct BanList *list = NULL;
   int mlen = 0, tlen = 0;
   int modecount = 0;
   unsigned int flags = 0, type = 0;
@@ -35,6 +35,7 @@
 #include "conf_resv.h"
 #include "user.h"
 #include "whowas.h"
+#include "intern.h"
 #include "send.h"
 #include "channel.h"
 #include "channel_mode.h"
@@ -181,7 +182,7 @@ set_initial_nick(struct Client *source_p, const char *nick)
   if (source_p->name[0])
     hash_del_client(source_p);
 
-  strlcpy(source_p->name, nick, sizeof(source_p->name));
+  client_set_name(source_p, nick);
   hash_add_client(source_p);
 
   /* fd_desc is long enough */
@@ -223,7 +224,7 @@ change_local_nick(struct Client *source_p, const char *nick)
   if (samenick == false)
   {
     source_p->tsinfo = event_base->time.sec_real;
-    clear_ban_cache_list(&source_p->channel);
+    clear_ban_cache_client(source_p);
     monitor_signoff(source_p);
 
     if (HasUMode(source_p, UMODE_REGISTERED))
@@ -253,7 +254,7 @@ change_local_nick(struct Client *source_p, const char *nick)
                 source_p->id, nick, source_p->tsinfo);
 
   hash_del_client(source_p);
-  strlcpy(source_p->name, nick, sizeof(source_p->name));
+  client_set_name(source_p, nick);
   hash_add_client(source_p);
 
   if (samenick == false)
@@ -287,6 +288,7 @@ change_remote_nick(struct Client *source_p, char *parv[])
   if (samenick == false)
   {
     DelUMode(source_p, UMODE_REGISTERED);
+    clear_ban_cache_client(source_p);
     monitor_signoff(source_p);
 
     source_p->tsinfo = strtoumax(parv[2], NULL, 10);
@@ -306,7 +308,7 @@ change_remote_nick(struct Client *source_p, char *parv[])
 
   /* Set the new nick name */
   hash_del_client(source_p);
-  strlcpy(source_p->name, parv[1], sizeof(source_p->name));
+  client_set_name(source_p, parv[1]);
   hash_add_client(source_p);
 
   if (samenick == false)
@@ -342,14 +344,14 @@ uid_from_server(struct Client *source_p, int parc, char *parv[])
   client_p->hopcount = atoi(parv[2]);
   client_p->tsinfo = strtoumax(parv[3], NULL, 10);
 
-  strlcpy(client_p->name, parv[1], sizeof(client_p->name));
-  strlcpy(client_p->username, parv[5], sizeof(client_p->username));
-  strlcpy(client_p->host, parv[6], sizeof(client_p->host));
-  strlcpy(client_p->realhost, parv[7], sizeof(client_p->realhost));
-  strlcpy(client_p->sockhost, parv[8], sizeof(client_p->sockhost));
+  client_set_name(client_p, parv[1]);
+  intern_set(&client_p->username, parv[5], USERLEN);
+  intern_set(&client_p->host, parv[6], HOSTLEN);
+  intern_set(&client_p->realhost, parv[7], HOSTLEN);
+  intern_set(&client_p->sockhost, parv[8], HOSTIPLEN);
   strlcpy(client_p->id, parv[9], sizeof(client_p->id));
-  strlcpy(client_p->account, parv[10], sizeof(client_p->account));
-  strlcpy(client_p->info, parv[11], sizeof(client_p->info));
+  intern_set(&client_p->account, parv[10], ACCOUNTLEN);
+  client_string_set(&client_p->info, parv[11], REALLEN);
 
   struct addrinfo hints, *res;
   memset(&hints, 0, sizeof(hints));
@@ -531,8 +533,10 @@ perform_nick_change_collides(struct Client *source_p, struct Client *target_p,
   }
 
   /* The timestamps are different */
-  bool sameuser = irccmp(target_p->username, source_p->username) == 0 &&
-                  irccmp(target_p->sockhost, source_p->sockhost) == 0;
+  bool sameuser = (target_p->username == source_p->username ||
+                   irccmp(target_p->username, source_p->username) == 0) &&
+                  (target_p->sockhost == source_p->sockhost ||
+                   irccmp(target_p->sockhost, source_p->sockhost) == 0);
 
   if ((sameuser == true && newts < target_p->tsinfo) || (sameuser == false && newts > target_p->tsinfo))
   {
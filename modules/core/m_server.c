@@ -232,6 +232,7 @@ server_estab(struct Client *client_p)
              event_base->time.sec_real);
 
   SetServer(client_p);
+  client_ping_schedule(client_p);
   client_p->servptr = &me;
 
   dlinkAdd(client_p, &client_p->lnode, &me.serv->server_list);
@@ -365,9 +366,9 @@ server_set_gecos(struct Client *client_p, const char *info)
   }
 
   if (!EmptyString(s))
-    strlcpy(client_p->info, s, sizeof(client_p->info));
+    client_string_set(&client_p->info, s, REALLEN);
   else
-    strlcpy(client_p->info, "(Unknown Location)", sizeof(client_p->info));
+    client_string_set(&client_p->info, "(Unknown Location)", REALLEN);
 }
 
 enum
@@ -567,12 +568,12 @@ mr_server(struct Client *source_p, int parc, char *parv[])
    * If we are connecting (Handshake), we already have the name from the
    * connect{} block in source_p->name.
    */
-  strlcpy(source_p->name, name, sizeof(source_p->name));
+  client_set_name(source_p, name);
 
   if (parc == 6)  /* TBR: compatibility 'mode' */
   {
     strlcpy(source_p->id, sid, sizeof(source_p->id));
-    strlcpy(source_p->info, parv[parc - 1], sizeof(source_p->info));
+    client_string_set(&source_p->info, parv[parc - 1], REALLEN);
     server_set_flags(source_p, parv[4]);
   }
   else
@@ -748,12 +749,12 @@ ms_sid(struct Client *source_p, int parc, char *parv[])
   target_p->hopcount = atoi(parv[2]);
   target_p->servptr = source_p;
 
-  strlcpy(target_p->name, parv[1], sizeof(target_p->name));
+  client_set_name(target_p, parv[1]);
   strlcpy(target_p->id, parv[3], sizeof(target_p->id));
 
   if (parc == 6)  /* TBR: compatibility 'mode' */
   {
-    strlcpy(target_p->info, parv[parc - 1], sizeof(target_p->info));
+    client_string_set(&target_p->info, parv[parc - 1], REALLEN);
     server_set_flags(target_p, parv[4]);
   }
   else
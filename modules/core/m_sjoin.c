@@ -142,7 +142,7 @@ set_final_mode(const struct Mode *mode, const struct Mode *oldmode, char *mbuf,
  * side effects	- given ban list is removed, modes are sent to local clients
  */
 static void
-remove_ban_list(struct Channel *channel, const struct Client *client, dlink_list *list, char c)
+remove_ban_list(struct Channel *channel, const struct Client *client, struct BanList *list, char c)
 {
   char modebuf[IRCD_BUFSIZE];
   char parabuf[IRCD_BUFSIZE];
@@ -151,7 +151,7 @@ remove_ban_list(struct Channel *channel, const struct Client *client, dlink_list
   int count = 0;
   int cur_len, mlen;
 
-  if (dlink_list_length(list) == 0)
+  if (dlink_list_length(&list->list) == 0)
     return;
 
   cur_len = mlen = snprintf(modebuf, sizeof(modebuf), ":%s MODE %s -",
@@ -159,9 +159,9 @@ remove_ban_list(struct Channel *channel, const struct Client *client, dlink_list
   mbuf = modebuf + mlen;
   pbuf = parabuf;
 
-  while (list->head)
+  while (list->list.head)
   {
-    struct Ban *ban = list->head->data;
+    struct Ban *ban = list->list.head->data;
     int plen = ban->banstr_len + 2;  /* +2 = b and space */
 
     if (count >= MAXMODEPARAMS ||
@@ -338,7 +338,7 @@ ms_sjoin(struct Client *source_p, int parc, char *parv[])
     remove_ban_list(channel, origin, &channel->exceptlist, 'e');
     remove_ban_list(channel, origin, &channel->invexlist, 'I');
 
-    clear_ban_cache_list(&channel->members_local);
+    clear_ban_cache_channel(channel);
     invite_clear_list(&channel->invites);
 
     if (channel->topic[0])
@@ -53,7 +53,7 @@ do_away(struct Client *source_p, const char *message)
     /* Marking as not away */
     if (source_p->away[0])
     {
-      source_p->away[0] = '\0';
+      client_string_set(&source_p->away, NULL, 0);
 
       /* We now send this only if they were away before --is */
       sendto_server(source_p, 0, 0, ":%s AWAY", source_p->id);
@@ -81,11 +81,11 @@ do_away(struct Client *source_p, const char *message)
     source_p->connection->away.count++;
     sendto_one_numeric(source_p, &me, RPL_NOWAWAY);
 
-    if (strncmp(source_p->away, message, sizeof(source_p->away) - 1) == 0)
+    if (strncmp(source_p->away, message, AWAYLEN) == 0)
       return;
   }
 
-  strlcpy(source_p->away, message, sizeof(source_p->away));
+  client_string_set(&source_p->away, message, AWAYLEN);
   sendto_common_channels_local(source_p, true, CAP_AWAY_NOTIFY, 0, ":%s!%s@%s AWAY :%s",
                                source_p->name, source_p->username,
                                source_p->host, source_p->away);
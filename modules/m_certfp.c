@@ -26,6 +26,8 @@
 
 #include "stdinc.h"
 #include "client.h"
+#include "channel.h"
+#include "channel_mode.h"
 #include "ircd.h"
 #include "send.h"
 #include "parse.h"
@@ -52,6 +54,7 @@ ms_certfp(struct Client *source_p, int parc, char *parv[])
 
   xfree(source_p->tls_certfp);
   source_p->tls_certfp = xstrdup(parv[1]);
+  clear_ban_cache_client(source_p);
 
   sendto_server(source_p, 0, 0, ":%s CERTFP %s",
                 source_p->id, source_p->tls_certfp);
@@ -33,7 +33,6 @@
 #include "send.h"
 #include "parse.h"
 #include "modules.h"
-#include "channel.h"
 
 
 /*! \brief HASH command handler
@@ -49,75 +48,32 @@
 static void
 mo_hash(struct Client *source_p, int parc, char *parv[])
 {
-  unsigned int i = 0;
-  unsigned int max_chain = 0;
-  unsigned int buckets   = 0;
-  unsigned int count     = 0;
-  const struct Client *cl = NULL;
-  const struct Client *icl = NULL;
-  const struct Channel *ch = NULL;
-
-  for (i = 0; i < HASHSIZE; ++i)
+  static const struct
   {
-    if ((cl = hash_get_bucket(HASH_TYPE_CLIENT, i)))
-    {
-      unsigned int len = 0;
-
-      ++buckets;
-      for (; cl; cl = cl->hnext)
-        ++len;
-      if (len > max_chain)
-        max_chain = len;
-      count += len;
-    }
-  }
-
-  sendto_one_notice(source_p, &me, ":Client: entries: %u buckets: %u "
-                    "max chain: %u", count, buckets, max_chain);
-
-  count     = 0;
-  buckets   = 0;
-  max_chain = 0;
-
-  for (i = 0; i < HASHSIZE; ++i)
+    const char *name;
+    int type;
+  } tables[] =
   {
-    if ((ch = hash_get_bucket(HASH_TYPE_CHANNEL, i)))
-    {
-      unsigned int len = 0;
-
-      ++buckets;
-      for (; ch; ch = ch->hnextch)
-        ++len;
-      if (len > max_chain)
-        max_chain = len;
-      count += len;
-    }
-  }
-
-  sendto_one_notice(source_p, &me, ":Channel: entries: %u buckets: %u "
-                    "max chain: %u", count, buckets, max_chain);
-
-  count     = 0;
-  buckets   = 0;
-  max_chain = 0;
-
-  for (i = 0; i < HASHSIZE; ++i)
+    { "Client", HASH_TYPE_CLIENT },
+    { "Channel", HASH_TYPE_CHANNEL },
+    { "Id", HASH_TYPE_ID },
+    { "Member", HASH_TYPE_MEMBER },
+    { "String", HASH_TYPE_STRING },
+    { "Whowas", HASH_TYPE_WHOWAS },
+    { "Ban", HASH_TYPE_BAN }
+  };
+
+  for (unsigned int i = 0; i < sizeof(tables) / sizeof(tables[0]); ++i)
   {
-    if ((icl = hash_get_bucket(HASH_TYPE_ID, i)))
-    {
-      unsigned int len = 0;
-
-      ++buckets;
-      for (; icl; icl = icl->idhnext)
-        ++len;
-      if (len > max_chain)
-        max_chain = len;
-      count += len;
-    }
+    struct hash_stats hs;
+
+    hash_get_stats(tables[i].type, &hs);
+    sendto_one_notice(source_p, &me, ":%s: entries: %u slots: %u "
+                      "avg probe: %.2f max probe: %u migrating: %u",
+                      tables[i].name, hs.count, hs.size,
+                      hs.count - hs.migrating ? (double)hs.probes_total / (hs.count - hs.migrating) : 0.0,
+                      hs.probes_max, hs.migrating);
   }
-
-  sendto_one_notice(source_p, &me, ":Id: entries: %u buckets: %u "
-                    "max chain: %u", count, buckets, max_chain);
 }
 
 static struct Message hash_msgtab =
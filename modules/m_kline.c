@@ -55,14 +55,15 @@ kline_check(const struct AddressRec *arec)
     if (IsDead(client))
       continue;
 
-    if (match(arec->username, client->username))
+    if (match_compiled(arec->conf->user_mask, client->username))
       continue;
 
     switch (arec->masktype)
     {
       case HM_HOST:
-        if (match(arec->Mask.hostname, client->realhost) == 0 ||
-            match(arec->Mask.hostname, client->sockhost) == 0 || match(arec->Mask.hostname, client->host) == 0)
+        if (match_compiled(arec->conf->host_mask, client->realhost) == 0 ||
+            match_compiled(arec->conf->host_mask, client->sockhost) == 0 ||
+            match_compiled(arec->conf->host_mask, client->host) == 0)
           conf_try_ban(client, CLIENT_BAN_KLINE, arec->conf->reason);
         break;
       case HM_IPV6:
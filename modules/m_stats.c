@@ -49,12 +49,17 @@
 #include "event.h"
 #include "modules.h"
 #include "whowas.h"
+#include "intern.h"
 #include "monitor.h"
 #include "reslib.h"
 #include "motd.h"
 #include "ipcache.h"
+#include "dbuf.h"
+#include "hash.h"
+#include "memory.h"
 #include "channel.h"
 #include "channel_invite.h"
+#include "ban_index.h"
 
 
 static const char *
@@ -337,10 +342,19 @@ stats_memory(struct Client *source_p, int parc, char *parv[])
   size_t channel_except_memory = 0;
   size_t channel_invex_memory = 0;
 
+  unsigned int ban_index_count = 0;  /* ban lists with an index */
+  size_t ban_index_memory = 0;
+  unsigned int mask_trie_count = 0;  /* nodes of X-line and RESV mask tries */
+  size_t mask_trie_memory = 0;
+
   unsigned int safelist_count = 0;
   size_t safelist_memory = 0;
 
   size_t wwm = 0;               /* whowas array memory used       */
+
+  unsigned int interned_count = 0;  /* distinct interned strings */
+  size_t interned_memory = 0;
+  uintmax_t interned_refs = 0;
   size_t mem_ips_stored = 0;        /* memory used by ip address hash */
 
   unsigned int local_client_count  = 0;
@@ -383,14 +397,14 @@ stats_memory(struct Client *source_p, int parc, char *parv[])
     channel_members += dlink_list_length(&channel->members);
     channel_invites += dlink_list_length(&channel->invites);
 
-    channel_bans += dlink_list_length(&channel->banlist);
-    channel_ban_memory += dlink_list_length(&channel->banlist) * sizeof(struct Ban);
+    channel_bans += dlink_list_length(&channel->banlist.list);
+    channel_ban_memory += dlink_list_length(&channel->banlist.list) * sizeof(struct Ban);
 
-    channel_except += dlink_list_length(&channel->exceptlist);
-    channel_except_memory += dlink_list_length(&channel->exceptlist) * sizeof(struct Ban);
+    channel_except += dlink_list_length(&channel->exceptlist.list);
+    channel_except_memory += dlink_list_length(&channel->exceptlist.list) * sizeof(struct Ban);
 
-    channel_invex += dlink_list_length(&channel->invexlist);
-    channel_invex_memory += dlink_list_length(&channel->invexlist) * sizeof(struct Ban);
+    channel_invex += dlink_list_length(&channel->invexlist.list);
+    channel_invex_memory += dlink_list_length(&channel->invexlist.list) * sizeof(struct Ban);
   }
 
   safelist_count = dlink_list_length(&listing_client_list);
@@ -441,6 +455,21 @@ stats_memory(struct Client *source_p, int parc, char *parv[])
                      dlink_list_length(resv_nick_get_list()),
                      dlink_list_length(resv_nick_get_list()) * sizeof(struct ResvItem));
 
+  resv_count_memory(&mask_trie_count, &mask_trie_memory);
+  sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
+                     "z :Resv mask tries %u(%zu)",
+                     mask_trie_count, mask_trie_memory);
+
+  sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
+                     "z :Gecos %u(%zu)",
+                     dlink_list_length(gecos_get_list()),
+                     dlink_list_length(gecos_get_list()) * sizeof(struct GecosItem));
+
+  gecos_count_memory(&mask_trie_count, &mask_trie_memory);
+  sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
+                     "z :Gecos mask trie %u(%zu)",
+                     mask_trie_count, mask_trie_memory);
+
   listener_count_memory(&listener_count, &listener_memory);
   sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
                      "z :Listeners %u(%zu)",
@@ -468,6 +497,11 @@ stats_memory(struct Client *source_p, int parc, char *parv[])
                      "z :Invex %u(%zu)",
                      channel_invex, channel_invex_memory);
 
+  ban_index_count_memory(&ban_index_count, &ban_index_memory);
+  sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
+                     "z :Ban indexes %u(%zu)",
+                     ban_index_count, ban_index_memory);
+
   sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
                      "z :Channel members %u(%zu) invites %u(%zu)",
                      channel_members,
@@ -483,13 +517,67 @@ stats_memory(struct Client *source_p, int parc, char *parv[])
   sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
                      "z :Whowas users %u(%zu)", wwu, wwm);
 
+  intern_count_memory(&interned_count, &interned_memory, &interned_refs);
+  sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
+                     "z :Interned strings %u(%zu) references %ju",
+                     interned_count, interned_memory, interned_refs);
+
   motd_memory_count(source_p);
 
+  for (unsigned int i = 0; i < DBUF_POOL_COUNT; ++i)
+  {
+    size_t block_size;
+    unsigned int used, unused, peak;
+
+    dbuf_pool_stats(i, &block_size, &used, &unused, &peak);
+    sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
+                       "z :dbuf %zu byte blocks in use %u(%zu) free %u(%zu) peak %u",
+                       block_size, used, used * (sizeof(struct dbuf_block) + block_size),
+                       unused, unused * (sizeof(struct dbuf_block) + block_size), peak);
+  }
+
+  DLINK_FOREACH(node, mem_cache_get_list()->head)
+  {
+    const struct mem_cache *const cache = node->data;
+    const unsigned int slabs = dlink_list_length(&cache->partial) +
+                               dlink_list_length(&cache->full) +
+                               dlink_list_length(&cache->empty);
+
+    sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
+                       "z :slab %s %zu byte objects live %u(%zu) peak %u slabs %u(%zu) empty %u",
+                       cache->name, cache->stride, cache->live, cache->live * cache->stride,
+                       cache->peak, slabs, slabs * mem_cache_slab_size(),
+                       dlink_list_length(&cache->empty));
+  }
+
   ipcache_get_stats(&number_ips_stored, &mem_ips_stored);
   sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
                      "z :iphash %u(%zu)",
                      number_ips_stored, mem_ips_stored);
 
+  static const char *const hash_names[] =
+  {
+    [HASH_TYPE_ID] = "id",
+    [HASH_TYPE_CLIENT] = "client",
+    [HASH_TYPE_CHANNEL] = "channel",
+    [HASH_TYPE_MEMBER] = "member",
+    [HASH_TYPE_STRING] = "string",
+    [HASH_TYPE_WHOWAS] = "whowas",
+    [HASH_TYPE_BAN] = "ban"
+  };
+
+  for (unsigned int i = 0; i < sizeof(hash_names) / sizeof(hash_names[0]); ++i)
+  {
+    struct hash_stats hs;
+
+    hash_get_stats(i, &hs);
+    sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
+                       "z :%s hash %u(%zu) slots %u load %u%% probes avg %.2f max %u migrating %u",
+                       hash_names[i], hs.count, hs.memory, hs.size, hs.count * 100 / hs.size,
+                       hs.count - hs.migrating ? (double)hs.probes_total / (hs.count - hs.migrating) : 0.0,
+                       hs.probes_max, hs.migrating);
+  }
+
   local_client_memory_used = local_client_count * (sizeof(struct Client) + sizeof(struct Connection));
   sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
                      "z :Local client Memory in use: %u(%zu)",
@@ -606,24 +694,45 @@ stats_exempt(struct Client *source_p, int parc, char *parv[])
   }
 }
 
+static int
+stats_events_cmp(const void *a, const void *b)
+{
+  const struct event *const ev_a = *(const struct event *const *)a;
+  const struct event *const ev_b = *(const struct event *const *)b;
+
+  return (ev_a->next > ev_b->next) - (ev_a->next < ev_b->next);
+}
+
 static void
 stats_events(struct Client *source_p, int parc, char *parv[])
 {
-  dlink_node *node;
-
   sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
                      "E :Operation                      Next Execution");
   sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
                      "E :---------------------------------------------");
 
-  DLINK_FOREACH(node, event_get_list()->head)
+  const unsigned int count = event_count();
+  const struct event **list = xcalloc(sizeof(*list) * (count + 1));
+
+  for (unsigned int i = 0; i < count; ++i)
+    list[i] = event_get(i);
+
+  qsort(list, count, sizeof(*list), stats_events_cmp);
+
+  for (unsigned int i = 0; i < count; ++i)
   {
-    const struct event *ev = node->data;
+    const struct event *ev = list[i];
+    uintmax_t next = 0;
+
+    if (ev->next > event_base->time.msec_monotonic)
+      next = ev->next - event_base->time.msec_monotonic;
 
     sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
                        "E :%-30s %-4ju seconds",
-                       ev->name, ev->next - event_base->time.sec_monotonic);
+                       ev->name, next / 1000);
   }
+
+  xfree(list);
 }
 
 static void
@@ -637,6 +746,9 @@ stats_fdlist(struct Client *source_p, int parc, char *parv[])
       sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
                          "F :fd %-5d desc '%s'", F->fd, F->desc);
   }
+
+  sendto_one_numeric(source_p, &me, RPL_STATSDEBUG | SND_EXPLICIT,
+                     "F :I/O interest changes %ju", ServerStats.is_ctl);
 }
 
 static void
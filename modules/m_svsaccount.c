@@ -26,6 +26,9 @@
 
 #include "stdinc.h"
 #include "client.h"
+#include "channel.h"
+#include "channel_mode.h"
+#include "intern.h"
 #include "ircd.h"
 #include "send.h"
 #include "parse.h"
@@ -60,7 +63,8 @@ ms_svsaccount(struct Client *source_p, int parc, char *parv[])
   if (ts && (ts != target_p->tsinfo))
     return;
 
-  strlcpy(target_p->account, parv[3], sizeof(target_p->account));
+  intern_set(&target_p->account, parv[3], ACCOUNTLEN);
+  clear_ban_cache_client(target_p);
   sendto_common_channels_local(target_p, true, CAP_ACCOUNT_NOTIFY, 0, ":%s!%s@%s ACCOUNT %s",
                                target_p->name, target_p->username,
                                target_p->host, target_p->account);
@@ -111,7 +111,7 @@ ms_svsnick(struct Client *source_p, int parc, char *parv[])
   }
 
   target_p->tsinfo = new_ts;
-  clear_ban_cache_list(&target_p->channel);
+  clear_ban_cache_client(target_p);
   monitor_signoff(target_p);
 
   if (HasUMode(target_p, UMODE_REGISTERED))
@@ -133,7 +133,7 @@ ms_svsnick(struct Client *source_p, int parc, char *parv[])
                 target_p->id, new_nick, target_p->tsinfo);
 
   hash_del_client(target_p);
-  strlcpy(target_p->name, new_nick, sizeof(target_p->name));
+  client_set_name(target_p, new_nick);
   hash_add_client(target_p);
 
   monitor_signon(target_p);
@@ -26,6 +26,7 @@
 
 #include "stdinc.h"
 #include "client.h"
+#include "intern.h"
 #include "irc_string.h"
 #include "ircd.h"
 #include "numeric.h"
@@ -70,10 +71,10 @@ mr_user(struct Client *source_p, int parc, char *parv[])
     if (p)
       *p = '\0';
 
-    strlcpy(source_p->username, username, sizeof(source_p->username));
+    intern_set(&source_p->username, username, USERLEN);
   }
 
-  strlcpy(source_p->info, realname, sizeof(source_p->info));
+  client_string_set(&source_p->info, realname, REALLEN);
   source_p->connection->registration &= ~REG_NEED_USER;
 
   if (source_p->connection->registration == 0)
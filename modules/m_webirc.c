@@ -27,6 +27,7 @@
 #include "stdinc.h"
 #include "list.h"
 #include "client.h"
+#include "intern.h"
 #include "ircd.h"
 #include "send.h"
 #include "irc_string.h"
@@ -112,16 +113,18 @@ mr_webirc(struct Client *source_p, int parc, char *parv[])
   source_p->ip.ss_len = res->ai_addrlen;
   freeaddrinfo(res);
 
-  strlcpy(source_p->sockhost, addr, sizeof(source_p->sockhost));
+  char buf[HOSTIPLEN + 1];
+  strlcpy(buf, addr, sizeof(buf));
 
-  if (source_p->sockhost[0] == ':')
+  if (buf[0] == ':')
   {
-    memmove(source_p->sockhost + 1, source_p->sockhost, sizeof(source_p->sockhost) - 1);
-    source_p->sockhost[0] = '0';
+    memmove(buf + 1, buf, sizeof(buf) - 1);
+    buf[0] = '0';
   }
 
-  strlcpy(source_p->host, host, sizeof(source_p->host));
-  strlcpy(source_p->realhost, host, sizeof(source_p->realhost));
+  intern_set(&source_p->sockhost, buf, HOSTIPLEN);
+  intern_set(&source_p->host, host, HOSTLEN);
+  intern_set(&source_p->realhost, host, HOSTLEN);
 
   /* Check dlines now, k-lines will be checked on registration */
   conf = find_dline_conf(&source_p->ip);
@@ -46,7 +46,6 @@ static void
 do_whowas(struct Client *source_p, char *parv[])
 {
   int count = 0, max = -1;
-  dlink_node *node;
 
   if (!EmptyString(parv[2]))
     max = atoi(parv[2]);
@@ -54,32 +53,28 @@ do_whowas(struct Client *source_p, char *parv[])
   if (!MyConnect(source_p) && (max <= 0 || max > WHOWAS_MAX_REPLIES))
     max = WHOWAS_MAX_REPLIES;
 
-  DLINK_FOREACH(node, whowas_get_hash(strhash(parv[1]))->head)
+  for (const struct Whowas *whowas = whowas_find(parv[1]); whowas;
+       whowas = whowas_next(whowas))
   {
-    const struct Whowas *whowas = node->data;
-
-    if (irccmp(parv[1], whowas->name) == 0)
-    {
-      sendto_one_numeric(source_p, &me, RPL_WHOWASUSER, whowas->name,
-                         whowas->username, whowas->hostname,
-                         whowas->realname);
-
-      if (HasUMode(source_p, UMODE_OPER))
-        sendto_one_numeric(source_p, &me, RPL_WHOISACTUALLY, whowas->name,
-                           whowas->username, whowas->realhost,
-                           whowas->sockhost);
-
-      if (strcmp(whowas->account, "*"))
-        sendto_one_numeric(source_p, &me, RPL_WHOISACCOUNT, whowas->name, whowas->account, "was");
-
-      if ((whowas->server_hidden || ConfigServerHide.hide_servers) && !HasUMode(source_p, UMODE_OPER))
-        sendto_one_numeric(source_p, &me, RPL_WHOISSERVER, whowas->name,
-                           ConfigServerInfo.network_name, date_ctime(whowas->logoff));
-      else
-        sendto_one_numeric(source_p, &me, RPL_WHOISSERVER, whowas->name,
-                           whowas->servername, date_ctime(whowas->logoff));
-      ++count;
-    }
+    sendto_one_numeric(source_p, &me, RPL_WHOWASUSER, whowas->name,
+                       whowas->username, whowas->hostname,
+                       whowas->realname);
+
+    if (HasUMode(source_p, UMODE_OPER))
+      sendto_one_numeric(source_p, &me, RPL_WHOISACTUALLY, whowas->name,
+                         whowas->username, whowas->realhost,
+                         whowas->sockhost);
+
+    if (strcmp(whowas->account, "*"))
+      sendto_one_numeric(source_p, &me, RPL_WHOISACCOUNT, whowas->name, whowas->account, "was");
+
+    if ((whowas->server_hidden || ConfigServerHide.hide_servers) && !HasUMode(source_p, UMODE_OPER))
+      sendto_one_numeric(source_p, &me, RPL_WHOISSERVER, whowas->name,
+                         ConfigServerInfo.network_name, date_ctime(whowas->logoff));
+    else
+      sendto_one_numeric(source_p, &me, RPL_WHOISSERVER, whowas->name,
+                         whowas->servername, date_ctime(whowas->logoff));
+    ++count;
 
     if (max > 0 && count >= max)
       break;
@@ -55,7 +55,7 @@ xline_check(const struct GecosItem *gecos)
     if (IsDead(client))
       continue;
 
-    if (match(gecos->mask, client->info) == 0)
+    if (gecos_match(gecos, client->info))
       conf_try_ban(client, CLIENT_BAN_XLINE, gecos->reason);
   }
 }
@@ -97,8 +97,7 @@ xline_handle(struct Client *source_p, const struct aline_ctx *aline)
   else
     snprintf(buf, sizeof(buf), "%.*s (%s)", REASONLEN, aline->reason, date_iso8601(0));
 
-  gecos = gecos_make();
-  gecos->mask = xstrdup(aline->mask);
+  gecos = gecos_make(aline->mask);
   gecos->reason = xstrdup(buf);
   gecos->setat = event_base->time.sec_real;
   gecos->in_database = true;
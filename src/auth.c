@@ -42,6 +42,7 @@
 #include "auth.h"
 #include "conf.h"
 #include "client.h"
+#include "intern.h"
 #include "event.h"
 #include "irc_string.h"
 #include "ircd.h"
@@ -193,7 +194,7 @@ auth_dns_callback(void *vptr, const struct irc_ssaddr *addr, const char *name, s
     auth_sendheader(auth->client, REPORT_HOST_INVALID);
   else
   {
-    strlcpy(auth->client->host, name, sizeof(auth->client->host));
+    intern_set(&auth->client->host, name, HOSTLEN);
     auth_sendheader(auth->client, REPORT_FIN_DNS);
   }
 
@@ -347,7 +348,7 @@ auth_read_reply(fde_t *F, void *data)
   }
   else
   {
-    strlcpy(auth->client->username, username, sizeof(auth->client->username));
+    intern_set(&auth->client->username, username, USERLEN);
     auth_sendheader(auth->client, REPORT_FIN_ID);
     ++ServerStats.is_asuc;
     AddFlag(auth->client, FLAGS_GOTID);
@@ -0,0 +1,458 @@
+/*
+ *  ircd-hybrid: an advanced, lightweight Internet Relay Chat Daemon (ircd)
+ *
+ *  Copyright (c) 1997-2022 ircd-hybrid development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ *  USA
+ */
+
+/*! \file ban_index.c
+ * \brief Lookup structures over channel ban, exception and invex lists.
+ * \version $Id$
+ *
+ * Every entry of a list is filed in exactly one place, so a lookup only
+ * has to check the entries that could possibly match the client:
+ *
+ *  - extbans go into a group per extban type: the acting one if there
+ *    is one, otherwise the matching one
+ *  - CIDR bans go into a patricia trie per address family, so only the
+ *    networks containing the client's address are looked at
+ *  - host bans whose mask ends in a fixed tail, such as *!*\@*.example.com
+ *    or *!*\@host.example.com, go into the ban host hash table, keyed by
+ *    the list and that tail from the '.' after the last wildcard on, the
+ *    same way auth{} blocks and K-lines are hashed in hostmask.c. The
+ *    client's hosts are looked up there once for every '.' they contain
+ *  - everything else stays on a residual list
+ *
+ * Candidates are checked with ban_matches() just like before, so the
+ * index only decides which entries are looked at, never whether one
+ * matches.
+ */
+
+#include "stdinc.h"
+#include "list.h"
+#include "channel.h"
+#include "client.h"
+#include "hash.h"
+#include "conf.h"
+#include "hostmask.h"
+#include "irc_string.h"
+#include "memory.h"
+#include "patricia.h"
+#include "extban.h"
+#include "ban_index.h"
+
+
+/*! \brief Where in the index a Ban is filed; Ban::index_type */
+enum
+{
+  BAN_INDEX_RESIDUAL,
+  BAN_INDEX_EXTBAN,
+  BAN_INDEX_IPV4,
+  BAN_INDEX_IPV6,
+  BAN_INDEX_HOST
+};
+
+/*! \brief Extbans of one list with the same acting, or else matching, type */
+struct BanGroup
+{
+  dlink_node node;
+  unsigned int flag;  /**< Extban::flag */
+  dlink_list bans;
+};
+
+struct BanIndex
+{
+  patricia_tree_t *ipv4;  /**< IPv4 CIDR bans; node data is a dlink_list of them */
+  patricia_tree_t *ipv6;  /**< IPv6 CIDR bans; node data is a dlink_list of them */
+  unsigned int hosts;  /**< Number of bans in the ban host table */
+  dlink_list groups;  /**< struct BanGroup */
+  dlink_list residual;
+};
+
+static unsigned int ban_index_count;
+static size_t ban_index_memory;
+
+
+/*! \brief Finds the fixed tail of a host mask a ban can be hashed by
+ * \param host Host part of the ban
+ * \return Start of the tail within host, or NULL if there is none
+ */
+static const char *
+ban_index_suffix(const char *host)
+{
+  const char *suffix = NULL;
+
+  /* Escaped characters would have to be unescaped first; not worth it */
+  if (strchr(host, '\\'))
+    return NULL;
+
+  for (const char *p = host + strlen(host); p > host; --p)
+  {
+    if (IsMWildChar(*(p - 1)))
+      return suffix;
+
+    if (*(p - 1) == '.' && *p)
+      suffix = p;
+  }
+
+  return host;  /* No wildcards at all */
+}
+
+static struct BanGroup *
+ban_index_group(const struct BanIndex *index, unsigned int flag)
+{
+  dlink_node *node;
+
+  DLINK_FOREACH(node, index->groups.head)
+  {
+    struct BanGroup *group = node->data;
+
+    if (group->flag == flag)
+      return group;
+  }
+
+  return NULL;
+}
+
+static patricia_tree_t **
+ban_index_tree(struct BanIndex *index, int type)
+{
+  return type == BAN_INDEX_IPV4 ? &index->ipv4 : &index->ipv6;
+}
+
+/*! \brief Files a ban that has just been put on a list
+ * \param list List the ban is on
+ * \param ban  The ban
+ */
+void
+ban_index_add(struct BanList *list, struct Ban *ban)
+{
+  struct BanIndex *index = list->index;
+
+  if (index == NULL)
+  {
+    index = list->index = xcalloc(sizeof(*index));
+    ++ban_index_count;
+    ban_index_memory += sizeof(*index);
+  }
+
+  if (ban->extban)
+  {
+    unsigned int flag = ban->extban & extban_acting_mask();
+    if (flag == 0)
+      flag = ban->extban;
+
+    struct BanGroup *group = ban_index_group(index, flag);
+    if (group == NULL)
+    {
+      group = xcalloc(sizeof(*group));
+      group->flag = flag;
+      dlinkAdd(group, &group->node, &index->groups);
+      ban_index_memory += sizeof(*group);
+    }
+
+    ban->index_type = BAN_INDEX_EXTBAN;
+    ban->index_bucket = group;
+    dlinkAdd(ban, &ban->index_node, &group->bans);
+    return;
+  }
+
+  if ((ban->type == HM_IPV4 || ban->type == HM_IPV6) && ban->bits > 0)
+  {
+    ban->index_type = ban->type == HM_IPV4 ? BAN_INDEX_IPV4 : BAN_INDEX_IPV6;
+
+    patricia_tree_t **tree = ban_index_tree(index, ban->index_type);
+    if (*tree == NULL)
+      *tree = patricia_new(ban->type == HM_IPV4 ? 32 : 128);
+
+    patricia_node_t *pnode = patricia_make_and_lookup_addr(*tree, (struct sockaddr *)&ban->addr, ban->bits);
+    if (pnode->data == NULL)
+    {
+      PATRICIA_DATA_SET(pnode, xcalloc(sizeof(dlink_list)));
+      ban_index_memory += sizeof(dlink_list) + sizeof(patricia_node_t) + sizeof(prefix_t);
+    }
+
+    ban->index_bucket = pnode;
+    dlinkAdd(ban, &ban->index_node, PATRICIA_DATA_GET(pnode, dlink_list));
+    return;
+  }
+
+  const char *suffix = ban->type == HM_HOST ? ban_index_suffix(ban->host) : NULL;
+  if (suffix)
+  {
+    char folded[HOSTLEN + 1];
+    size_t len = 0;
+
+    for (; suffix[len]; ++len)
+      folded[len] = ToLower(suffix[len]);
+
+    struct BanHost *host = hash_find_ban_host(list, folded, len);
+    if (host == NULL)
+    {
+      host = xcalloc(sizeof(*host) + len + 1);
+      host->owner = list;
+      host->hash = hash_ban_host(list, folded, len);
+      host->len = len;
+      memcpy(host->suffix, folded, len);
+      hash_add_ban_host(host);
+      ban_index_memory += sizeof(*host) + len + 1;
+    }
+
+    ++index->hosts;
+    ban->index_type = BAN_INDEX_HOST;
+    ban->index_bucket = host;
+    dlinkAdd(ban, &ban->index_node, &host->bans);
+    return;
+  }
+
+  ban->index_type = BAN_INDEX_RESIDUAL;
+  ban->index_bucket = NULL;
+  dlinkAdd(ban, &ban->index_node, &index->residual);
+}
+
+/*! \brief Unfiles a ban that has just been taken off a list
+ * \param list List the ban was on
+ * \param ban  The ban
+ */
+void
+ban_index_del(struct BanList *list, struct Ban *ban)
+{
+  struct BanIndex *const index = list->index;
+
+  assert(index);
+
+  switch (ban->index_type)
+  {
+    case BAN_INDEX_EXTBAN:
+    {
+      struct BanGroup *group = ban->index_bucket;
+
+      dlinkDelete(&ban->index_node, &group->bans);
+      if (group->bans.head == NULL)
+      {
+        dlinkDelete(&group->node, &index->groups);
+        xfree(group);
+        ban_index_memory -= sizeof(*group);
+      }
+
+      break;
+    }
+
+    case BAN_INDEX_IPV4:
+    case BAN_INDEX_IPV6:
+    {
+      patricia_tree_t **tree = ban_index_tree(index, ban->index_type);
+      patricia_node_t *pnode = ban->index_bucket;
+      dlink_list *bans = PATRICIA_DATA_GET(pnode, dlink_list);
+
+      dlinkDelete(&ban->index_node, bans);
+      if (bans->head == NULL)
+      {
+        xfree(bans);
+        PATRICIA_DATA_SET(pnode, NULL);
+        patricia_remove(*tree, pnode);
+        ban_index_memory -= sizeof(dlink_list) + sizeof(patricia_node_t) + sizeof(prefix_t);
+
+        if ((*tree)->head == NULL)
+        {
+          patricia_destroy(*tree, NULL);
+          *tree = NULL;
+        }
+      }
+
+      break;
+    }
+
+    case BAN_INDEX_HOST:
+    {
+      struct BanHost *host = ban->index_bucket;
+
+      --index->hosts;
+      dlinkDelete(&ban->index_node, &host->bans);
+      if (host->bans.head == NULL)
+      {
+        hash_del_ban_host(host);
+        ban_index_memory -= sizeof(*host) + host->len + 1;
+        xfree(host);
+      }
+
+      break;
+    }
+
+    default:
+      dlinkDelete(&ban->index_node, &index->residual);
+      break;
+  }
+
+  if (list->list.head == NULL)
+  {
+    assert(index->ipv4 == NULL && index->ipv6 == NULL);
+    assert(index->hosts == 0 && index->groups.head == NULL && index->residual.head == NULL);
+
+    xfree(index);
+    list->index = NULL;
+    --ban_index_count;
+    ban_index_memory -= sizeof(*index);
+  }
+}
+
+static struct Ban *
+ban_index_find_list(const dlink_list *bans, struct Client *client, struct Channel *channel)
+{
+  dlink_node *node;
+
+  DLINK_FOREACH(node, bans->head)
+  {
+    struct Ban *ban = node->data;
+
+    if (ban_matches(client, channel, ban))
+      return ban;
+  }
+
+  return NULL;
+}
+
+static struct Ban *
+ban_index_find_address(patricia_tree_t *tree, struct Client *client, struct Channel *channel)
+{
+  patricia_node_t *pnodes[PATRICIA_MAXBITS + 1];
+  const int count = patricia_search_all_addr(tree, (struct sockaddr *)&client->ip, pnodes);
+
+  for (int i = 0; i < count; ++i)
+  {
+    struct Ban *ban = ban_index_find_list(PATRICIA_DATA_GET(pnodes[i], dlink_list), client, channel);
+    if (ban)
+      return ban;
+  }
+
+  return NULL;
+}
+
+static struct Ban *
+ban_index_find_host(const struct BanList *list, const char *name, struct Client *client, struct Channel *channel)
+{
+  char folded[HOSTLEN + 1];
+  size_t len = 0;
+
+  for (; name[len] && len < sizeof(folded); ++len)
+    folded[len] = ToLower(name[len]);
+
+  if (len == sizeof(folded))
+    return NULL;  /* No ban host can be that long */
+
+  for (const char *p = folded; p; )
+  {
+    const struct BanHost *host = hash_find_ban_host(list, p, len - (p - folded));
+
+    if (host)
+    {
+      struct Ban *ban = ban_index_find_list(&host->bans, client, channel);
+      if (ban)
+        return ban;
+    }
+
+    if ((p = memchr(p, '.', len - (p - folded))))
+      ++p;
+  }
+
+  return NULL;
+}
+
+/*! \brief Finds an entry of a list matching a client
+ * \param list    List to search
+ * \param client  Client to check
+ * \param channel Channel the list belongs to
+ * \param extban  Acting extban to look for, or NULL for everything
+ *                that is not an acting extban; see find_bmask()
+ * \return A matching entry, or NULL
+ */
+struct Ban *
+ban_index_find(const struct BanList *list, struct Client *client, struct Channel *channel,
+               const struct Extban *extban)
+{
+  const struct BanIndex *const index = list->index;
+  struct Ban *ban;
+  dlink_node *node;
+
+  if (index == NULL)
+    return NULL;
+
+  if (extban)
+  {
+    const struct BanGroup *group;
+
+    if (extban->flag & extban_acting_mask())
+      return (group = ban_index_group(index, extban->flag)) ? ban_index_find_list(&group->bans, client, channel) : NULL;
+
+    /* Matching extbans are filed under their acting type, if any */
+    DLINK_FOREACH(node, list->list.head)
+    {
+      ban = node->data;
+
+      if ((ban->extban & extban->flag) && ban_matches(client, channel, ban))
+        return ban;
+    }
+
+    return NULL;
+  }
+
+  DLINK_FOREACH(node, index->groups.head)
+  {
+    const struct BanGroup *group = node->data;
+
+    if (!(group->flag & extban_acting_mask()))
+      if ((ban = ban_index_find_list(&group->bans, client, channel)))
+        return ban;
+  }
+
+  if (index->ipv4 && client->ip.ss.ss_family == AF_INET)
+    if ((ban = ban_index_find_address(index->ipv4, client, channel)))
+      return ban;
+
+  if (index->ipv6 && client->ip.ss.ss_family == AF_INET6)
+    if ((ban = ban_index_find_address(index->ipv6, client, channel)))
+      return ban;
+
+  if (index->hosts)
+  {
+    const char *const hosts[] = { client->realhost, client->sockhost, client->host };
+
+    for (unsigned int i = 0; i < sizeof(hosts) / sizeof(hosts[0]); ++i)
+    {
+      bool seen = EmptyString(hosts[i]);
+
+      /* Interned, so the same host is usually the same pointer */
+      for (unsigned int j = 0; j < i && seen == false; ++j)
+        seen = hosts[j] == hosts[i];
+
+      if (seen)
+        continue;
+
+      if ((ban = ban_index_find_host(list, hosts[i], client, channel)))
+        return ban;
+    }
+  }
+
+  return ban_index_find_list(&index->residual, client, channel);
+}
+
+void
+ban_index_count_memory(unsigned int *const count, size_t *const bytes)
+{
+  *count = ban_index_count;
+  *bytes = ban_index_memory;
+}
@@ -43,11 +43,20 @@
 #include "memory.h"
 #include "misc.h"
 #include "extban.h"
+#include "scan.h"
+#include "ban_index.h"
 
 
 /** Doubly linked list containing a list of all channels. */
 static dlink_list channel_list;
 
+static struct mem_cache channel_cache = { .name = "Channel", .size = sizeof(struct Channel) };
+static struct mem_cache member_cache = { .name = "ChannelMember", .size = sizeof(struct ChannelMember) };
+static struct mem_cache ban_cache = { .name = "Ban", .size = sizeof(struct Ban) };
+
+/** member_find_link() walks membership lists up to this long instead of hashing */
+enum { MEMBER_SCAN_MAX = 4 };
+
 
 /*! \brief Returns the channel_list as constant
  * \return channel_list
@@ -64,8 +73,9 @@ channel_get_list(void)
  * \param client     Pointer to client (who) to add
  * \param flags      Flags for chanops etc
  * \param flood_ctrl Whether to count this join in flood calculations
+ * \return Pointer to the new ChannelMember
  */
-void
+struct ChannelMember *
 add_user_to_channel(struct Channel *channel, struct Client *client,
                     unsigned int flags, bool flood_ctrl)
 {
@@ -102,17 +112,19 @@ add_user_to_channel(struct Channel *channel, struct Client *client,
     channel->last_join_time = event_base->time.sec_monotonic;
   }
 
-  struct ChannelMember *member = xcalloc(sizeof(*member));
+  struct ChannelMember *member = mem_cache_alloc(&member_cache);
   member->client = client;
   member->channel = channel;
   member->flags = flags;
 
   dlinkAdd(member, &member->channode, &channel->members);
+  hash_add_member(member);
 
   if (MyConnect(client))
     dlinkAdd(member, &member->locchannode, &channel->members_local);
 
   dlinkAdd(member, &member->usernode, &client->channel);
+  return member;
 }
 
 /*! \brief Deletes an user from a channel by removing a link in the
@@ -131,8 +143,9 @@ remove_user_from_channel(struct ChannelMember *member)
     dlinkDelete(&member->locchannode, &channel->members_local);
 
   dlinkDelete(&member->usernode, &client->channel);
+  hash_del_member(member);
 
-  xfree(member);
+  mem_cache_free(&member_cache, member);
 
   if (channel->members.head == NULL)
     channel_free(channel);
@@ -308,9 +321,9 @@ channel_send_modes(struct Client *client, const struct Channel *channel)
   channel_modes(channel, client, NULL, modebuf, parabuf);
   channel_send_members(client, channel, modebuf, parabuf);
 
-  channel_send_mask_list(client, channel, &channel->banlist, 'b');
-  channel_send_mask_list(client, channel, &channel->exceptlist, 'e');
-  channel_send_mask_list(client, channel, &channel->invexlist, 'I');
+  channel_send_mask_list(client, channel, &channel->banlist.list, 'b');
+  channel_send_mask_list(client, channel, &channel->exceptlist.list, 'e');
+  channel_send_mask_list(client, channel, &channel->invexlist.list, 'I');
 }
 
 /*! \brief Check channel name for invalid characters
@@ -344,25 +357,49 @@ channel_check_name(const char *name, bool local)
   return p - name <= CHANNELLEN;
 }
 
+/*! \brief Allocates a zeroed Ban; release it with ban_free() or remove_ban() */
+struct Ban *
+ban_make(void)
+{
+  return mem_cache_alloc(&ban_cache);
+}
+
+void
+ban_free(struct Ban *ban)
+{
+  match_mask_free(ban->name_mask);
+  match_mask_free(ban->user_mask);
+  match_mask_free(ban->host_mask);
+  mem_cache_free(&ban_cache, ban);
+}
+
 void
-remove_ban(struct Ban *ban, dlink_list *list)
+add_ban(struct Ban *ban, struct BanList *list)
 {
-  dlinkDelete(&ban->node, list);
-  xfree(ban);
+  dlinkAdd(ban, &ban->node, &list->list);
+  ban_index_add(list, ban);
+}
+
+void
+remove_ban(struct Ban *ban, struct BanList *list)
+{
+  dlinkDelete(&ban->node, &list->list);
+  ban_index_del(list, ban);
+  ban_free(ban);
 }
 
 /* channel_free_mask_list()
  *
- * inputs       - pointer to dlink_list
+ * inputs       - pointer to ban list
  * output       - NONE
  * side effects -
  */
 static void
-channel_free_mask_list(dlink_list *list)
+channel_free_mask_list(struct BanList *list)
 {
-  while (list->head)
+  while (list->list.head)
   {
-    struct Ban *ban = list->head->data;
+    struct Ban *ban = list->list.head->data;
     remove_ban(ban, list);
   }
 }
@@ -377,8 +414,7 @@ channel_make(const char *name)
 {
   assert(!EmptyString(name));
 
-  struct Channel *channel = xcalloc(sizeof(*channel));
-  channel->hnextch = channel;
+  struct Channel *channel = mem_cache_alloc(&channel_cache);
   /* Doesn't hurt to set it here */
   channel->creation_time = event_base->time.sec_real;
   channel->last_join_time = event_base->time.sec_monotonic;
@@ -388,6 +424,10 @@ channel_make(const char *name)
   if (channel->name_len >= sizeof(channel->name))
     channel->name_len = sizeof(channel->name) - 1;
 
+  /* And the folded form the channel hash table compares against */
+  irc_fold(channel->name_folded, channel->name, sizeof(channel->name_folded));
+  channel->name_hash = hash_folded(channel->name_folded, channel->name_len);
+
   dlinkAdd(channel, &channel->node, &channel_list);
   hash_add_channel(channel);
 
@@ -410,7 +450,7 @@ channel_free(struct Channel *channel)
   dlinkDelete(&channel->node, &channel_list);
   hash_del_channel(channel);
 
-  assert(channel->hnextch == channel);
+  assert(hash_find_channel(channel->name) != channel);
 
   assert(channel->node.prev == NULL);
   assert(channel->node.next == NULL);
@@ -427,19 +467,22 @@ channel_free(struct Channel *channel)
   assert(channel->invites.head == NULL);
   assert(channel->invites.tail == NULL);
 
-  assert(dlink_list_length(&channel->banlist) == 0);
-  assert(channel->banlist.head == NULL);
-  assert(channel->banlist.tail == NULL);
+  assert(dlink_list_length(&channel->banlist.list) == 0);
+  assert(channel->banlist.list.head == NULL);
+  assert(channel->banlist.list.tail == NULL);
+  assert(channel->banlist.index == NULL);
 
-  assert(dlink_list_length(&channel->exceptlist) == 0);
-  assert(channel->exceptlist.head == NULL);
-  assert(channel->exceptlist.tail == NULL);
+  assert(dlink_list_length(&channel->exceptlist.list) == 0);
+  assert(channel->exceptlist.list.head == NULL);
+  assert(channel->exceptlist.list.tail == NULL);
+  assert(channel->exceptlist.index == NULL);
 
-  assert(dlink_list_length(&channel->invexlist) == 0);
-  assert(channel->invexlist.head == NULL);
-  assert(channel->invexlist.tail == NULL);
+  assert(dlink_list_length(&channel->invexlist.list) == 0);
+  assert(channel->invexlist.list.head == NULL);
+  assert(channel->invexlist.list.tail == NULL);
+  assert(channel->invexlist.index == NULL);
 
-  xfree(channel);
+  mem_cache_free(&channel_cache, channel);
 }
 
 /*!
@@ -596,7 +639,7 @@ member_get_prefix_len(const struct ChannelMember *member, bool combine)
  * \param list   Pointer to ban list to search
  * \return true if ban found for given n!u\@h mask, false otherwise
  */
-static bool
+bool
 ban_matches(struct Client *client, struct Channel *channel, struct Ban *ban)
 {
   /* Is a matching extban, call custom match handler */
@@ -612,13 +655,15 @@ ban_matches(struct Client *client, struct Channel *channel, struct Ban *ban)
     return true;
   }
 
-  if (match(ban->name, client->name) == 0 && match(ban->user, client->username) == 0)
+  if (match_compiled(ban->name_mask, client->name) == 0 &&
+      match_compiled(ban->user_mask, client->username) == 0)
   {
     switch (ban->type)
     {
       case HM_HOST:
-        if (match(ban->host, client->realhost) == 0 ||
-            match(ban->host, client->sockhost) == 0 || match(ban->host, client->host) == 0)
+        if (match_compiled(ban->host_mask, client->realhost) == 0 ||
+            match_compiled(ban->host_mask, client->sockhost) == 0 ||
+            match_compiled(ban->host_mask, client->host) == 0)
           return true;
         break;
       case HM_IPV6:
@@ -634,39 +679,17 @@ ban_matches(struct Client *client, struct Channel *channel, struct Ban *ban)
   return false;
 }
 
+/*! \brief Checks whether any entry of a ban, exception or invex list matches a client
+ * \param client  Pointer to Client to check
+ * \param channel Channel the list belongs to
+ * \param list    Pointer to ban list to search
+ * \param extban  Acting extban to look for; NULL skips acting extbans
+ * \return true if an entry matches, false otherwise
+ */
 bool
-find_bmask(struct Client *client, struct Channel *channel, const dlink_list *list, struct Extban *extban)
+find_bmask(struct Client *client, struct Channel *channel, const struct BanList *list, struct Extban *extban)
 {
-  dlink_node *node;
-
-  DLINK_FOREACH(node, list->head)
-  {
-    struct Ban *ban = node->data;
-
-    /* Looking for a specific type of extban? */
-    if (extban)
-    {
-      if (!(ban->extban & extban->flag))
-        continue;
-    }
-    else
-    {
-      /*
-       * Acting extbans have their own time they act and are not general purpose bans,
-       * so skip them unless we are hunting them.
-       */
-      if (ban->extban & extban_acting_mask())
-        continue;
-    }
-
-    bool matches = ban_matches(client, channel, ban);
-    if (matches == false)
-      continue;
-
-    return true;
-  }
-
-  return false;
+  return ban_index_find(list, client, channel, extban) != NULL;
 }
 
 /*!
@@ -735,21 +758,28 @@ member_find_link(const struct Client *client, const struct Channel *channel)
   if (!IsClient(client))
     return NULL;
 
-  /* Take the shortest of the two lists */
-  if (dlink_list_length(&channel->members) < dlink_list_length(&client->channel))
+  /*
+   * Walking a handful of list nodes is cheaper than a probe into the
+   * membership table, which is likely not to be in cache. Anything
+   * longer goes to the table.
+   */
+  if (dlink_list_length(&client->channel) <= MEMBER_SCAN_MAX)
   {
-    DLINK_FOREACH(node, channel->members.head)
-      if (((struct ChannelMember *)node->data)->client == client)
+    DLINK_FOREACH(node, client->channel.head)
+      if (((struct ChannelMember *)node->data)->channel == channel)
         return node->data;
+    return NULL;
   }
-  else
+
+  if (dlink_list_length(&channel->members) <= MEMBER_SCAN_MAX)
   {
-    DLINK_FOREACH(node, client->channel.head)
-      if (((struct ChannelMember *)node->data)->channel == channel)
+    DLINK_FOREACH(node, channel->members.head)
+      if (((struct ChannelMember *)node->data)->client == client)
         return node->data;
+    return NULL;
   }
 
-  return NULL;
+  return hash_find_member(client, channel);
 }
 
 /*! Checks if a message contains control codes
@@ -759,12 +789,16 @@ member_find_link(const struct Client *client, const struct Channel *channel)
 static bool
 msg_has_ctrls(const char *message)
 {
-  const unsigned char *p = (const unsigned char *)message;
+  const char *p = message;
+  const char *const end = message + strlen(message);
 
-  for (; *p; ++p)
+  while ((p = scan_find_ctrl(p, end - p)))
   {
-    if (*p > 31 || *p == 1)
-      continue;  /* No control code or CTCP */
+    if (*p == 1)
+    {
+      ++p;  /* CTCP */
+      continue;
+    }
 
     if (*p == 27)  /* Escape */
     {
@@ -772,7 +806,7 @@ msg_has_ctrls(const char *message)
       if (*(p + 1) == '$' ||
           *(p + 1) == '(')
       {
-        ++p;
+        p += 2;
         continue;
       }
     }
@@ -783,6 +817,29 @@ msg_has_ctrls(const char *message)
   return false;  /* No control code found */
 }
 
+/*! \brief Returns the RESV covering a channel's name, looking it up again
+ *         only if channel RESVs have changed since the last time
+ * \param channel Pointer to channel
+ * \return Pointer to the matching ResvItem, or NULL if there is none
+ */
+static const struct ResvItem *
+channel_find_resv(struct Channel *channel)
+{
+  /*
+   * Temporary RESVs are removed by resv_find() once they have expired, so
+   * an expired one has to go through there too rather than being handed out.
+   */
+  if (channel->resv_generation != resv_chan_get_generation() ||
+      (channel->resv && channel->resv->expire &&
+       channel->resv->expire <= event_base->time.sec_real))
+  {
+    channel->resv = resv_find(channel->name, match);
+    channel->resv_generation = resv_chan_get_generation();
+  }
+
+  return channel->resv;
+}
+
 /*! Tests if a client can send to a channel
  * \param channel Pointer to Channel struct
  * \param client  Pointer to Client struct
@@ -803,7 +860,7 @@ can_send(struct Channel *channel, struct Client *client,
 
   if (MyConnect(client) && !HasFlag(client, FLAGS_EXEMPTRESV))
     if (!(HasUMode(client, UMODE_OPER) && HasOFlag(client, OPER_FLAG_JOIN_RESV)))
-      if ((resv = resv_find(channel->name, match)) && resv_exempt_find(client, resv) == false)
+      if ((resv = channel_find_resv(channel)) && resv_exempt_find(client, resv) == false)
         return ERR_CANNOTSENDTOCHAN;
 
   if (HasCMode(channel, MODE_NOCTRL) && msg_has_ctrls(message) == true)
@@ -834,6 +891,8 @@ can_send(struct Channel *channel, struct Client *client,
   {
     if (member)
     {
+      check_ban_cache(member);
+
       if (member->flags & CHFL_BAN_SILENCED)
         return ERR_CANNOTSENDTOCHAN;
 
@@ -945,6 +1004,7 @@ channel_do_join(struct Client *client, char *chan_list, char *key_list)
                    name = strtok_r(NULL,      ",", &p))
   {
     const char *key = NULL;
+    bool ban_checked = false;
 
     /* If we have any more keys, take the first for this channel. */
     if (!EmptyString(key_list) && (key_list = strchr(key = key_list, ',')))
@@ -992,6 +1052,8 @@ channel_do_join(struct Client *client, char *chan_list, char *key_list)
         continue;
       }
 
+      ban_checked = true;
+
       /*
        * This should never be the case unless there is some sort of
        * persistent channels.
@@ -1010,7 +1072,14 @@ channel_do_join(struct Client *client, char *chan_list, char *key_list)
     if (!HasUMode(client, UMODE_OPER))
       check_spambot_warning(client, channel->name);
 
-    add_user_to_channel(channel, client, flags, true);
+    struct ChannelMember *member = add_user_to_channel(channel, client, flags, true);
+
+    /* can_join() has just found the client not to be banned; save can_send() the work */
+    if (ban_checked == true)
+    {
+      check_ban_cache(member);
+      member->flags |= CHFL_BAN_CHECKED;
+    }
 
     /*
      * Set timestamp if appropriate, and propagate
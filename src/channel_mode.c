@@ -101,7 +101,7 @@ get_mask(const struct Ban *ban)
  */
 
 const char *
-add_id(struct Client *client, struct Channel *channel, const char *banid, dlink_list *list, unsigned int type)
+add_id(struct Client *client, struct Channel *channel, const char *banid, struct BanList *list, unsigned int type)
 {
   dlink_node *node;
   char mask[MODEBUFLEN];
@@ -112,9 +112,9 @@ add_id(struct Client *client, struct Channel *channel, const char *banid, dlink_
 
   if (MyClient(client))
   {
-    unsigned int num_mask = dlink_list_length(&channel->banlist) +
-                            dlink_list_length(&channel->exceptlist) +
-                            dlink_list_length(&channel->invexlist);
+    unsigned int num_mask = dlink_list_length(&channel->banlist.list) +
+                            dlink_list_length(&channel->exceptlist.list) +
+                            dlink_list_length(&channel->invexlist.list);
 
     /* Don't let local clients overflow the b/e/I lists */
     if (num_mask >= ((HasCMode(channel, MODE_EXTLIMIT)) ? ConfigChannel.max_bans_large :
@@ -173,7 +173,7 @@ add_id(struct Client *client, struct Channel *channel, const char *banid, dlink_
   if (EmptyString(maskptr))
     return NULL;
 
-  struct Ban *ban = xcalloc(sizeof(*ban));
+  struct Ban *ban = ban_make();
   ban->extban = extbans;
   ban->when = event_base->time.sec_real;
 
@@ -205,18 +205,26 @@ add_id(struct Client *client, struct Channel *channel, const char *banid, dlink_
   else
     ban->banstr_len = strlcpy(ban->banstr, banid, sizeof(ban->banstr));
 
-  DLINK_FOREACH(node, list->head)
+  DLINK_FOREACH(node, list->list.head)
   {
     const struct Ban *tmp = node->data;
 
     if (irccmp(tmp->banstr, ban->banstr) == 0)
     {
-      xfree(ban);
+      ban_free(ban);
       return NULL;
     }
   }
 
-  clear_ban_cache_list(&channel->members_local);
+  if (etype != EXTBAN_MATCHING)
+  {
+    ban->name_mask = match_compile(ban->name);
+    ban->user_mask = match_compile(ban->user);
+  }
+
+  ban->host_mask = match_compile(ban->host);
+
+  clear_ban_cache_channel(channel);
 
   if (IsClient(client))
     snprintf(ban->who, sizeof(ban->who), "%s!%s@%s", client->name,
@@ -226,7 +234,7 @@ add_id(struct Client *client, struct Channel *channel, const char *banid, dlink_
   else
     strlcpy(ban->who, client->name, sizeof(ban->who));
 
-  dlinkAdd(ban, &ban->node, list);
+  add_ban(ban, list);
 
   return ban->banstr;
 }
@@ -239,7 +247,7 @@ add_id(struct Client *client, struct Channel *channel, const char *banid, dlink_
  * side effects	-
  */
 static const char *
-del_id(struct Client *client, struct Channel *channel, const char *banid, dlink_list *list, unsigned int type)
+del_id(struct Client *client, struct Channel *channel, const char *banid, struct BanList *list, unsigned int type)
 {
   static char mask[MODEBUFLEN];
   dlink_node *node;
@@ -248,14 +256,14 @@ del_id(struct Client *client, struct Channel *channel, const char *banid, dlink_
 
   /* TBD: n!u@h formatting fo local clients */
 
-  DLINK_FOREACH(node, list->head)
+  DLINK_FOREACH(node, list->list.head)
   {
     struct Ban *ban = node->data;
 
     if (irccmp(banid, ban->banstr) == 0)
     {
       strlcpy(mask, ban->banstr, sizeof(mask));  /* caSe might be different in 'banid' */
-      clear_ban_cache_list(&channel->members_local);
+      clear_ban_cache_channel(channel);
       remove_ban(ban, list);
 
       return mask;
@@ -331,21 +339,53 @@ fix_key(char *arg)
   return arg;
 }
 
+/*
+ * Channel::ban_generation and Client::ban_generation are drawn from this
+ * counter whenever something bans are matched against changes, so no two
+ * changes ever share a value.  ChannelMember::ban_generation records the
+ * counter at the time the CHFL_BAN_* cache flags were set; they are still
+ * good as long as neither the channel nor the client has changed since,
+ * i.e. neither generation is newer than the member's.
+ */
+static uint64_t ban_generation;
+
 /*
  * inputs       - pointer to channel
  * output       - none
- * side effects - clear ban cache
+ * side effects - invalidates the ban cache of all members of the channel
  */
 void
-clear_ban_cache_list(dlink_list *list)
+clear_ban_cache_channel(struct Channel *channel)
 {
-  dlink_node *node;
+  channel->ban_generation = ++ban_generation;
+}
 
-  DLINK_FOREACH(node, list->head)
-  {
-    struct ChannelMember *member = node->data;
-    member->flags &= ~(CHFL_BAN_SILENCED | CHFL_BAN_CHECKED | CHFL_MUTE_CHECKED);
-  }
+/*
+ * inputs       - pointer to client
+ * output       - none
+ * side effects - invalidates the ban cache of all memberships of the client
+ */
+void
+clear_ban_cache_client(struct Client *client)
+{
+  client->ban_generation = ++ban_generation;
+}
+
+/*
+ * inputs       - pointer to channel member
+ * output       - none
+ * side effects - drops the cached ban flags of the member if the channel's
+ *                ban lists or the client have changed since they were set
+ */
+void
+check_ban_cache(struct ChannelMember *member)
+{
+  if (member->ban_generation >= member->channel->ban_generation &&
+      member->ban_generation >= member->client->ban_generation)
+    return;
+
+  member->flags &= ~(CHFL_BAN_SILENCED | CHFL_BAN_CHECKED | CHFL_MUTE_CHECKED);
+  member->ban_generation = ban_generation;
 }
 
 /*
@@ -450,7 +490,7 @@ chm_mask(struct Client *client, struct Channel *channel, int parc, int *parn, ch
          int *errors, int alev, int dir, const char c, const struct chan_mode *mode)
 {
   const char *ret = NULL;
-  dlink_list *list;
+  struct BanList *list;
   enum irc_numerics rpl_list = 0, rpl_endlist = 0;
   int errtype = 0;
 
@@ -487,7 +527,7 @@ chm_mask(struct Client *client, struct Channel *channel, int parc, int *parn, ch
 
     *errors |= errtype;
 
-    DLINK_FOREACH(node, list->head)
+    DLINK_FOREACH(node, list->list.head)
     {
       const struct Ban *ban = node->data;
 
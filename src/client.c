@@ -27,8 +27,10 @@
 #include "stdinc.h"
 #include "list.h"
 #include "client.h"
+#include "intern.h"
 #include "client_svstag.h"
 #include "event.h"
+#include "timer.h"
 #include "hash.h"
 #include "irc_string.h"
 #include "ircd.h"
@@ -63,8 +65,14 @@ dlink_list global_server_list;
 dlink_list oper_list;
 
 static dlink_list dead_list, abort_list;
+
+static struct mem_cache client_cache = { .name = "Client", .size = sizeof(struct Client), .align = 64 };
+static struct mem_cache connection_cache = { .name = "Connection", .size = sizeof(struct Connection) };
 static dlink_node *eac_next;  /* next aborted client to exit */
 
+/* Unregistered connections are dropped after this many seconds */
+enum { REGISTRATION_TIMEOUT = 30 };
+
 
 /*
  * client_make - create a new Client struct and set it to initial state.
@@ -84,14 +92,14 @@ static dlink_node *eac_next;  /* next aborted client to exit */
 struct Client *
 client_make(struct Client *from)
 {
-  struct Client *client = xcalloc(sizeof(*client));
+  struct Client *client = mem_cache_alloc(&client_cache);
 
   if (from)
     client->from = from;
   else
   {
     client->from = client;  /* 'from' of local client is self! */
-    client->connection = xcalloc(sizeof(*client->connection));
+    client->connection = mem_cache_alloc(&connection_cache);
     client->connection->last_data = event_base->time.sec_monotonic;
     client->connection->last_ping = event_base->time.sec_monotonic;
     client->connection->created_real = event_base->time.sec_real;
@@ -100,13 +108,18 @@ client_make(struct Client *from)
 
     /* as good a place as any... */
     dlinkAdd(client, &client->connection->lclient_node, &unknown_list);
+    client_ping_schedule(client);
   }
 
-  client->idhnext = client;
-  client->hnext = client;
+  client->away = "";
+  client->info = "";
+  client->host = "";
+  client->realhost = "";
+  client->sockhost = "";
+
   SetUnknown(client);
-  strcpy(client->username, "unknown");
-  strcpy(client->account, "*");
+  client->username = intern_string("unknown", USERLEN);
+  client->account = intern_string("*", ACCOUNTLEN);
 
   return client;
 }
@@ -123,8 +136,8 @@ client_free(struct Client *client)
 {
   assert(!IsMe(client));
   assert(client != &me);
-  assert(client->hnext == client);
-  assert(client->idhnext == client);
+  assert(hash_find_client(client->name) != client);
+  assert(hash_find_id(client->id) != client);
 
   assert(client->node.prev == NULL);
   assert(client->node.next == NULL);
@@ -146,6 +159,13 @@ client_free(struct Client *client)
 
 
   xfree(client->serv);
+  client_string_set(&client->away, NULL, 0);
+  client_string_set(&client->info, NULL, 0);
+  intern_release(client->username);
+  intern_release(client->host);
+  intern_release(client->account);
+  intern_release(client->realhost);
+  intern_release(client->sockhost);
   xfree(client->tls_certfp);
   xfree(client->tls_cipher);
 
@@ -153,6 +173,9 @@ client_free(struct Client *client)
   {
     assert(client->connection->lclient_node.prev == NULL);
     assert(client->connection->lclient_node.next == NULL);
+    assert(client->connection->ping_timer.bucket == NULL);
+
+    assert(!HasFlag(client, FLAGS_FLUSH));
 
     assert(client->connection->list_task == NULL);
     assert(client->connection->auth == NULL);
@@ -190,99 +213,89 @@ client_free(struct Client *client)
     dbuf_clear(&client->connection->buf_recvq);
     dbuf_clear(&client->connection->buf_sendq);
 
-    xfree(client->connection);
+    mem_cache_free(&connection_cache, client->connection);
     client->connection = NULL;
   }
 
-  xfree(client);
+  mem_cache_free(&client_cache, client);
 }
 
-/* check_pings_list()
+/* client_check_ping()
  *
- * inputs	- pointer to list to check
+ * inputs	- pointer to a registered local client or server
  * output	- NONE
- * side effects	-
+ * side effects	- the connection is sent a PING if it has been idle for
+ *		  longer than its ping frequency, and is exited if it
+ *		  hasn't answered within another ping frequency
  */
 static void
-check_pings_list(dlink_list *list)
+client_check_ping(struct Client *client)
 {
   char buf[32];  /* 32 = sizeof("Ping timeout: 999999999 seconds") */
-  dlink_node *node, *node_next;
+  unsigned int ping = get_client_ping(&client->connection->confs);
 
-  DLINK_FOREACH_SAFE(node, node_next, list->head)
+  if (ping < event_base->time.sec_monotonic - client->connection->last_ping)
   {
-    struct Client *client = node->data;
-    assert(IsClient(client) || IsServer(client));
-
-    if (IsDead(client))
-      continue;  /* Ignore it, it's been exited already */
-
-    unsigned int ping = get_client_ping(&client->connection->confs);
-    if (ping < event_base->time.sec_monotonic - client->connection->last_ping)
+    if (!HasFlag(client, FLAGS_PINGSENT))
+    {
+      /*
+       * If we haven't PINGed the connection and we haven't
+       * heard from it in a while, PING it to make sure
+       * it is still alive.
+       */
+      AddFlag(client, FLAGS_PINGSENT);
+      client->connection->last_ping = event_base->time.sec_monotonic - ping;
+      sendto_one(client, "PING :%s", ID_or_name(&me, client));
+      send_queued_write(client);  /* Don't let the PING wait for the next flush */
+    }
+    else
     {
-      if (!HasFlag(client, FLAGS_PINGSENT))
+      if (event_base->time.sec_monotonic - client->connection->last_ping >= 2 * ping)
       {
         /*
-         * If we haven't PINGed the connection and we haven't
-         * heard from it in a while, PING it to make sure
-         * it is still alive.
+         * If the client/server hasn't talked to us in 2*ping seconds
+         * and it has a ping time, then close its connection.
          */
-        AddFlag(client, FLAGS_PINGSENT);
-        client->connection->last_ping = event_base->time.sec_monotonic - ping;
-        sendto_one(client, "PING :%s", ID_or_name(&me, client));
-      }
-      else
-      {
-        if (event_base->time.sec_monotonic - client->connection->last_ping >= 2 * ping)
+        if (IsServer(client))
         {
-          /*
-           * If the client/server hasn't talked to us in 2*ping seconds
-           * and it has a ping time, then close its connection.
-           */
-          if (IsServer(client))
-          {
-            sendto_realops_flags(UMODE_SERVNOTICE, L_ADMIN, SEND_NOTICE,
-                                 "No response from %s, closing link",
-                                 client_get_name(client, SHOW_IP));
-            sendto_realops_flags(UMODE_SERVNOTICE, L_OPER, SEND_NOTICE,
-                                 "No response from %s, closing link",
-                                 client_get_name(client, MASK_IP));
-            ilog(LOG_TYPE_IRCD, "No response from %s, closing link",
-                 client_get_name(client, SHOW_IP));
-          }
-
-          snprintf(buf, sizeof(buf), "Ping timeout: %ju seconds",
-                   (event_base->time.sec_monotonic - client->connection->last_ping));
-          exit_client(client, buf);
+          sendto_realops_flags(UMODE_SERVNOTICE, L_ADMIN, SEND_NOTICE,
+                               "No response from %s, closing link",
+                               client_get_name(client, SHOW_IP));
+          sendto_realops_flags(UMODE_SERVNOTICE, L_OPER, SEND_NOTICE,
+                               "No response from %s, closing link",
+                               client_get_name(client, MASK_IP));
+          ilog(LOG_TYPE_IRCD, "No response from %s, closing link",
+               client_get_name(client, SHOW_IP));
         }
+
+        snprintf(buf, sizeof(buf), "Ping timeout: %ju seconds",
+                 (event_base->time.sec_monotonic - client->connection->last_ping));
+        exit_client(client, buf);
+        return;
       }
     }
   }
+
+  client_ping_schedule(client);
 }
 
-/* check_unknowns_list()
+/* client_check_unknown()
  *
- * inputs       - pointer to list of unknown clients
+ * inputs       - pointer to an unregistered local connection
  * output       - NONE
  * side effects - unknown clients get marked for termination after n seconds
  */
 static void
-check_unknowns_list(void)
+client_check_unknown(struct Client *client)
 {
-  dlink_node *node, *node_next;
+  bool exit = false;
 
-  DLINK_FOREACH_SAFE(node, node_next, unknown_list.head)
+  /*
+   * Check UNKNOWN connections - if they have been in this state
+   * for > 30s, close them.
+   */
+  if ((event_base->time.sec_monotonic - client->connection->created_monotonic) > REGISTRATION_TIMEOUT)
   {
-    struct Client *client = node->data;
-    bool exit = false;
-
-    /*
-     * Check UNKNOWN connections - if they have been in this state
-     * for > 30s, close them.
-     */
-    if ((event_base->time.sec_monotonic - client->connection->created_monotonic) <= 30)
-      continue;
-
     if (IsHandshake(client))
     {
       sendto_realops_flags(UMODE_SERVNOTICE, L_ADMIN, SEND_NOTICE,
@@ -297,43 +310,99 @@ check_unknowns_list(void)
     }
     else if (HasFlag(client, FLAGS_FINISHED_AUTH))
       exit = true;
-
-    if (exit == true)
-      exit_client(client, "Registration timed out");
   }
+
+  if (exit == true)
+    exit_client(client, "Registration timed out");
+  else
+    client_ping_schedule(client);
 }
 
 /*
- * check_pings - go through the local client list and check activity
- * kill off stuff that should die
- *
- * inputs       - NOT USED (from event)
- * side effects -
- *
+ * client_ping_timeout - called from the timer wheel once a local
+ * connection has reached its ping or registration deadline.
  *
- * A PING can be sent to clients as necessary.
- *
- * Client/Server ping outs are handled.
+ * The deadline isn't moved every time data is read from the connection.
+ * Instead, once the timer fires, the connection's actual state is looked
+ * at, and the timer is simply re-armed for the new deadline if there is
+ * nothing to do yet. This way, only connections that have been idle for a
+ * whole ping period, or haven't registered in time, are ever visited.
  */
+static void
+client_ping_timeout(void *data)
+{
+  struct Client *client = data;
+
+  if (IsDead(client))
+    return;  /* Ignore it, it's been exited already */
+
+  if (IsClient(client) || IsServer(client))
+    client_check_ping(client);
+  else
+    client_check_unknown(client);
+}
 
 /*
- * Addon from adrian. We used to call this after nextping seconds,
- * however I've changed it to run once a second. This is only for
- * PING timeouts, not K/etc-line checks (thanks dianora!). Having it
- * run once a second makes life a lot easier - when a new client connects
- * and they need a ping in 4 seconds, if nextping was set to 20 seconds
- * we end up waiting 20 seconds. This is stupid. :-)
- * I will optimise (hah!) check_pings() once I've finished working on
- * tidying up other network IO evilnesses.
- *     -- adrian
+ * client_set_name - set a client's name together with the case-folded
+ * copy and hash the client hash table uses. The client must not be in
+ * the client hash table while its name is changed.
  */
+void
+client_set_name(struct Client *client, const char *name)
+{
+  strlcpy(client->name, name, sizeof(client->name));
 
-static void
-check_pings(void *unused)
+  client->name_len = irc_fold(client->name_folded, client->name, sizeof(client->name_folded));
+  client->name_hash = hash_folded(client->name_folded, client->name_len);
+}
+
+/*
+ * client_string_set - replace one of the out of line strings of a client
+ * (away, info, realhost, sockhost) with at most len characters of value.
+ * A NULL or empty value leaves the field pointing to a shared "".
+ */
+void
+client_string_set(const char **field, const char *value, size_t len)
 {
-  check_pings_list(&local_client_list);
-  check_pings_list(&local_server_list);
-  check_unknowns_list();
+  if (**field)
+    mem_strfree(*field);
+
+  if (EmptyString(value) || len == 0)
+    *field = "";
+  else
+    *field = mem_strndup(value, len);
+}
+
+/*
+ * client_ping_schedule - arm the ping timer of a local connection for its
+ * next ping or registration deadline. Must be called again once the
+ * connection has registered.
+ */
+void
+client_ping_schedule(struct Client *client)
+{
+  uintmax_t deadline;
+
+  assert(MyConnect(client));
+
+  if (IsClient(client) || IsServer(client))
+  {
+    const unsigned int ping = get_client_ping(&client->connection->confs);
+
+    if (HasFlag(client, FLAGS_PINGSENT))
+      deadline = client->connection->last_ping + 2 * ping;
+    else
+      deadline = client->connection->last_ping + ping + 1;
+  }
+  else
+    deadline = client->connection->created_monotonic + REGISTRATION_TIMEOUT + 1;
+
+  /* Unknown connections still waiting for auth/connect are looked at once a second */
+  if (deadline <= event_base->time.sec_monotonic)
+    deadline = event_base->time.sec_monotonic + 1;
+
+  timer_add(&client->connection->ping_timer, (deadline - event_base->time.sec_monotonic) * 1000,
+            client_ping_timeout, client);
 }
 
 /* check_conf_klines()
@@ -555,13 +624,23 @@ void
 free_exited_clients(void)
 {
   dlink_node *node, *node_next;
+  bool split = false;
 
   DLINK_FOREACH_SAFE(node, node_next, dead_list.head)
   {
-    client_free(node->data);
+    struct Client *client = node->data;
+
+    if (IsServer(client))
+      split = true;
+
+    client_free(client);
     dlinkDelete(node, &dead_list);
     free_dlink_node(node);
   }
+
+  /* A split frees everything behind the server at once; give the memory back */
+  if (split == true)
+    mem_cache_trim();
 }
 
 /*
@@ -574,17 +653,21 @@ client_close_connection(struct Client *client)
 {
   assert(client);
 
+  /*
+   * There is still a chance that we might send data to this socket
+   * even if it is marked as blocked (COMM_SELECT_READ handler is called
+   * before COMM_SELECT_WRITE). Let's try, nothing to lose.. -adx
+   */
   if (!IsDead(client))
-  {
-    /* Attempt to flush any pending dbufs. Evil, but .. -- adrian */
-    /*
-     * There is still a chance that we might send data to this socket
-     * even if it is marked as blocked (COMM_SELECT_READ handler is called
-     * before COMM_SELECT_WRITE). Let's try, nothing to lose.. -adx
-     */
     DelFlag(client, FLAGS_BLOCKED);
-    send_queued_write(client);
-  }
+
+  /*
+   * Attempt to flush any pending dbufs. Evil, but .. -- adrian
+   * This also takes a dead client off the flush list.
+   */
+  send_queued_write(client);
+
+  timer_del(&client->connection->ping_timer);
 
   if (IsClient(client))
   {
@@ -1114,22 +1197,3 @@ client_get_idle_time(const struct Client *source_p,
 
   return idle;
 }
-
-/* client_init()
- *
- * inputs       - NONE
- * output       - NONE
- * side effects - initialize client free memory
- */
-void
-client_init(void)
-{
-  static struct event event_ping =
-  {
-    .name = "check_pings",
-    .handler = check_pings,
-    .when = 5
-  };
-
-  event_add(&event_ping, NULL);
-}
@@ -38,6 +38,7 @@
 #include "server.h"
 #include "channel.h"
 #include "client.h"
+#include "intern.h"
 #include "event.h"
 #include "irc_string.h"
 #include "s_bsd.h"
@@ -215,6 +216,8 @@ conf_free(struct MaskItem *conf)
   xfree(conf->whois);
   xfree(conf->user);
   xfree(conf->host);
+  match_mask_free(conf->user_mask);
+  match_mask_free(conf->host_mask);
   xfree(conf->addr);
   xfree(conf->bind);
   xfree(conf->cipher_list);
@@ -308,13 +311,13 @@ verify_access(struct Client *client)
   }
 
   if (!HasFlag(client, FLAGS_GOTID) && !IsNoTilde(conf))
-    strlcpy(client->username, username, sizeof(client->username));
+    intern_set(&client->username, username, USERLEN);
 
   /* Preserve x->host in x->realhost before it gets overwritten. */
-  strlcpy(client->realhost, client->host, sizeof(client->realhost));
+  intern_set(&client->realhost, client->host, HOSTLEN);
 
   if (IsConfDoSpoofIp(conf))
-    strlcpy(client->host, conf->name, sizeof(client->host));
+    intern_set(&client->host, conf->name, HOSTLEN);
 
   return attach_iline(client, conf);
 }
@@ -666,7 +669,7 @@ conf_read(FILE *file)
   yyparse();  /* Load the values from the conf */
   conf_validate();  /* Check to make sure some values are still okay. */
                     /* Some global values are also loaded here. */
-  whowas_trim();  /* Attempt to trim whowas list if necessary */
+  whowas_resize();  /* Resize the whowas history if its length has changed */
   class_delete_marked();  /* Delete unused classes that are marked for deletion */
 }
 
@@ -26,6 +26,7 @@
 
 #include "stdinc.h"
 #include "list.h"
+#include "irc_string.h"
 #include "send.h"
 #include "client.h"
 #include "ircd.h"
@@ -35,6 +36,7 @@
 
 
 static dlink_list gecos_list;
+static struct match_set gecos_set;  /**< GecosItem::mask of all of gecos_list */
 
 
 const dlink_list *
@@ -65,25 +67,61 @@ gecos_delete(struct GecosItem *gecos, bool expired)
                          gecos->mask);
 
   dlinkDelete(&gecos->node, &gecos_list);
+  match_set_del(&gecos_set, &gecos->set_entry);
   xfree(gecos->mask);
+  match_mask_free(gecos->mask_compiled);
   xfree(gecos->reason);
   xfree(gecos);
 }
 
 struct GecosItem *
-gecos_make(void)
+gecos_make(const char *mask)
 {
   struct GecosItem *gecos = xcalloc(sizeof(*gecos));
+  gecos->mask = xstrdup(mask);
+  gecos->mask_compiled = match_compile(mask);
   dlinkAdd(gecos, &gecos->node, &gecos_list);
+  match_set_add(&gecos_set, &gecos->set_entry, gecos->mask, gecos->mask_compiled, gecos);
 
   return gecos;
 }
 
+/*! \brief Checks a gecos field against an X-line's mask
+ * \param gecos X-line to check against
+ * \param name  Gecos field
+ * \return true if the mask matches
+ */
+bool
+gecos_match(const struct GecosItem *gecos, const char *name)
+{
+  return match_compiled(gecos->mask_compiled, name) == 0;
+}
+
 struct GecosItem *
 gecos_find(const char *name, int (*compare)(const char *, const char *))
 {
   dlink_node *node, *node_next;
 
+  /*
+   * gecos_list has the newest X-line first, so the most recently added
+   * match from gecos_set is the one a walk of the list would find first.
+   */
+  if (compare == match)
+  {
+    struct GecosItem *gecos;
+
+    while ((gecos = match_set_find(&gecos_set, name)))
+    {
+      if (gecos->expire == 0 ||
+          (gecos->expire > event_base->time.sec_real))
+        return gecos;
+
+      gecos_delete(gecos, true);
+    }
+
+    return NULL;
+  }
+
   DLINK_FOREACH_SAFE(node, node_next, gecos_list.head)
   {
     struct GecosItem *gecos = node->data;
@@ -112,3 +150,9 @@ gecos_expire(void)
       gecos_delete(gecos, true);
   }
 }
+
+void
+gecos_count_memory(unsigned int *const count, size_t *const bytes)
+{
+  match_set_count_memory(&gecos_set, count, bytes);
+}
@@ -3164,7 +3164,7 @@ yyreduce:
   {
     xfree(ConfigServerInfo.description);
     ConfigServerInfo.description = xstrdup(yylval.string);
-    strlcpy(me.info, ConfigServerInfo.description, sizeof(me.info));
+    client_string_set(&me.info, ConfigServerInfo.description, REALLEN);
   }
 }
 #line 3171 "conf_parser.c"
@@ -3387,8 +3387,9 @@ yyreduce:
       !block_state.host.buf[0])
     break;
 
-  pseudo_register(block_state.name.buf, block_state.nick.buf, block_state.host.buf,
-                  block_state.prepend.buf, block_state.command.buf);
+  if (pseudo_register(block_state.name.buf, block_state.nick.buf, block_state.host.buf,
+                      block_state.prepend.buf, block_state.command.buf) == false)
+    conf_error_report("Ignoring pseudo block -- invalid command name");
 }
 #line 3394 "conf_parser.c"
     break;
@@ -5567,8 +5568,7 @@ yyreduce:
   if (!block_state.name.buf[0])
     break;
 
-  struct GecosItem *gecos = gecos_make();
-  gecos->mask = xstrdup(block_state.name.buf);
+  struct GecosItem *gecos = gecos_make(block_state.name.buf);
 
   if (block_state.rpass.buf[0])
     gecos->reason = xstrdup(block_state.rpass.buf);
@@ -6444,7 +6444,7 @@ yyreduce:
   {
     if ((yyvsp[-1].number) > 0)
     {
-      event_write_links_file.when = (yyvsp[-1].number);
+      event_write_links_file.when = (yyvsp[-1].number) * 1000;
       event_add(&event_write_links_file, NULL);
     }
     else
@@ -558,7 +558,7 @@ serverinfo_description: DESCRIPTION '=' QSTRING ';'
   {
     xfree(ConfigServerInfo.description);
     ConfigServerInfo.description = xstrdup(yylval.string);
-    strlcpy(me.info, ConfigServerInfo.description, sizeof(me.info));
+    client_string_set(&me.info, ConfigServerInfo.description, REALLEN);
   }
 };
 
@@ -755,8 +755,9 @@ pseudo_entry: T_PSEUDO
       !block_state.host.buf[0])
     break;
 
-  pseudo_register(block_state.name.buf, block_state.nick.buf, block_state.host.buf,
-                  block_state.prepend.buf, block_state.command.buf);
+  if (pseudo_register(block_state.name.buf, block_state.nick.buf, block_state.host.buf,
+                      block_state.prepend.buf, block_state.command.buf) == false)
+    conf_error_report("Ignoring pseudo block -- invalid command name");
 };
 
 pseudo_items: pseudo_items pseudo_item | pseudo_item;
@@ -2305,8 +2306,7 @@ gecos_entry: GECOS
   if (!block_state.name.buf[0])
     break;
 
-  struct GecosItem *gecos = gecos_make();
-  gecos->mask = xstrdup(block_state.name.buf);
+  struct GecosItem *gecos = gecos_make(block_state.name.buf);
 
   if (block_state.rpass.buf[0])
     gecos->reason = xstrdup(block_state.rpass.buf);
@@ -2876,7 +2876,7 @@ serverhide_flatten_links_delay: FLATTEN_LINKS_DELAY '=' timespec ';'
   {
     if ($3 > 0)
     {
-      event_write_links_file.when = $3;
+      event_write_links_file.when = $3 * 1000;
       event_add(&event_write_links_file, NULL);
     }
     else
@@ -78,13 +78,13 @@ pseudo_message_handler(struct Client *source_p, int parc, char *parv[])
     sendto_one_numeric(source_p, &me, ERR_SERVICESDOWN, pseudo->name);
 }
 
-void
+bool
 pseudo_register(const char *name, const char *nick, const char *serv, 
                 const char *prepend,
                 const char *command)
 {
   if (find_command(command))
-    return;
+    return true;
 
   struct PseudoItem *pseudo = xcalloc(sizeof(*pseudo));
   pseudo->name = xstrdup(name);
@@ -101,9 +101,20 @@ pseudo_register(const char *name, const char *nick, const char *serv,
   pseudo->msg.handlers[SERVER_HANDLER] = (struct MessageHandler) { .handler = m_ignore };
   pseudo->msg.handlers[ENCAP_HANDLER] = (struct MessageHandler) { .handler = m_ignore };
   pseudo->msg.handlers[OPER_HANDLER] = (struct MessageHandler) { .handler = pseudo_message_handler, .args_max = 2 };
-  dlinkAdd(pseudo, &pseudo->node, &pseudo_list);
 
-  mod_add_cmd(&pseudo->msg);
+  if (mod_add_cmd(&pseudo->msg) == false)
+  {
+    xfree(pseudo->name);
+    xfree(pseudo->nick);
+    xfree(pseudo->serv);
+    xfree(pseudo->prepend);
+    xfree(pseudo->command);
+    xfree(pseudo);
+    return false;
+  }
+
+  dlinkAdd(pseudo, &pseudo->node, &pseudo_list);
+  return true;
 }
 
 void
@@ -40,6 +40,15 @@
 
 static dlink_list resv_chan_list;
 static dlink_list resv_nick_list;
+static struct match_set resv_chan_set;  /**< ResvItem::mask of all of resv_chan_list */
+static struct match_set resv_nick_set;  /**< ResvItem::mask of all of resv_nick_list */
+
+/*
+ * Changes whenever a channel RESV is added or removed, so that anything
+ * remembering the result of a resv_find() on a channel name can tell
+ * whether it is still good.  Starts at 1 so a zeroed cache is never current.
+ */
+static uint64_t resv_chan_generation = 1;
 
 
 const dlink_list *
@@ -54,6 +63,12 @@ resv_nick_get_list(void)
   return &resv_nick_list;
 }
 
+uint64_t
+resv_chan_get_generation(void)
+{
+  return resv_chan_generation;
+}
+
 void
 resv_delete(struct ResvItem *resv, bool expired)
 {
@@ -72,8 +87,17 @@ resv_delete(struct ResvItem *resv, bool expired)
     xfree(exempt);
   }
 
+  if (resv->list == &resv_chan_list)
+  {
+    match_set_del(&resv_chan_set, &resv->set_entry);
+    ++resv_chan_generation;
+  }
+  else
+    match_set_del(&resv_nick_set, &resv->set_entry);
+
   dlinkDelete(&resv->node, resv->list);
   xfree(resv->mask);
+  match_mask_free(resv->mask_compiled);
   xfree(resv->reason);
   xfree(resv);
 }
@@ -90,17 +114,27 @@ struct ResvItem *
 resv_make(const char *mask, const char *reason, const dlink_list *elist)
 {
   dlink_list *list;
+  struct match_set *set;
 
   if (IsChanPrefix(*mask))
+  {
     list = &resv_chan_list;
+    set = &resv_chan_set;
+    ++resv_chan_generation;
+  }
   else
+  {
     list = &resv_nick_list;
+    set = &resv_nick_set;
+  }
 
   struct ResvItem *resv = xcalloc(sizeof(*resv));
   resv->list = list;
   resv->mask = xstrdup(mask);
+  resv->mask_compiled = match_compile(mask);
   resv->reason = xstrndup(reason, IRCD_MIN(strlen(reason), REASONLEN));
   dlinkAdd(resv, &resv->node, resv->list);
+  match_set_add(set, &resv->set_entry, resv->mask, resv->mask_compiled, resv);
 
   if (elist)
   {
@@ -142,11 +176,35 @@ resv_find(const char *name, int (*compare)(const char *, const char *))
 {
   dlink_node *node, *node_next;
   dlink_list *list;
+  struct match_set *set;
 
   if (IsChanPrefix(*name))
+  {
     list = &resv_chan_list;
+    set = &resv_chan_set;
+  }
   else
+  {
     list = &resv_nick_list;
+    set = &resv_nick_set;
+  }
+
+  /* As with the list, the most recently added match is the first one */
+  if (compare == match)
+  {
+    struct ResvItem *resv;
+
+    while ((resv = match_set_find(set, name)))
+    {
+      if (resv->expire == 0 ||
+          (resv->expire > event_base->time.sec_real))
+        return resv;
+
+      resv_delete(resv, true);
+    }
+
+    return NULL;
+  }
 
   DLINK_FOREACH_SAFE(node, node_next, list->head)
   {
@@ -232,3 +290,16 @@ resv_expire(void)
     }
   }
 }
+
+void
+resv_count_memory(unsigned int *const count, size_t *const bytes)
+{
+  unsigned int nick_count;
+  size_t nick_bytes;
+
+  match_set_count_memory(&resv_chan_set, count, bytes);
+  match_set_count_memory(&resv_nick_set, &nick_count, &nick_bytes);
+
+  *count += nick_count;
+  *bytes += nick_bytes;
+}
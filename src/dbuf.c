@@ -29,28 +29,136 @@
 #include "dbuf.h"
 #include "memory.h"
 
+#include <sys/uio.h>
 
-struct dbuf_block *
-dbuf_alloc(void)
+
+/* Never keep more than this many unused blocks around per pool */
+enum { DBUF_POOL_FREE_MAX = 1024 };
+
+/* Initial number of slots in a queue's ring of blocks */
+enum { DBUF_RING_SIZE_MIN = 8 };
+
+static struct dbuf_block *dbuf_spare[DBUF_SPARE_MAX];  /* See dbuf_map_free() */
+
+static struct dbuf_pool
 {
-  struct dbuf_block *block = xcalloc(sizeof(*block));
+  size_t block_size;
+  struct dbuf_block *free_list;
+  unsigned int free;  /* Blocks on free_list */
+  unsigned int used;  /* Blocks handed out */
+  unsigned int peak;  /* Highest value 'used' ever had */
+} dbuf_pools[DBUF_POOL_COUNT] =
+{
+  [DBUF_POOL_SMALL] = { .block_size = DBUF_BLOCK_SIZE_SMALL },
+  [DBUF_POOL_LARGE] = { .block_size = DBUF_BLOCK_SIZE_LARGE }
+};
+
+
+static struct dbuf_block *
+dbuf_alloc_pool(unsigned int pool)
+{
+  struct dbuf_pool *const p = &dbuf_pools[pool];
+  struct dbuf_block *block = p->free_list;
+
+  /* The payload of recycled blocks isn't cleared; only 'size' bytes of it are ever valid */
+  if (block)
+  {
+    p->free_list = block->next;
+    --p->free;
+  }
+  else
+  {
+    block = xcalloc(sizeof(*block) + p->block_size);
+    block->pool = pool;
+    block->capacity = p->block_size;
+  }
+
+  block->next = NULL;
+  block->refs = 1;
+  block->size = 0;
+
+  if (++p->used > p->peak)
+    p->peak = p->used;
 
-  ++block->refs;
   return block;
 }
 
+struct dbuf_block *
+dbuf_alloc(void)
+{
+  return dbuf_alloc_pool(DBUF_POOL_SMALL);
+}
+
 void
 dbuf_ref_free(struct dbuf_block *block)
 {
-  if (--block->refs <= 0)
+  if (--block->refs > 0)
+    return;
+
+  struct dbuf_pool *const p = &dbuf_pools[block->pool];
+  --p->used;
+
+  if (p->free >= DBUF_POOL_FREE_MAX)
+  {
     xfree(block);
+    return;
+  }
+
+  block->next = p->free_list;
+  p->free_list = block;
+  ++p->free;
+}
+
+/*
+ * dbuf_pool_stats
+ *      Reports block size, blocks in use, blocks kept on the free list
+ *      and the high-water mark of blocks in use for the given pool.
+ */
+void
+dbuf_pool_stats(unsigned int pool, size_t *block_size, unsigned int *used,
+                unsigned int *unused, unsigned int *peak)
+{
+  assert(pool < DBUF_POOL_COUNT);
+
+  const struct dbuf_pool *const p = &dbuf_pools[pool];
+
+  *block_size = p->block_size;
+  *used = p->used;
+  *unused = p->free;
+  *peak = p->peak;
+}
+
+/*
+ * dbuf_append
+ *      Stores a reference to 'block' at the end of the queue, doubling
+ *      the size of the ring if it is full. The caller accounts for
+ *      the block's data in total_size.
+ */
+static void
+dbuf_append(struct dbuf_queue *queue, struct dbuf_block *block)
+{
+  if (queue->count == queue->ring_size)
+  {
+    unsigned int size = queue->ring_size ? queue->ring_size * 2 : DBUF_RING_SIZE_MIN;
+    struct dbuf_block **ring = xcalloc(size * sizeof(*ring));
+
+    for (unsigned int i = 0; i < queue->count; ++i)
+      ring[i] = dbuf_nth(queue, i);
+
+    xfree(queue->ring);
+    queue->ring = ring;
+    queue->ring_size = size;
+    queue->head = 0;
+  }
+
+  dbuf_nth(queue, queue->count++) = block;
 }
 
 void
 dbuf_add(struct dbuf_queue *queue, struct dbuf_block *block)
 {
   block->refs++;
-  dlinkAddTail(block, make_dlink_node(), &queue->blocks);
+  dbuf_append(queue, block);
   queue->total_size += block->size;
 }
 
@@ -59,8 +167,7 @@ dbuf_delete(struct dbuf_queue *queue, size_t count)
 {
   while (count > 0 && dbuf_length(queue) > 0)
   {
-    dlink_node *node = queue->blocks.head;
-    struct dbuf_block *block = node->data;
+    struct dbuf_block *block = dbuf_nth(queue, 0);
     size_t avail = block->size - queue->pos;
 
     if (count >= avail)
@@ -70,8 +177,8 @@ dbuf_delete(struct dbuf_queue *queue, size_t count)
 
       dbuf_ref_free(block);
 
-      dlinkDelete(node, &queue->blocks);
-      free_dlink_node(node);
+      queue->head = (queue->head + 1) & (queue->ring_size - 1);
+      --queue->count;
 
       queue->pos = 0;
     }
@@ -85,6 +192,52 @@ dbuf_delete(struct dbuf_queue *queue, size_t count)
   }
 }
 
+/*
+ * dbuf_clear
+ *      Drops everything in the queue and releases the ring itself.
+ */
+void
+dbuf_clear(struct dbuf_queue *queue)
+{
+  for (unsigned int i = 0; i < queue->count; ++i)
+    dbuf_ref_free(dbuf_nth(queue, i));
+
+  xfree(queue->ring);
+  memset(queue, 0, sizeof(*queue));
+}
+
+/*
+ * dbuf_tail
+ *      Returns the last block of the queue if no other queue refers to it
+ *      and it has at least 'len' bytes of free space. Otherwise a new,
+ *      empty block is appended and returned. Data written into the block
+ *      must be accounted for with dbuf_commit().
+ */
+struct dbuf_block *
+dbuf_tail(struct dbuf_queue *queue, size_t len)
+{
+  struct dbuf_block *block;
+
+  if (queue->count)
+  {
+    block = dbuf_nth(queue, queue->count - 1);
+
+    if (block->refs == 1 && block->capacity - block->size >= len)
+      return block;
+  }
+
+  block = dbuf_alloc_pool(DBUF_POOL_LARGE);
+  dbuf_append(queue, block);
+
+  return block;
+}
+
+void
+dbuf_commit(struct dbuf_queue *queue, size_t len)
+{
+  queue->total_size += len;
+}
+
 void
 dbuf_put_fmt(struct dbuf_block *dbuf, const char *pattern, ...)
 {
@@ -102,11 +255,11 @@ dbuf_put_args(struct dbuf_block *dbuf, const char *data, va_list args)
 {
   assert(dbuf->refs == 1);
 
-  dbuf->size += vsnprintf(dbuf->data + dbuf->size, sizeof(dbuf->data) - dbuf->size, data, args);
+  dbuf->size += vsnprintf(dbuf->data + dbuf->size, dbuf->capacity - dbuf->size, data, args);
 
   /* As per C99, (v)snprintf returns the length the resulting string would be */
-  if (dbuf->size > sizeof(dbuf->data))
-    dbuf->size = sizeof(dbuf->data);
+  if (dbuf->size > dbuf->capacity)
+    dbuf->size = dbuf->capacity;
 }
 
 void
@@ -114,15 +267,15 @@ dbuf_put(struct dbuf_queue *queue, const char *buf, size_t sz)
 {
   while (sz > 0)
   {
-    struct dbuf_block *block = dbuf_length(queue) ? queue->blocks.tail->data : NULL;
+    struct dbuf_block *block = dbuf_length(queue) ? dbuf_nth(queue, queue->count - 1) : NULL;
 
-    if (block == NULL || sizeof(block->data) - block->size == 0)
+    if (block == NULL || block->capacity - block->size == 0)
     {
-      block = dbuf_alloc();
-      dlinkAddTail(block, make_dlink_node(), &queue->blocks);
+      block = dbuf_alloc_pool(DBUF_POOL_LARGE);
+      dbuf_append(queue, block);
     }
 
-    size_t avail = sizeof(block->data) - block->size;
+    size_t avail = block->capacity - block->size;
     if (avail > sz)
       avail = sz;
 
@@ -135,3 +288,102 @@ dbuf_put(struct dbuf_queue *queue, const char *buf, size_t sz)
     buf += avail;
   }
 }
+
+/*
+ * dbuf_map
+ *      Describes up to 'count' blocks from the head of the queue in 'iov',
+ *      skipping the part of the first block that has already been consumed.
+ *      Returns the number of vectors filled in.
+ */
+int
+dbuf_map(const struct dbuf_queue *queue, struct iovec *iov, int count)
+{
+  size_t pos = queue->pos;
+  int n = 0;
+
+  for (; n < count && (unsigned int)n < queue->count; ++n)
+  {
+    struct dbuf_block *block = dbuf_nth(queue, n);
+
+    iov[n].iov_base = block->data + pos;
+    iov[n].iov_len = block->size - pos;
+
+    pos = 0;
+  }
+
+  return n;
+}
+
+/*
+ * dbuf_map_free
+ *      Describes room for appending to the queue in up to 'count' vectors:
+ *      the free space at the end of its last block, followed by spare
+ *      blocks that only become part of the queue once dbuf_commit_free()
+ *      finds data in them. Returns the number of vectors filled in.
+ */
+int
+dbuf_map_free(const struct dbuf_queue *queue, struct iovec *iov, int count)
+{
+  int n = 0;
+
+  if (queue->count)
+  {
+    struct dbuf_block *block = dbuf_nth(queue, queue->count - 1);
+
+    if (block->refs == 1 && block->size < block->capacity)
+    {
+      iov[n].iov_base = block->data + block->size;
+      iov[n].iov_len = block->capacity - block->size;
+      ++n;
+    }
+  }
+
+  for (unsigned int i = 0; n < count && i < DBUF_SPARE_MAX; ++i, ++n)
+  {
+    if (dbuf_spare[i] == NULL)
+      dbuf_spare[i] = dbuf_alloc_pool(DBUF_POOL_LARGE);
+
+    iov[n].iov_base = dbuf_spare[i]->data;
+    iov[n].iov_len = dbuf_spare[i]->capacity;
+  }
+
+  return n;
+}
+
+/*
+ * dbuf_commit_free
+ *      Accounts for 'len' bytes written to the room described by the
+ *      last dbuf_map_free() call, appending the spare blocks used.
+ */
+void
+dbuf_commit_free(struct dbuf_queue *queue, size_t len)
+{
+  queue->total_size += len;
+
+  if (queue->count)
+  {
+    struct dbuf_block *block = dbuf_nth(queue, queue->count - 1);
+
+    if (block->refs == 1 && block->size < block->capacity)
+    {
+      const size_t n = len < block->capacity - block->size ? len : block->capacity - block->size;
+
+      block->size += n;
+      len -= n;
+    }
+  }
+
+  for (unsigned int i = 0; len; ++i)
+  {
+    struct dbuf_block *block = dbuf_spare[i];
+
+    assert(i < DBUF_SPARE_MAX);
+    assert(block);
+
+    dbuf_spare[i] = NULL;
+    block->size = len < block->capacity ? len : block->capacity;
+    len -= block->size;
+
+    dbuf_append(queue, block);
+  }
+}
@@ -30,48 +30,122 @@
 #include "event.h"
 #include "rng_mt.h"
 #include "log.h"
+#include "memory.h"
 
 
 struct event_base ebase;
 struct event_base *event_base = &ebase;
 
-static dlink_list event_list;
+/* Binary min-heap of active events, ordered by their next execution */
+static struct event **event_heap;
+static unsigned int event_heap_size;  /* Allocated slots */
+static unsigned int event_heap_count;  /* Slots in use */
 
-const dlink_list *
-event_get_list(void)
+
+static void
+event_heap_set(unsigned int index, struct event *ev)
+{
+  event_heap[index] = ev;
+  ev->index = index;
+}
+
+static void
+event_heap_up(unsigned int index)
+{
+  struct event *ev = event_heap[index];
+
+  while (index)
+  {
+    unsigned int parent = (index - 1) / 2;
+
+    if (event_heap[parent]->next <= ev->next)
+      break;
+
+    event_heap_set(index, event_heap[parent]);
+    index = parent;
+  }
+
+  event_heap_set(index, ev);
+}
+
+static void
+event_heap_down(unsigned int index)
+{
+  struct event *ev = event_heap[index];
+
+  while (true)
+  {
+    unsigned int child = index * 2 + 1;
+
+    if (child >= event_heap_count)
+      break;
+
+    if (child + 1 < event_heap_count && event_heap[child + 1]->next < event_heap[child]->next)
+      ++child;
+
+    if (ev->next <= event_heap[child]->next)
+      break;
+
+    event_heap_set(index, event_heap[child]);
+    index = child;
+  }
+
+  event_heap_set(index, ev);
+}
+
+unsigned int
+event_count(void)
 {
-  return &event_list;
+  return event_heap_count;
+}
+
+const struct event *
+event_get(unsigned int index)
+{
+  assert(index < event_heap_count);
+  return event_heap[index];
+}
+
+/*
+ * event_next
+ *      Returns the number of milliseconds until the next event is due,
+ *      or UINTMAX_MAX if there are no events at all.
+ */
+uintmax_t
+event_next(void)
+{
+  if (event_heap_count == 0)
+    return UINTMAX_MAX;
+
+  if (event_heap[0]->next <= event_base->time.msec_monotonic)
+    return 0;
+
+  return event_heap[0]->next - event_base->time.msec_monotonic;
 }
 
 void
 event_add(struct event *ev, void *data)
 {
-  dlink_node *node;
-
   event_delete(ev);
 
   ev->data = data;
-  ev->next = event_base->time.sec_monotonic + ev->when;
+  ev->next = event_base->time.msec_monotonic + ev->when;
   ev->active = true;
 
-  DLINK_FOREACH(node, event_list.head)
+  if (event_heap_count == event_heap_size)
   {
-    struct event *e = node->data;
-
-    if (e->next > ev->next)
-    {
-      dlinkAddBefore(node, ev, &ev->node, &event_list);
-      return;
-    }
+    event_heap_size = event_heap_size ? event_heap_size * 2 : 16;
+    event_heap = xrealloc(event_heap, event_heap_size * sizeof(*event_heap));
   }
 
-  dlinkAddTail(ev, &ev->node, &event_list);
+  event_heap_set(event_heap_count, ev);
+  event_heap_up(event_heap_count++);
 }
 
 void
 event_addish(struct event *ev, void *data)
 {
-  if (ev->when >= 3)
+  if (ev->when >= 3000)
   {
     const uintmax_t two_third = (2 * ev->when) / 3;
 
@@ -87,25 +161,36 @@ event_delete(struct event *ev)
   if (ev->active == false)
     return;
 
-  dlinkDelete(&ev->node, &event_list);
+  const unsigned int index = ev->index;
+
+  assert(index < event_heap_count);
+  assert(event_heap[index] == ev);
+
   ev->active = false;
+
+  if (index == --event_heap_count)
+    return;
+
+  /* Move the last event into the hole and restore the heap property */
+  event_heap_set(index, event_heap[event_heap_count]);
+
+  if (index && event_heap[(index - 1) / 2]->next > event_heap[index]->next)
+    event_heap_up(index);
+  else
+    event_heap_down(index);
 }
 
 void
 event_run(void)
 {
-  static uintmax_t last = 0;
-
-  if (last == event_base->time.sec_monotonic)
-    return;
-  last = event_base->time.sec_monotonic;
+  unsigned int len = event_heap_count;
 
-  unsigned int len = dlink_list_length(&event_list);
-  while (len-- && dlink_list_length(&event_list))
+  /* Events re-added with a zero interval don't get to run twice */
+  while (len-- && event_heap_count)
   {
-    struct event *ev = event_list.head->data;
+    struct event *ev = event_heap[0];
 
-    if (ev->next > event_base->time.sec_monotonic)
+    if (ev->next > event_base->time.msec_monotonic)
       break;
 
     event_delete(ev);
@@ -134,7 +219,10 @@ event_time_set(void)
 #else
   if (clock_gettime(CLOCK_MONOTONIC, &newtime) == 0)
 #endif
+  {
     event_base->time.sec_monotonic = newtime.tv_sec;
+    event_base->time.msec_monotonic = (uintmax_t)newtime.tv_sec * 1000 + newtime.tv_nsec / 1000000;
+  }
   else
     exit(EXIT_FAILURE);
 }
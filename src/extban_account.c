@@ -40,7 +40,7 @@ extban_account_matches(struct Client *client, struct Channel *channel, struct Ba
   assert(client->account[0]);
 
   if (strcmp(client->account, "*"))
-    if (match(ban->host, client->account) == 0)
+    if (match_compiled(ban->host_mask, client->account) == 0)
       return EXTBAN_MATCH;
 
   return EXTBAN_NO_MATCH;
@@ -38,7 +38,7 @@ static enum extban_match
 extban_fingerprint_matches(struct Client *client, struct Channel *channel, struct Ban *ban)
 {
   if (!EmptyString(client->tls_certfp))
-    if (match(ban->host, client->tls_certfp) == 0)
+    if (match_compiled(ban->host_mask, client->tls_certfp) == 0)
       return EXTBAN_MATCH;
 
   return EXTBAN_NO_MATCH;
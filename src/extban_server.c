@@ -36,7 +36,7 @@
 static enum extban_match
 extban_server_matches(struct Client *client, struct Channel *channel, struct Ban *ban)
 {
-  if (match(ban->host, me.name) == 0)
+  if (match_compiled(ban->host_mask, me.name) == 0)
     return EXTBAN_MATCH;
 
   return EXTBAN_NO_MATCH;
@@ -115,6 +115,9 @@ fd_close(fde_t *F)
   if (F->flags.is_socket == true)
     comm_setselect(F, COMM_SELECT_WRITE | COMM_SELECT_READ, NULL, NULL, 0);
 
+  timer_del(&F->timeout);
+  timer_del(&F->flush);
+
   if (tls_isusing(&F->tls))
     tls_free(&F->tls);
 
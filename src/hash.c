@@ -39,367 +39,1022 @@
 #include "send.h"
 #include "memory.h"
 #include "dbuf.h"
+#include "misc.h"
+#include "intern.h"
+#include "whowas.h"
+#include "ban_index.h"
 
 
-/* The actual hash tables, They MUST be of the same HASHSIZE, variable
- * size tables could be supported but the rehash routine should also
- * rebuild the transformation maps, I kept the tables of equal size
- * so that I can use one hash function.
+/*
+ * The client, ID, channel, channel membership, string, whowas and ban host tables use open
+ * addressing with linear probing. Each slot holds the 32 bit hash of its
+ * entry next to the entry pointer, so a probe only dereferences entries
+ * whose hash matches. Entries are removed with backward-shift deletion, which keeps
+ * probe sequences short without tombstones, and lookups never write to
+ * the table.
+ *
+ * Tables double once they are 3/4 full and halve when they drop below
+ * 1/8. Resizing is incremental: the previous table is kept around and
+ * every insertion or deletion moves HASH_MIGRATE_STEP of its slots over,
+ * so no single operation has to rehash everything. Until it is drained,
+ * lookups fall back to the previous table, and entries deleted from it
+ * are replaced with tombstones so the remaining probe sequences stay
+ * intact.
+ *
+ * While an iteration is held open with hash_iterate_hold(), entries are
+ * not moved at all: migration pauses, deletions leave tombstones in the
+ * current table too, and shrinking waits. A table that has to grow in
+ * the meantime keeps its slot array as the previous table, so every
+ * entry stays at the same iteration position. The tombstones are swept
+ * out by rebuilding the table once the last hold is released, or once
+ * the table has been held for HASH_HOLD_MAX seconds in one go; all holds
+ * lapse at that point, so a client that stops reading its LIST can't
+ * keep a table from being cleaned up.
+ *
+ * Names are hashed with SipHash-1-3 over their case-folded form, keyed
+ * with 128 random bits chosen at startup, so chains can't be lengthened
+ * on purpose by picking colliding nicknames or channel names. Clients and
+ * channels carry the folded name and its hash (see client_set_name() and
+ * channel_make()), so only the name being looked up is ever folded and
+ * hashed, and candidates are compared with memcmp().
  */
-static struct Client *idTable[HASHSIZE];
-static struct Client *clientTable[HASHSIZE];
-static struct Channel *channelTable[HASHSIZE];
+enum
+{
+  HASH_SIZE_MIN = 1024,
+  HASH_MIGRATE_STEP = 64,
+  HASH_HELD_FILL = 15,  /* Sixteenths of a held table that may be in use */
+  HASH_HOLD_MAX = 30  /* Seconds a table may be held before entries move again */
+};
 
+#define HASH_TOMBSTONE ((void *)&hash_tombstone)
 
-/*
- * New hash function based on the Fowler/Noll/Vo (FNV) algorithm from
- * http://www.isthe.com/chongo/tech/comp/fnv/
+struct hash_slot
+{
+  uint32_t hash;  /**< The entry's hash, so it can be moved without rehashing */
+  void *data;  /**< The entry; NULL if the slot is free */
+};
+
+/*! \brief What a lookup in one of the name tables is looking for */
+struct hash_key
+{
+  const char *name;  /**< Case-folded for the client and channel tables */
+  size_t len;
+  uint32_t hash;
+};
+
+/*! \brief What a lookup in the membership table is looking for */
+struct hash_member_key
+{
+  const struct Client *client;
+  const struct Channel *channel;
+};
+
+struct hash_table
+{
+  struct hash_slot *slot;
+  unsigned int mask;  /**< Number of slots - 1 */
+  unsigned int count;
+  unsigned int tombstones;  /**< Tombstones in hash_table::slot; only while held */
+  unsigned int holds;  /**< Iterations that need entries to stay in place */
+  unsigned int hold_serial;  /**< Changes whenever the last hold ends or lapses */
+  uintmax_t hold_since;  /**< Monotonic time the first of the current holds was taken */
+  struct hash_slot *old;  /**< Table being migrated from; NULL if none */
+  unsigned int old_mask;
+  unsigned int old_count;
+  unsigned int old_pos;  /**< Next slot of the old table to migrate */
+  uint32_t (*hash)(const void *);
+  bool (*equal)(const void *, const void *);
+};
+
+static const char hash_tombstone;
+static uint64_t hash_secret[2];
+
+static uint32_t
+hash_client_name(const void *data)
+{
+  return ((const struct Client *)data)->name_hash;
+}
+
+static bool
+hash_client_name_equal(const void *data, const void *ptr)
+{
+  const struct hash_key *const key = ptr;
+  const struct Client *const client = data;
+  return client->name_len == key->len && memcmp(client->name_folded, key->name, key->len) == 0;
+}
+
+static uint32_t
+hash_client_id(const void *data)
+{
+  const struct Client *const client = data;
+  return hash_folded(client->id, strlen(client->id));
+}
+
+static bool
+hash_client_id_equal(const void *data, const void *ptr)
+{
+  const struct hash_key *const key = ptr;
+  return strcmp(((const struct Client *)data)->id, key->name) == 0;
+}
+
+static uint32_t
+hash_channel_name(const void *data)
+{
+  return ((const struct Channel *)data)->name_hash;
+}
+
+static bool
+hash_channel_name_equal(const void *data, const void *ptr)
+{
+  const struct hash_key *const key = ptr;
+  const struct Channel *const channel = data;
+  return channel->name_len == key->len && memcmp(channel->name_folded, key->name, key->len) == 0;
+}
+
+/*! \brief Hashes a client/channel pointer pair for the membership table
  *
- * Here, we use the FNV-1 method, which gives slightly better results
- * than FNV-1a.   -Michael
+ * Pointers can't be chosen by users, so a plain multiplicative mix is
+ * good enough here and a lot cheaper than the keyed string hash.
+ */
+static inline uint32_t
+hash_member_pair(const struct Client *client, const struct Channel *channel)
+{
+  uint64_t h = (uint64_t)(uintptr_t)client ^ ((uint64_t)(uintptr_t)channel << 29 | (uint64_t)(uintptr_t)channel >> 35);
+
+  h ^= hash_secret[0];
+  h ^= h >> 33;
+  h *= UINT64_C(0xff51afd7ed558ccd);
+  h ^= h >> 33;
+  h *= UINT64_C(0xc4ceb9fe1a85ec53);
+  h ^= h >> 33;
+
+  return h;
+}
+
+static uint32_t
+hash_member(const void *data)
+{
+  const struct ChannelMember *const member = data;
+  return hash_member_pair(member->client, member->channel);
+}
+
+static bool
+hash_member_equal(const void *data, const void *ptr)
+{
+  const struct ChannelMember *const member = data;
+  const struct hash_member_key *const key = ptr;
+
+  return member->client == key->client && member->channel == key->channel;
+}
+
+static uint32_t
+hash_intern(const void *data)
+{
+  return ((const struct InternString *)data)->hash;
+}
+
+static bool
+hash_intern_equal(const void *data, const void *ptr)
+{
+  const struct hash_key *const key = ptr;
+  const struct InternString *const str = data;
+  return str->len == key->len && memcmp(str->data, key->name, key->len) == 0;
+}
+
+static uint32_t
+hash_whowas(const void *data)
+{
+  return ((const struct Whowas *)data)->hash;
+}
+
+static bool
+hash_whowas_equal(const void *data, const void *ptr)
+{
+  const struct hash_key *const key = ptr;
+  return irccmp(((const struct Whowas *)data)->name, key->name) == 0;
+}
+
+/*! \brief What a lookup in the ban host table is looking for */
+struct hash_ban_key
+{
+  const struct BanList *owner;
+  const char *suffix;  /**< In lower case */
+  size_t len;
+};
+
+static uint32_t
+hash_ban(const void *data)
+{
+  return ((const struct BanHost *)data)->hash;
+}
+
+static bool
+hash_ban_equal(const void *data, const void *ptr)
+{
+  const struct BanHost *const host = data;
+  const struct hash_ban_key *const key = ptr;
+
+  return host->owner == key->owner && host->len == key->len && memcmp(host->suffix, key->suffix, key->len) == 0;
+}
+
+static struct hash_table idTable = { .hash = hash_client_id, .equal = hash_client_id_equal };
+static struct hash_table clientTable = { .hash = hash_client_name, .equal = hash_client_name_equal };
+static struct hash_table channelTable = { .hash = hash_channel_name, .equal = hash_channel_name_equal };
+static struct hash_table memberTable = { .hash = hash_member, .equal = hash_member_equal };
+static struct hash_table stringTable = { .hash = hash_intern, .equal = hash_intern_equal };
+static struct hash_table whowasTable = { .hash = hash_whowas, .equal = hash_whowas_equal };
+static struct hash_table banTable = { .hash = hash_ban, .equal = hash_ban_equal };
+
+static struct hash_table *const hash_tables[] =
+{
+  [HASH_TYPE_ID] = &idTable,
+  [HASH_TYPE_CLIENT] = &clientTable,
+  [HASH_TYPE_CHANNEL] = &channelTable,
+  [HASH_TYPE_MEMBER] = &memberTable,
+  [HASH_TYPE_STRING] = &stringTable,
+  [HASH_TYPE_WHOWAS] = &whowasTable,
+  [HASH_TYPE_BAN] = &banTable
+};
+
+
+#define ROTL64(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND \
+  do { \
+    v0 += v1; v1 = ROTL64(v1, 13); v1 ^= v0; v0 = ROTL64(v0, 32); \
+    v2 += v3; v3 = ROTL64(v3, 16); v3 ^= v2; \
+    v0 += v3; v3 = ROTL64(v3, 21); v3 ^= v0; \
+    v2 += v1; v1 = ROTL64(v1, 17); v1 ^= v2; v2 = ROTL64(v2, 32); \
+  } while (0)
+
+/*! \brief Computes the keyed hash of a string; SipHash-1-3
+ * \param name String to hash
+ * \param len  Its length
+ * \param fold If true, the string is hashed as if it had been passed
+ *             through irc_fold() first
+ * \return 32 bit hash value
+ */
+static inline uint32_t
+hash_bytes(const char *name, size_t len, bool fold)
+{
+  const unsigned char *p = (const unsigned char *)name;
+  uint64_t v0 = UINT64_C(0x736f6d6570736575) ^ hash_secret[0];
+  uint64_t v1 = UINT64_C(0x646f72616e646f6d) ^ hash_secret[1];
+  uint64_t v2 = UINT64_C(0x6c7967656e657261) ^ hash_secret[0];
+  uint64_t v3 = UINT64_C(0x7465646279746573) ^ hash_secret[1];
+  uint64_t m = 0;
+
+  for (size_t i = 0; i < len; ++i)
+  {
+    m |= (uint64_t)(fold ? ToLower(p[i]) : p[i]) << (8 * (i & 7));
+
+    if ((i & 7) == 7)
+    {
+      v3 ^= m;
+      SIPROUND;
+      v0 ^= m;
+      m = 0;
+    }
+  }
+
+  m |= (uint64_t)len << 56;
+  v3 ^= m;
+  SIPROUND;
+  v0 ^= m;
+
+  v2 ^= 0xff;
+  SIPROUND;
+  SIPROUND;
+  SIPROUND;
+
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/*! \brief Hashes a name that has already been case-folded with irc_fold() */
+uint32_t
+hash_folded(const char *name, size_t len)
+{
+  return hash_bytes(name, len, false);
+}
+
+/*! \brief Hashes a name the way hash_folded() hashes its folded form */
+uint32_t
+hash_string(const char *name)
+{
+  return hash_bytes(name, strlen(name), true);
+}
+
+/*
+ * Kept for the fixed size tables elsewhere (monitor, whowas); returns an
+ * index below HASHSIZE.
  */
 unsigned int
 strhash(const char *name)
 {
-  static unsigned int hashf_xor_key = 0;
-  const unsigned char *p = (const unsigned char *)name;
-  unsigned int hval = FNV1_32_INIT;
+  return hash_string(name) & (HASHSIZE - 1);
+}
+
+/*! \brief Hashes a ban list and host suffix pair for the ban host table
+ * \param owner  Ban list
+ * \param suffix Host suffix, in lower case
+ * \param len    Its length
+ * \return 32 bit hash value
+ */
+uint32_t
+hash_ban_host(const struct BanList *owner, const char *suffix, size_t len)
+{
+  uint64_t h = (uint64_t)(uintptr_t)owner ^ hash_secret[1];
 
-  if (EmptyString(p))
-    return 0;
+  h ^= h >> 33;
+  h *= UINT64_C(0xff51afd7ed558ccd);
+  h ^= h >> 33;
+
+  return hash_bytes(suffix, len, false) ^ (uint32_t)h;
+}
+
+/*! \brief Fills in a lookup key for the client or channel table
+ * \param key    Key to fill in
+ * \param buf    Buffer receiving the folded name
+ * \param size   Size of buf; longer names can't be in the table
+ * \param name   Name to look for
+ * \return false if the name is too long to be found
+ */
+static bool
+hash_key_fold(struct hash_key *key, char *buf, size_t size, const char *name)
+{
+  key->name = buf;
+  key->len = irc_fold(buf, name, size);
+
+  if (key->len >= size)
+    return false;
+
+  key->hash = hash_folded(buf, key->len);
+  return true;
+}
+
+/*! \brief Stores an entry in the first free slot of its probe sequence
+ * \param slot Slot array
+ * \param mask Number of slots - 1
+ * \param hash Lower 32 bits of the entry's hash
+ * \param data The entry
+ * \return true if the slot used held a tombstone
+ */
+static bool
+hash_slot_insert(struct hash_slot *slot, unsigned int mask, uint32_t hash, void *data)
+{
+  unsigned int i = hash & mask;
+
+  while (slot[i].data && slot[i].data != HASH_TOMBSTONE)
+    i = (i + 1) & mask;
+
+  const bool tombstone = slot[i].data != NULL;
+
+  slot[i].hash = hash;
+  slot[i].data = data;
+  return tombstone;
+}
+
+/*! \brief Removes the entry in slot i and shifts back the entries following it
+ *         whose probe sequences ran across it
+ */
+static void
+hash_slot_remove(struct hash_slot *slot, unsigned int mask, unsigned int i)
+{
+  unsigned int j = i;
+
+  while (true)
+  {
+    slot[i].data = NULL;
 
-  if (hashf_xor_key == 0)
     do
-      hashf_xor_key = genrand_int32() % 256;  /* better than nothing --adx */
-    while (hashf_xor_key == 0);
+    {
+      j = (j + 1) & mask;
+
+      if (slot[j].data == NULL)
+        return;
+    }
+    while (((j - (slot[j].hash & mask)) & mask) < ((j - i) & mask));
+
+    slot[i] = slot[j];
+    i = j;
+  }
+}
+
+/*! \brief Moves up to HASH_MIGRATE_STEP slots worth of entries out of the old table
+ * \param table Table that is being resized
+ * \param all   If true, drain the old table completely
+ */
+static void
+hash_table_migrate(struct hash_table *table, bool all)
+{
+  if (table->old == NULL || (table->holds && all == false))
+    return;
+
+  unsigned int step = all ? table->old_mask + 1 : HASH_MIGRATE_STEP;
+
+  for (; step && table->old_pos <= table->old_mask; --step, ++table->old_pos)
+  {
+    struct hash_slot *const old = &table->old[table->old_pos];
+
+    if (old->data && old->data != HASH_TOMBSTONE)
+    {
+      if (hash_slot_insert(table->slot, table->mask, old->hash, old->data))
+        --table->tombstones;
+      old->data = HASH_TOMBSTONE;
+      --table->old_count;
+      ++table->count;
+    }
+  }
+
+  if (table->old_pos > table->old_mask)
+  {
+    assert(table->old_count == 0);
+
+    xfree(table->old);
+    table->old = NULL;
+  }
+}
+
+/*! \brief Starts moving a table over to a new slot array of the given size */
+static void
+hash_table_resize(struct hash_table *table, unsigned int size)
+{
+  /* The previous resize has to be complete before another one can start */
+  hash_table_migrate(table, true);
+
+  table->old = table->slot;
+  table->old_mask = table->mask;
+  table->old_count = table->count;
+  table->old_pos = 0;
+
+  table->slot = xcalloc(sizeof(*table->slot) * size);
+  table->mask = size - 1;
+  table->count = 0;
+  table->tombstones = 0;
+
+  hash_table_migrate(table, false);
+}
+
+/*! \brief Ends all holds on a table, and gets rid of the tombstones they left */
+static void
+hash_table_unhold(struct hash_table *table)
+{
+  table->holds = 0;
+
+  if (++table->hold_serial == 0)
+    table->hold_serial = 1;
+
+  /* hash_slot_remove() can't deal with tombstones; move over to a clean slot array */
+  if (table->tombstones)
+    hash_table_resize(table, table->mask + 1);
+}
+
+/*! \brief Lets the holds on a table lapse once they have lasted too long */
+static void
+hash_table_check_hold(struct hash_table *table)
+{
+  if (table->holds && event_base->time.sec_monotonic - table->hold_since >= HASH_HOLD_MAX)
+    hash_table_unhold(table);
+}
+
+static void
+hash_table_insert(struct hash_table *table, void *data)
+{
+  const uint32_t hash = table->hash(data);
+
+  hash_table_check_hold(table);
+
+  if ((table->count + table->tombstones + table->old_count + 1) > (table->mask + 1) / 4 * 3)
+  {
+    /*
+     * A held table can only grow without moving anything if it isn't
+     * already being migrated from a previous slot array. Otherwise it
+     * fills up further, and only once it is about to run out of room are
+     * entries moved after all; an iteration over it at that time may
+     * then miss entries or return them twice.
+     */
+    if (table->holds == 0 || table->old == NULL ||
+        (table->count + table->tombstones + 1) > (table->mask + 1) / 16 * HASH_HELD_FILL)
+      hash_table_resize(table, (table->mask + 1) * 2);
+  }
+
+  if (hash_slot_insert(table->slot, table->mask, hash, data))
+    --table->tombstones;
+  ++table->count;
+
+  hash_table_migrate(table, false);
+}
 
-  for (; *p; ++p)
+static void
+hash_table_delete(struct hash_table *table, void *data)
+{
+  const uint32_t hash = table->hash(data);
+
+  hash_table_check_hold(table);
+
+  for (unsigned int i = hash & table->mask; table->slot[i].data; i = (i + 1) & table->mask)
   {
-    hval += (hval << 1) + (hval << 4) +
-            (hval << 7) + (hval << 8) + (hval << 24);
-    hval ^= (ToLower(*p) ^ hashf_xor_key);
+    if (table->slot[i].data == data)
+    {
+      if (table->holds)
+      {
+        table->slot[i].data = HASH_TOMBSTONE;
+        ++table->tombstones;
+      }
+      else
+        hash_slot_remove(table->slot, table->mask, i);
+
+      --table->count;
+      break;
+    }
   }
 
-  return (hval >> FNV1_32_BITS) ^ (hval & ((1 << FNV1_32_BITS) - 1));
+  if (table->old)
+  {
+    for (unsigned int i = hash & table->old_mask; table->old[i].data; i = (i + 1) & table->old_mask)
+    {
+      if (table->old[i].data == data)
+      {
+        table->old[i].data = HASH_TOMBSTONE;
+        --table->old_count;
+        break;
+      }
+    }
+  }
+
+  if (table->holds == 0 && table->mask + 1 > HASH_SIZE_MIN &&
+      (table->count + table->old_count) < (table->mask + 1) / 8)
+    hash_table_resize(table, (table->mask + 1) / 2);
+  else
+    hash_table_migrate(table, false);
+}
+
+/*! \brief Looks up an entry
+ * \param table  Table to search
+ * \param key    What to look for; handed to the table's equal() function
+ * \param hash   Hash of the key
+ * \param accept Optional filter; entries it rejects are skipped
+ * \return The first matching entry, or NULL
+ */
+static void *
+hash_table_find(const struct hash_table *table, const void *key, uint32_t hash, bool (*accept)(const void *))
+{
+  for (unsigned int i = hash & table->mask; table->slot[i].data; i = (i + 1) & table->mask)
+    if (table->slot[i].hash == hash &&
+        table->slot[i].data != HASH_TOMBSTONE &&
+        table->equal(table->slot[i].data, key) &&
+        (accept == NULL || accept(table->slot[i].data)))
+      return table->slot[i].data;
+
+  if (table->old)
+    for (unsigned int i = hash & table->old_mask; table->old[i].data; i = (i + 1) & table->old_mask)
+      if (table->old[i].data != HASH_TOMBSTONE &&
+          table->old[i].hash == hash &&
+          table->equal(table->old[i].data, key) &&
+          (accept == NULL || accept(table->old[i].data)))
+        return table->old[i].data;
+
+  return NULL;
 }
 
 /************************** Externally visible functions ********************/
 
-/* Optimization note: in these functions I supposed that the CSE optimization
- * (Common Subexpression Elimination) does its work decently, this means that
- * I avoided introducing new variables to do the work myself and I did let
- * the optimizer play with more free registers, actual tests proved this
- * solution to be faster than doing things like tmp2=tmp->hnext... and then
- * use tmp2 myself which would have given less freedom to the optimizer.
+/* hash_init()
+ *
+ * inputs       - NONE
+ * output       - NONE
+ * side effects - picks the hash key and allocates the tables
  */
+void
+hash_init(void)
+{
+  /*
+   * The Mersenne Twister is seeded from the time and pid, which is easy
+   * enough to guess; prefer the system's entropy pool when there is one.
+   */
+  FILE *file = fopen("/dev/urandom", "rb");
+  if (file == NULL || fread(hash_secret, sizeof(hash_secret), 1, file) != 1)
+  {
+    hash_secret[0] = (uint64_t)genrand_int32() << 32 | genrand_int32();
+    hash_secret[1] = (uint64_t)genrand_int32() << 32 | genrand_int32();
+  }
+
+  if (file)
+    fclose(file);
+
+  for (unsigned int i = 0; i < sizeof(hash_tables) / sizeof(hash_tables[0]); ++i)
+  {
+    hash_tables[i]->slot = xcalloc(sizeof(struct hash_slot) * HASH_SIZE_MIN);
+    hash_tables[i]->mask = HASH_SIZE_MIN - 1;
+    hash_tables[i]->hold_serial = 1;
+  }
+}
 
 /* hash_add_client()
  *
  * inputs       - pointer to client
  * output       - NONE
- * side effects - Adds a client's name in the proper hash linked
- *                list, can't fail, client must have a non-null
+ * side effects - Adds a client's name to the client hash table,
+ *                can't fail, client must have a non-null
  *                name or expect a coredump, the name is infact
  *                taken from client->name
  */
 void
 hash_add_client(struct Client *client)
 {
-  const unsigned int hashv = strhash(client->name);
-
-  client->hnext = clientTable[hashv];
-  clientTable[hashv] = client;
+  hash_table_insert(&clientTable, client);
 }
 
 /* hash_add_channel()
  *
  * inputs       - pointer to channel
  * output       - NONE
- * side effects - Adds a channel's name in the proper hash linked
- *                list, can't fail. channel must have a non-null name
+ * side effects - Adds a channel's name to the channel hash table,
+ *                can't fail. channel must have a non-null name
  *                or expect a coredump. As before the name is taken
- *                from channel->name, we do hash its entire lenght
- *                since this proved to be statistically faster
+ *                from channel->name
  */
 void
 hash_add_channel(struct Channel *channel)
 {
-  const unsigned int hashv = strhash(channel->name);
-
-  channel->hnextch = channelTable[hashv];
-  channelTable[hashv] = channel;
+  hash_table_insert(&channelTable, channel);
 }
 
 void
 hash_add_id(struct Client *client)
 {
-  const unsigned int hashv = strhash(client->id);
-
-  client->idhnext = idTable[hashv];
-  idTable[hashv] = client;
+  hash_table_insert(&idTable, client);
 }
 
 /* hash_del_id()
  *
  * inputs       - pointer to client
  * output       - NONE
- * side effects - Removes an ID from the hash linked list
+ * side effects - Removes an ID from the ID hash table
  */
 void
 hash_del_id(struct Client *client)
 {
-  const unsigned int hashv = strhash(client->id);
-  struct Client *tmp = idTable[hashv];
-
-  if (tmp)
-  {
-    if (tmp == client)
-    {
-      idTable[hashv] = client->idhnext;
-      client->idhnext = client;
-    }
-    else
-    {
-      while (tmp->idhnext != client)
-        if ((tmp = tmp->idhnext) == NULL)
-          return;
-
-      tmp->idhnext = tmp->idhnext->idhnext;
-      client->idhnext = client;
-    }
-  }
+  hash_table_delete(&idTable, client);
 }
 
 /* hash_del_client()
  *
  * inputs       - pointer to client
  * output       - NONE
- * side effects - Removes a Client's name from the hash linked list
+ * side effects - Removes a Client's name from the client hash table
  */
 void
 hash_del_client(struct Client *client)
 {
-  const unsigned int hashv = strhash(client->name);
-  struct Client *tmp = clientTable[hashv];
-
-  if (tmp)
-  {
-    if (tmp == client)
-    {
-      clientTable[hashv] = client->hnext;
-      client->hnext = client;
-    }
-    else
-    {
-      while (tmp->hnext != client)
-        if ((tmp = tmp->hnext) == NULL)
-          return;
-
-      tmp->hnext = tmp->hnext->hnext;
-      client->hnext = client;
-    }
-  }
+  hash_table_delete(&clientTable, client);
 }
 
 /* hash_del_channel()
  *
  * inputs       - pointer to client
  * output       - NONE
- * side effects - Removes the channel's name from the corresponding
- *                hash linked list
+ * side effects - Removes the channel's name from the channel hash table
  */
 void
 hash_del_channel(struct Channel *channel)
 {
-  const unsigned int hashv = strhash(channel->name);
-  struct Channel *tmp = channelTable[hashv];
+  hash_table_delete(&channelTable, channel);
+}
 
-  if (tmp)
-  {
-    if (tmp == channel)
-    {
-      channelTable[hashv] = channel->hnextch;
-      channel->hnextch = channel;
-    }
-    else
-    {
-      while (tmp->hnextch != channel)
-        if ((tmp = tmp->hnextch) == NULL)
-          return;
+/* hash_add_member()
+ *
+ * inputs       - pointer to channel membership
+ * output       - NONE
+ * side effects - Adds the membership to the client/channel pair index
+ */
+void
+hash_add_member(struct ChannelMember *member)
+{
+  hash_table_insert(&memberTable, member);
+}
 
-      tmp->hnextch = tmp->hnextch->hnextch;
-      channel->hnextch = channel;
-    }
-  }
+/* hash_del_member()
+ *
+ * inputs       - pointer to channel membership
+ * output       - NONE
+ * side effects - Removes the membership from the client/channel pair index
+ */
+void
+hash_del_member(struct ChannelMember *member)
+{
+  hash_table_delete(&memberTable, member);
+}
+
+/* hash_find_member()
+ *
+ * inputs       - pointer to client
+ *              - pointer to channel
+ * output       - the client's membership in the channel, or NULL
+ * side effects - NONE
+ */
+struct ChannelMember *
+hash_find_member(const struct Client *client, const struct Channel *channel)
+{
+  const struct hash_member_key key = { .client = client, .channel = channel };
+  return hash_table_find(&memberTable, &key, hash_member_pair(client, channel), NULL);
+}
+
+/* hash_add_string()
+ *
+ * inputs       - pointer to interned string
+ * output       - NONE
+ * side effects - Adds the string to the intern pool's table
+ */
+void
+hash_add_string(struct InternString *str)
+{
+  hash_table_insert(&stringTable, str);
+}
+
+/* hash_del_string()
+ *
+ * inputs       - pointer to interned string
+ * output       - NONE
+ * side effects - Removes the string from the intern pool's table
+ */
+void
+hash_del_string(struct InternString *str)
+{
+  hash_table_delete(&stringTable, str);
+}
+
+/* hash_find_string()
+ *
+ * inputs       - string, its length and hash_folded() of it
+ * output       - the interned copy of the string, or NULL
+ * side effects - NONE
+ */
+struct InternString *
+hash_find_string(const char *s, size_t len, uint32_t hash)
+{
+  const struct hash_key key = { .name = s, .len = len, .hash = hash };
+  return hash_table_find(&stringTable, &key, hash, NULL);
+}
+
+/* hash_add_whowas()
+ *
+ * inputs       - pointer to whowas entry
+ * output       - NONE
+ * side effects - Makes the entry the one found for its name
+ */
+void
+hash_add_whowas(struct Whowas *whowas)
+{
+  hash_table_insert(&whowasTable, whowas);
+}
+
+/* hash_del_whowas()
+ *
+ * inputs       - pointer to whowas entry
+ * output       - NONE
+ * side effects - Removes the entry from the whowas index
+ */
+void
+hash_del_whowas(struct Whowas *whowas)
+{
+  hash_table_delete(&whowasTable, whowas);
+}
+
+/* hash_find_whowas()
+ *
+ * inputs       - nick name
+ * output       - the newest whowas entry for the name, or NULL
+ * side effects - NONE
+ */
+struct Whowas *
+hash_find_whowas(const char *name)
+{
+  struct hash_key key;
+  char buf[HOSTLEN + 1];
+
+  if (hash_key_fold(&key, buf, sizeof(buf), name) == false)
+    return NULL;
+
+  return hash_table_find(&whowasTable, &key, key.hash, NULL);
+}
+
+/* hash_add_ban_host()
+ *
+ * inputs       - pointer to ban host bucket
+ * output       - NONE
+ * side effects - Adds the bucket to the ban host table
+ */
+void
+hash_add_ban_host(struct BanHost *host)
+{
+  hash_table_insert(&banTable, host);
+}
+
+/* hash_del_ban_host()
+ *
+ * inputs       - pointer to ban host bucket
+ * output       - NONE
+ * side effects - Removes the bucket from the ban host table
+ */
+void
+hash_del_ban_host(struct BanHost *host)
+{
+  hash_table_delete(&banTable, host);
+}
+
+/* hash_find_ban_host()
+ *
+ * inputs       - ban list
+ *              - host suffix in lower case, and its length
+ * output       - the list's bucket for that suffix, or NULL
+ * side effects - NONE
+ */
+struct BanHost *
+hash_find_ban_host(const struct BanList *owner, const char *suffix, size_t len)
+{
+  const struct hash_ban_key key = { .owner = owner, .suffix = suffix, .len = len };
+  return hash_table_find(&banTable, &key, hash_ban_host(owner, suffix, len), NULL);
 }
 
 /* hash_find_client()
  *
  * inputs       - pointer to name
  * output       - NONE
- * side effects - New semantics: finds a client whose name is 'name'
- *                if can't find one returns NULL. If it finds one moves
- *                it to the top of the list and returns it.
+ * side effects - finds a client whose name is 'name'
+ *                if can't find one returns NULL.
  */
 struct Client *
 hash_find_client(const char *name)
 {
-  const unsigned int hashv = strhash(name);
-  struct Client *client;
-
-  if ((client = clientTable[hashv]))
-  {
-    if (irccmp(name, client->name))
-    {
-      struct Client *prev;
+  char buf[HOSTLEN + 1];
+  struct hash_key key;
 
-      while (prev = client, (client = client->hnext))
-      {
-        if (irccmp(name, client->name) == 0)
-        {
-          prev->hnext = client->hnext;
-          client->hnext = clientTable[hashv];
-          clientTable[hashv] = client;
-          break;
-        }
-      }
-    }
-  }
+  if (hash_key_fold(&key, buf, sizeof(buf), name) == false)
+    return NULL;
 
-  return client;
+  return hash_table_find(&clientTable, &key, key.hash, NULL);
 }
 
 struct Client *
 hash_find_id(const char *name)
 {
-  const unsigned int hashv = strhash(name);
-  struct Client *client;
+  const size_t len = strlen(name);
+  const struct hash_key key = { .name = name, .len = len, .hash = hash_folded(name, len) };
 
-  if ((client = idTable[hashv]))
-  {
-    if (strcmp(name, client->id))
-    {
-      struct Client *prev;
-
-      while (prev = client, (client = client->idhnext))
-      {
-        if (strcmp(name, client->id) == 0)
-        {
-          prev->idhnext = client->idhnext;
-          client->idhnext = idTable[hashv];
-          idTable[hashv] = client;
-          break;
-        }
-      }
-    }
-  }
+  return hash_table_find(&idTable, &key, key.hash, NULL);
+}
 
-  return client;
+static bool
+hash_accept_server(const void *data)
+{
+  const struct Client *const client = data;
+  return IsServer(client) || IsMe(client);
 }
 
 struct Client *
 hash_find_server(const char *name)
 {
-  const unsigned int hashv = strhash(name);
-  struct Client *client;
-
   if (IsDigit(*name) && strlen(name) == IRC_MAXSID)
     return hash_find_id(name);
 
-  if ((client = clientTable[hashv]))
-  {
-    if ((!IsServer(client) && !IsMe(client)) ||
-        irccmp(name, client->name))
-    {
-      struct Client *prev;
+  char buf[HOSTLEN + 1];
+  struct hash_key key;
 
-      while (prev = client, (client = client->hnext))
-      {
-        if ((IsServer(client) || IsMe(client)) &&
-            irccmp(name, client->name) == 0)
-        {
-          prev->hnext = client->hnext;
-          client->hnext = clientTable[hashv];
-          clientTable[hashv] = client;
-          break;
-        }
-      }
-    }
-  }
+  if (hash_key_fold(&key, buf, sizeof(buf), name) == false)
+    return NULL;
 
-  return client;
+  return hash_table_find(&clientTable, &key, key.hash, hash_accept_server);
 }
 
 /* hash_find_channel()
  *
  * inputs       - pointer to name
  * output       - NONE
- * side effects - New semantics: finds a channel whose name is 'name',
- *                if can't find one returns NULL, if can find it moves
- *                it to the top of the list and returns it.
+ * side effects - finds a channel whose name is 'name',
+ *                if can't find one returns NULL.
  */
 struct Channel *
 hash_find_channel(const char *name)
 {
-  const unsigned int hashv = strhash(name);
-  struct Channel *channel;
+  char buf[CHANNELLEN + 1];
+  struct hash_key key;
 
-  if ((channel = channelTable[hashv]))
-  {
-    if (irccmp(name, channel->name))
-    {
-      struct Channel *prev;
+  if (hash_key_fold(&key, buf, sizeof(buf), name) == false)
+    return NULL;
 
-      while (prev = channel, (channel = channel->hnextch))
-      {
-        if (irccmp(name, channel->name) == 0)
-        {
-          prev->hnextch = channel->hnextch;
-          channel->hnextch = channelTable[hashv];
-          channelTable[hashv] = channel;
-          break;
-        }
-      }
-    }
-  }
+  return hash_table_find(&channelTable, &key, key.hash, NULL);
+}
 
-  return channel;
+/* hash_iterate()
+ *
+ * inputs       - table type
+ *              - pointer to the iteration position, start at 0
+ * output       - the entry at or after *pos, or NULL once all
+ *                entries have been visited
+ * side effects - *pos is advanced past the returned entry
+ *
+ * Adding or removing entries moves others around, so an iteration that
+ * is suspended and resumed later has to be bracketed with
+ * hash_iterate_hold() and hash_iterate_release(); only then does every
+ * entry present throughout get visited exactly once, provided the hold
+ * doesn't lapse first. Entries added in the meantime may or may not be
+ * visited.
+ */
+void *
+hash_iterate(int type, unsigned int *pos)
+{
+  const struct hash_table *const table = hash_tables[type];
+  const unsigned int old_size = table->old ? table->old_mask + 1 : 0;
+
+  /* The table being migrated from is visited first */
+  for (; *pos < old_size; ++*pos)
+    if (table->old[*pos].data && table->old[*pos].data != HASH_TOMBSTONE)
+      return table->old[(*pos)++].data;
+
+  for (; *pos - old_size <= table->mask; ++*pos)
+    if (table->slot[*pos - old_size].data && table->slot[*pos - old_size].data != HASH_TOMBSTONE)
+      return table->slot[(*pos)++ - old_size].data;
+
+  return NULL;
 }
 
-/* hash_get_bucket(int type, unsigned int hashv)
+/* hash_iterate_hold()
  *
- * inputs       - hash value (must be between 0 and HASHSIZE - 1)
+ * inputs       - table type
+ * output       - token to pass to hash_iterate_release()
+ * side effects - entries of the table stay where they are, and keep
+ *                their hash_iterate() positions, until released, but
+ *                no longer than HASH_HOLD_MAX seconds after the table
+ *                was last free of holds
+ */
+unsigned int
+hash_iterate_hold(int type)
+{
+  struct hash_table *const table = hash_tables[type];
+
+  hash_table_check_hold(table);
+
+  if (table->holds++ == 0)
+    table->hold_since = event_base->time.sec_monotonic;
+
+  return table->hold_serial;
+}
+
+/* hash_iterate_release()
+ *
+ * inputs       - table type
+ *              - token returned by hash_iterate_hold()
+ * output       - NONE
+ * side effects - undoes one hash_iterate_hold() unless it has lapsed
+ *                already; once none are left, the table is rebuilt if
+ *                it holds any tombstones
+ */
+void
+hash_iterate_release(int type, unsigned int token)
+{
+  struct hash_table *const table = hash_tables[type];
+
+  if (token != table->hold_serial)
+    return;  /* Lapsed; see hash_table_check_hold() */
+
+  assert(table->holds);
+
+  if (--table->holds == 0)
+    hash_table_unhold(table);
+}
+
+/* hash_get_stats()
+ *
+ * inputs       - table type
+ *              - pointer to struct hash_stats to fill in
  * output       - NONE
- * returns      - pointer to first channel in channelTable[hashv]
- *                if that exists;
- *                NULL if there is no channel in that place;
- *                NULL if hashv is an invalid number.
  * side effects - NONE
  */
-void *
-hash_get_bucket(int type, unsigned int hashv)
+void
+hash_get_stats(int type, struct hash_stats *stats)
 {
-  assert(hashv < HASHSIZE);
+  const struct hash_table *const table = hash_tables[type];
 
-  if (hashv >= HASHSIZE)
-    return NULL;
+  memset(stats, 0, sizeof(*stats));
+  stats->count = table->count + table->old_count;
+  stats->size = table->mask + 1;
+  stats->memory = stats->size * sizeof(struct hash_slot);
+  stats->migrating = table->old_count;
+
+  if (table->old)
+    stats->memory += (table->old_mask + 1) * sizeof(struct hash_slot);
 
-  switch (type)
+  for (unsigned int i = 0; i <= table->mask; ++i)
   {
-    case HASH_TYPE_ID:
-      return idTable[hashv];
-      break;
-    case HASH_TYPE_CHANNEL:
-      return channelTable[hashv];
-      break;
-    case HASH_TYPE_CLIENT:
-      return clientTable[hashv];
-      break;
-    default:
-      assert(0);
-  }
+    if (table->slot[i].data && table->slot[i].data != HASH_TOMBSTONE)
+    {
+      const unsigned int probes = ((i - (table->slot[i].hash & table->mask)) & table->mask) + 1;
 
-  return NULL;
+      stats->probes_total += probes;
+      stats->probes_max = IRCD_MAX(stats->probes_max, probes);
+    }
+  }
 }
 
 /*
@@ -455,6 +1110,9 @@ free_list_task(struct Client *client)
     free_dlink_node(node);
   }
 
+  if (lt->hash_hold)
+    hash_iterate_release(HASH_TYPE_CHANNEL, lt->hash_hold);
+
   xfree(lt);
   client->connection->list_task = NULL;
 }
@@ -538,10 +1196,11 @@ list_one_channel(struct Client *client, struct Channel *channel)
  * output	- 0/1
  * side effects	- safely list all channels to client
  *
- * Walk the channel buckets, ensure all pointers in a bucket are
- * traversed before blocking on a sendq. This means, no locking is needed.
- *
- * - Dianora
+ * Walk the channel table, checking the sendq before each channel and
+ * remembering where we stopped. Once we have to stop, the table is held
+ * still until the list task is done, so the position remains valid in
+ * between. A LIST that is still paused when the hold lapses carries on
+ * from the same position, and may then miss or repeat channels.
  */
 void
 safe_list_channels(struct Client *client, bool only_unmasked_channels)
@@ -551,16 +1210,24 @@ safe_list_channels(struct Client *client, bool only_unmasked_channels)
 
   if (only_unmasked_channels == false)
   {
-    for (unsigned int i = lt->hash_index; i < HASHSIZE; ++i)
+    unsigned int pos = lt->hash_index;
+
+    while (true)
     {
       if (exceeding_sendq(client) == true)
       {
-        lt->hash_index = i;
+        /* Keep the table from moving entries around until we are back */
+        if (lt->hash_hold == 0)
+          lt->hash_hold = hash_iterate_hold(HASH_TYPE_CHANNEL);
+
+        lt->hash_index = pos;
         return;  /* Still more to do */
       }
 
-      for (channel = channelTable[i]; channel; channel = channel->hnextch)
-        list_one_channel(client, channel);
+      if ((channel = hash_iterate(HASH_TYPE_CHANNEL, &pos)) == NULL)
+        break;
+
+      list_one_channel(client, channel);
     }
   }
   else
@@ -435,6 +435,28 @@ get_mask_hash(const char *text)
   return hash_text(text);
 }
 
+/* Username and hostname checks of find_conf_by_address(); with do_match
+ * set the masks compiled by add_conf_by_address() are used.
+ */
+static bool
+arec_match_user(const struct AddressRec *arec, const char *username, int do_match)
+{
+  if (username == NULL)
+    return true;
+
+  if (do_match)
+    return match_compiled(arec->conf->user_mask, username) == 0;
+  return irccmp(arec->username, username) == 0;
+}
+
+static bool
+arec_match_host(const struct AddressRec *arec, const char *name, int do_match)
+{
+  if (do_match)
+    return match_compiled(arec->conf->host_mask, name) == 0;
+  return irccmp(arec->Mask.hostname, name) == 0;
+}
+
 /* struct MaskItem *find_conf_by_address(const char *, struct irc_ssaddr *,
  *                                         int type, int fam, const char *username)
  * Input: The hostname, the address, the type of mask to find, the address
@@ -453,7 +475,6 @@ find_conf_by_address(const char *name, const struct irc_ssaddr *addr, unsigned i
   dlink_node *node;
   struct MaskItem *hprec = NULL;
   struct AddressRec *arec = NULL;
-  int (*cmpfunc)(const char *, const char *) = do_match ? match : irccmp;
 
   if (addr)
   {
@@ -471,7 +492,7 @@ find_conf_by_address(const char *name, const struct irc_ssaddr *addr, unsigned i
               arec->masktype == HM_IPV6 &&
               match_ipv6(addr, &arec->Mask.ipa.addr,
                          arec->Mask.ipa.bits) &&
-              (!username || !cmpfunc(arec->username, username)) &&
+              arec_match_user(arec, username, do_match) &&
               (IsNeedPassword(arec->conf) || arec->conf->passwd == NULL ||
                match_conf_password(password, arec->conf)))
           {
@@ -494,7 +515,7 @@ find_conf_by_address(const char *name, const struct irc_ssaddr *addr, unsigned i
               arec->masktype == HM_IPV4 &&
               match_ipv4(addr, &arec->Mask.ipa.addr,
                          arec->Mask.ipa.bits) &&
-              (!username || !cmpfunc(arec->username, username)) &&
+              arec_match_user(arec, username, do_match) &&
               (IsNeedPassword(arec->conf) || arec->conf->passwd == NULL ||
                match_conf_password(password, arec->conf)))
           {
@@ -518,8 +539,8 @@ find_conf_by_address(const char *name, const struct irc_ssaddr *addr, unsigned i
           if ((arec->type == type) &&
             arec->precedence > hprecv &&
             (arec->masktype == HM_HOST) &&
-            !cmpfunc(arec->Mask.hostname, name) &&
-            (!username || !cmpfunc(arec->username, username)) &&
+            arec_match_host(arec, name, do_match) &&
+            arec_match_user(arec, username, do_match) &&
             (IsNeedPassword(arec->conf) || arec->conf->passwd == NULL ||
              match_conf_password(password, arec->conf)))
         {
@@ -540,8 +561,8 @@ find_conf_by_address(const char *name, const struct irc_ssaddr *addr, unsigned i
       if (arec->type == type &&
           arec->precedence > hprecv &&
           arec->masktype == HM_HOST &&
-          !cmpfunc(arec->Mask.hostname, name) &&
-          (!username || !cmpfunc(arec->username, username)) &&
+          arec_match_host(arec, name, do_match) &&
+          arec_match_user(arec, username, do_match) &&
           (IsNeedPassword(arec->conf) || arec->conf->passwd == NULL ||
            match_conf_password(password, arec->conf)))
       {
@@ -624,6 +645,9 @@ add_conf_by_address(const unsigned int type, struct MaskItem *conf)
   arec->Mask.ipa.bits = bits;
   arec->username = username;
   arec->conf = conf;
+
+  if (username && conf->user_mask == NULL)
+    conf->user_mask = match_compile(username);
   arec->precedence = prec_value--;
   arec->type = type;
 
@@ -640,6 +664,9 @@ add_conf_by_address(const unsigned int type, struct MaskItem *conf)
       dlinkAdd(arec, &arec->node, &atable[hash_ipv6(&arec->Mask.ipa.addr, bits)]);
       break;
     default: /* HM_HOST */
+      if (conf->host_mask == NULL)
+        conf->host_mask = match_compile(hostname);
+
       arec->Mask.hostname = hostname;
       dlinkAdd(arec, &arec->node, &atable[get_mask_hash(hostname)]);
       break;
@@ -0,0 +1,156 @@
+/*
+ *  ircd-hybrid: an advanced, lightweight Internet Relay Chat Daemon (ircd)
+ *
+ *  Copyright (c) 1997-2022 ircd-hybrid development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ *  USA
+ */
+
+
+/*! \file intern.c
+ * \brief A pool of shared, reference counted strings.
+ * \version $Id$
+ *
+ * Hosts, usernames, accounts and server names repeat a lot across a
+ * network: thousands of remote clients share the same cloak suffix or
+ * ident, and every whowas entry of a client copies its strings. Such
+ * strings are stored once here and shared by everything holding them.
+ *
+ * An interned string stays the same pointer for as long as anyone holds
+ * a reference, so two equal strings compare equal as pointers, and the
+ * result of matching one against a mask can be reused for every other
+ * holder of that pointer. Interning is case-sensitive.
+ *
+ * The empty string is never counted; intern_string() returns the literal
+ * "" for it, and intern_ref()/intern_release() ignore it.
+ */
+
+#include "stdinc.h"
+#include "list.h"
+#include "memory.h"
+#include "hash.h"
+#include "intern.h"
+
+static uintmax_t intern_refs_total;  /* References held on all strings */
+
+
+static inline struct InternString *
+intern_from_data(const char *data)
+{
+  return (struct InternString *)(data - offsetof(struct InternString, data));
+}
+
+/*! \brief Returns a shared copy of a string
+ * \param s   String to intern
+ * \param len Maximum number of characters of s to use
+ * \return Pointer to the shared string; must be released with intern_release()
+ */
+const char *
+intern_string(const char *s, size_t len)
+{
+  len = strnlen(s, len);
+  if (len == 0)
+    return "";
+
+  const uint32_t hash = hash_folded(s, len);
+  struct InternString *str = hash_find_string(s, len, hash);
+
+  if (str == NULL)
+  {
+    str = mem_string_alloc(sizeof(*str) + len + 1);
+    str->hash = hash;
+    str->len = len;
+    memcpy(str->data, s, len);
+    hash_add_string(str);
+  }
+
+  ++str->refcount;
+  ++intern_refs_total;
+  return str->data;
+}
+
+/*! \brief Takes another reference on an interned string
+ * \param s Pointer previously returned by intern_string()
+ * \return s
+ */
+const char *
+intern_ref(const char *s)
+{
+  if (*s)
+  {
+    ++intern_from_data(s)->refcount;
+    ++intern_refs_total;
+  }
+
+  return s;
+}
+
+/*! \brief Drops a reference on an interned string, freeing it once unused
+ * \param s Pointer previously returned by intern_string() or intern_ref()
+ */
+void
+intern_release(const char *s)
+{
+  if (*s == '\0')
+    return;
+
+  struct InternString *str = intern_from_data(s);
+
+  assert(str->refcount);
+  --intern_refs_total;
+
+  if (--str->refcount == 0)
+  {
+    hash_del_string(str);
+    mem_strfree(str);
+  }
+}
+
+/*! \brief Replaces an interned string held in a field
+ * \param field Field holding the string; must point to an interned string or ""
+ * \param s     New value
+ * \param len   Maximum number of characters of s to use
+ */
+void
+intern_set(const char **field, const char *s, size_t len)
+{
+  const char *old = *field;
+
+  *field = intern_string(s, len);
+  intern_release(old);
+}
+
+/*! \brief Counts the interned strings and the memory used by them
+ * \param count  Number of distinct strings
+ * \param memory Bytes used by them, not counting string cache rounding
+ * \param refs   Number of references held on them
+ */
+void
+intern_count_memory(unsigned int *const count, size_t *const memory, uintmax_t *const refs)
+{
+  unsigned int pos = 0;
+  const struct InternString *str;
+
+  *count = 0;
+  *memory = 0;
+  *refs = intern_refs_total;
+
+  while ((str = hash_iterate(HASH_TYPE_STRING, &pos)))
+  {
+    ++*count;
+    *memory += sizeof(*str) + str->len + 1;
+  }
+}
@@ -32,6 +32,8 @@
 #include "channel_mode.h"
 #include "client.h"
 #include "event.h"
+#include "timer.h"
+#include "scan.h"
 #include "fdlist.h"
 #include "hash.h"
 #include "id.h"
@@ -64,7 +66,8 @@ struct Counter Count;
 struct ServerState_t server_state;
 struct ServerStatistics ServerStats;
 struct Connection meConnection;  /* That's also part of me */
-struct Client me = { .connection = &meConnection };  /* That's me */
+struct Client me = { .connection = &meConnection, .username = "", .host = "", .account = "",
+                     .away = "", .info = "", .realhost = "", .sockhost = "" };  /* That's me */
 
 char **myargv;
 const char *logFileName = LPATH;
@@ -103,28 +106,21 @@ static struct event event_cleanup_tklines =
 {
   .name = "cleanup_tklines",
   .handler = cleanup_tklines,
-  .when = CLEANUP_TKLINES_TIME
+  .when = CLEANUP_TKLINES_TIME * 1000
 };
 
 static struct event event_try_connections =
 {
   .name = "try_connections",
   .handler = try_connections,
-  .when = 15
-};
-
-static struct event event_comm_checktimeouts =
-{
-  .name = "comm_checktimeouts",
-  .handler = comm_checktimeouts,
-  .when = 1
+  .when = 15000
 };
 
 static struct event event_save_all_databases =
 {
   .name = "save_all_databases",
   .handler = save_all_databases,
-  .when = DATABASE_UPDATE_TIMEOUT
+  .when = DATABASE_UPDATE_TIMEOUT * 1000
 };
 
 struct event event_write_links_file =
@@ -149,7 +145,14 @@ io_loop(void)
     /* Run pending events */
     event_run();
 
+    /* Write out everything that has been queued up before going to sleep */
+    send_queued_all();
+
     comm_select();
+
+    /* Run expired socket timeouts and flush functions */
+    timer_run();
+
     exit_aborted_clients();
     free_exited_clients();
 
@@ -398,6 +401,9 @@ main(int argc, char *argv[])
 
   /* We need this to initialise the fd array before anything else */
   fdlist_init();
+  timer_init();
+  hash_init();
+  scan_init();
   log_set_file(LOG_TYPE_IRCD, 0, logFileName);
 
   comm_select_init();  /* This needs to be setup early ! -- adrian */
@@ -408,7 +414,6 @@ main(int argc, char *argv[])
 
   isupport_init();
   ipcache_init();
-  client_init();
   class_init();
   resolver_init();      /* Needs to be setup before the io loop */
   modules_init();
@@ -427,7 +432,7 @@ main(int argc, char *argv[])
     exit(EXIT_FAILURE);
   }
 
-  strlcpy(me.name, ConfigServerInfo.name, sizeof(me.name));
+  client_set_name(&me, ConfigServerInfo.name);
 
   /* serverinfo {} description must exist.  If not, error out.*/
   if (EmptyString(ConfigServerInfo.description))
@@ -436,7 +441,7 @@ main(int argc, char *argv[])
     exit(EXIT_FAILURE);
   }
 
-  strlcpy(me.info, ConfigServerInfo.description, sizeof(me.info));
+  client_string_set(&me.info, ConfigServerInfo.description, REALLEN);
 
   if (EmptyString(ConfigServerInfo.sid))
   {
@@ -478,14 +483,11 @@ main(int argc, char *argv[])
   /* No, 'cause after a restart it would cause all sorts of nick collides */
   event_addish(&event_try_connections, NULL);
 
-  /* Setup the timeout check. I'll shift it later :)  -- adrian */
-  event_add(&event_comm_checktimeouts, NULL);
-
   event_addish(&event_save_all_databases, NULL);
 
   if (ConfigServerHide.flatten_links_delay && event_write_links_file.active == false)
   {
-    event_write_links_file.when = ConfigServerHide.flatten_links_delay;
+    event_write_links_file.when = ConfigServerHide.flatten_links_delay * 1000;
     event_add(&event_write_links_file, NULL);
   }
 
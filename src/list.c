@@ -29,6 +29,9 @@
 #include "memory.h"
 
 
+static struct mem_cache dlink_node_cache = { .name = "dlink_node", .size = sizeof(dlink_node) };
+
+
 /* make_dlink_node()
  *
  * inputs       - NONE
@@ -38,9 +41,7 @@
 dlink_node *
 make_dlink_node(void)
 {
-  dlink_node *node = xcalloc(sizeof(*node));
-
-  return node;
+  return mem_cache_alloc(&dlink_node_cache);
 }
 
 /* free_dlink_node()
@@ -52,7 +53,7 @@ make_dlink_node(void)
 void
 free_dlink_node(dlink_node *node)
 {
-  xfree(node);
+  mem_cache_free(&dlink_node_cache, node);
 }
 
 /*
@@ -140,7 +140,7 @@ listener_accept_connection(fde_t *F, void *data)
         send(fd, ALLINUSE_WARNING, sizeof(ALLINUSE_WARNING) - 1, 0);
 
       close(fd);
-      break;    /* jump out and re-register a new io request */
+      continue;  /* Keep on clearing the queue; edge-triggered backends won't tell us again */
     }
 
     /*
@@ -229,6 +229,28 @@ ircncmp(const char *s1, const char *s2, size_t n)
   return 1;
 }
 
+/*
+ * irc_fold - copy a string in its case-folded form
+ *
+ * Two strings compare equal with irccmp() exactly when their folded
+ * forms are identical, so the result can be checked with memcmp().
+ * The destination is always NUL terminated. Returns the length of src;
+ * if that is >= size, the copy has been truncated.
+ */
+size_t
+irc_fold(char *dst, const char *src, size_t size)
+{
+  const unsigned char *s = (const unsigned char *)src;
+
+  assert(size > 0);
+
+  for (; *s && --size; ++s)
+    *dst++ = ToLower(*s);
+  *dst = '\0';
+
+  return (const char *)s - src + strlen((const char *)s);
+}
+
 const unsigned char ToLowerTab[] =
 {
   0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0x8, 0x9, 0xa,
@@ -0,0 +1,291 @@
+/*
+ *  ircd-hybrid: an advanced, lightweight Internet Relay Chat Daemon (ircd)
+ *
+ *  Copyright (c) 1997-2022 ircd-hybrid development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ *  USA
+ */
+
+/*! \file match_mask.c
+ * \brief Wildcard masks compiled for repeated matching.
+ * \version $Id$
+ *
+ * Bans, K-lines, X-lines and RESVs are matched over and over against
+ * changing subjects, while the masks themselves rarely change. Rather
+ * than having match() walk such a mask from the start every time, the
+ * mask is split once at its '*'s into the fixed part before the first
+ * star, the fixed part after the last one, and the segments in between,
+ * all case-folded in advance. A subject then is rejected right away if
+ * it is shorter than the fixed parts together, the prefix and suffix are
+ * compared in place, and the middle segments are searched for in order,
+ * leftmost first, which for '*' and '?' masks finds a match whenever
+ * backtracking would.
+ *
+ * Masks containing a backslash escape are left to match(), since
+ * escaped characters compare case-sensitively there, and so are
+ * subjects too long to be folded on the stack.
+ */
+
+#include "stdinc.h"
+#include "irc_string.h"
+#include "memory.h"
+
+enum
+{
+  MATCH_MASK_ESCAPED = 1 << 0,  /**< Matched with match() */
+  MATCH_MASK_STAR    = 1 << 1,  /**< Contains at least one '*' */
+  MATCH_MASK_ONE     = 1 << 2,  /**< Contains at least one '?' */
+  MATCH_MASK_ANY     = 1 << 3   /**< Only '*'s; matches everything */
+};
+
+enum { MATCH_FOLD_MAX = 512 };  /* Longer subjects are left to match() */
+
+struct match_segment
+{
+  unsigned int offset;  /**< Offset into match_mask::text */
+  unsigned int len;
+  bool one;  /**< Contains a '?' */
+};
+
+struct match_mask
+{
+  unsigned int flags;
+  unsigned int min_len;  /**< Shortest subject that can match */
+  unsigned int prefix_len;  /**< Length of the fixed part before the first '*' */
+  unsigned int suffix_len;  /**< Length of the fixed part after the last '*' */
+  unsigned int segments;  /**< Number of segments between the first and last '*' */
+  const char *mask;  /**< The mask as given, for match() */
+  const char *text;  /**< Folded prefix, segments and suffix, without the '*'s */
+  struct match_segment segment[];
+};
+
+
+/*! \brief Compiles a wildcard mask
+ * \param mask Mask as accepted by match()
+ * \return Compiled mask; to be released with match_mask_free()
+ */
+struct match_mask *
+match_compile(const char *mask)
+{
+  const size_t len = strlen(mask);
+  unsigned int stars = 0;
+
+  for (const char *p = mask; *p; ++p)
+    if (*p == '*')
+      ++stars;
+
+  const size_t segments = stars > 1 ? stars - 1 : 0;
+  const size_t size = sizeof(struct match_mask) + segments * sizeof(struct match_segment);
+  struct match_mask *mm = xcalloc(size + (len + 1) * 2);
+  char *text = (char *)mm + size;
+
+  mm->text = text;
+  mm->mask = memcpy(text + len + 1, mask, len + 1);
+
+  if (strchr(mask, '\\'))
+  {
+    mm->flags = MATCH_MASK_ESCAPED;
+    return mm;
+  }
+
+  if (stars)
+    mm->flags |= MATCH_MASK_STAR;
+
+  /*
+   * Split at the '*'s: the first run of characters is the prefix, the
+   * last one the suffix (if there is a star at all), everything else a
+   * middle segment. Empty middle segments are dropped.
+   */
+  const char *p = mask;
+  unsigned int run = 0;
+  char *t = text;
+
+  while (true)
+  {
+    const char *const start = p;
+    bool one = false;
+
+    for (; *p && *p != '*'; ++p)
+    {
+      if (*p == '?')
+        one = true;
+      *t++ = ToLower(*p);
+    }
+
+    const unsigned int seg_len = p - start;
+
+    if (one)
+      mm->flags |= MATCH_MASK_ONE;
+
+    if (run == 0)
+      mm->prefix_len = seg_len;
+    else if (*p == '\0')
+      mm->suffix_len = seg_len;
+    else if (seg_len)
+    {
+      struct match_segment *const seg = &mm->segment[mm->segments++];
+
+      seg->offset = (t - text) - seg_len;
+      seg->len = seg_len;
+      seg->one = one;
+    }
+
+    mm->min_len += seg_len;
+
+    if (*p == '\0')
+      break;
+
+    ++p;  /* Skip the '*' */
+    ++run;
+  }
+
+  if (stars && mm->min_len == 0)
+    mm->flags |= MATCH_MASK_ANY;
+
+  return mm;
+}
+
+/*! \brief Releases a mask returned by match_compile()
+ * \param mm Compiled mask; may be NULL
+ */
+void
+match_mask_free(struct match_mask *mm)
+{
+  xfree(mm);
+}
+
+/*! \brief Compares a fixed part of the mask with the same number of
+ *         characters of the subject, which need not be folded.
+ */
+static inline bool
+match_fixed(const char *text, const char *s, size_t len, bool one)
+{
+  if (one)
+  {
+    for (size_t i = 0; i < len; ++i)
+      if (text[i] != '?' && text[i] != ToLower(s[i]))
+        return false;
+  }
+  else
+  {
+    for (size_t i = 0; i < len; ++i)
+      if (text[i] != ToLower(s[i]))
+        return false;
+  }
+
+  return true;
+}
+
+/*! \brief Finds the leftmost occurrence of a segment in a folded subject
+ * \return Pointer past the occurrence, or NULL
+ */
+static const char *
+match_find(const char *text, const struct match_segment *seg, const char *s, const char *end)
+{
+  const char *const needle = text + seg->offset;
+
+  if (seg->one == false)
+  {
+    /* A memmem() over the folded subject, skipping ahead with memchr() */
+    const char *const last = end - seg->len;
+
+    while (s <= last)
+    {
+      if ((s = memchr(s, needle[0], last - s + 1)) == NULL)
+        return NULL;
+      if (memcmp(s + 1, needle + 1, seg->len - 1) == 0)
+        return s + seg->len;
+      ++s;
+    }
+
+    return NULL;
+  }
+
+  for (; s + seg->len <= end; ++s)
+  {
+    size_t i = 0;
+
+    while (i < seg->len && (needle[i] == '?' || needle[i] == s[i]))
+      ++i;
+
+    if (i == seg->len)
+      return s + seg->len;
+  }
+
+  return NULL;
+}
+
+/*! \brief Checks a string against a compiled mask
+ * \param mm   Mask compiled with match_compile()
+ * \param name String to check against the mask
+ * \return Zero if the mask matches, non-zero if not; just like match()
+ */
+int
+match_compiled(const struct match_mask *mm, const char *name)
+{
+  if (mm->flags & MATCH_MASK_ANY)
+    return 0;
+
+  if (mm->flags & MATCH_MASK_ESCAPED)
+    return match(mm->mask, name);
+
+  const bool one = (mm->flags & MATCH_MASK_ONE) != 0;
+
+  /*
+   * The prefix is compared before the length of the subject is known, so
+   * most mismatches are found without looking at the rest of it; the
+   * terminating NUL never compares equal to a character of the mask.
+   */
+  for (unsigned int i = 0; i < mm->prefix_len; ++i)
+    if (name[i] == '\0' || (mm->text[i] != ToLower(name[i]) && mm->text[i] != '?'))
+      return 1;
+
+  /* No '*': the subject has to end right after the prefix */
+  if ((mm->flags & MATCH_MASK_STAR) == 0)
+    return name[mm->prefix_len] != '\0';
+
+  if (mm->suffix_len == 0 && mm->segments == 0)
+    return 0;
+
+  const size_t len = mm->prefix_len + strlen(name + mm->prefix_len);
+
+  if (len < mm->min_len)
+    return 1;
+
+  if (match_fixed(mm->text + mm->min_len - mm->suffix_len, name + len - mm->suffix_len, mm->suffix_len, one) == false)
+    return 1;
+
+  if (mm->segments == 0)
+    return 0;
+
+  /* The middle segments are searched for in a folded copy of the subject */
+  char buf[MATCH_FOLD_MAX];
+  const size_t middle = len - mm->prefix_len - mm->suffix_len;
+
+  if (middle > sizeof(buf))
+    return match(mm->mask, name);
+
+  for (size_t i = 0; i < middle; ++i)
+    buf[i] = ToLower(name[mm->prefix_len + i]);
+
+  const char *s = buf, *const end = buf + middle;
+
+  for (unsigned int i = 0; i < mm->segments; ++i)
+    if ((s = match_find(mm->text, &mm->segment[i], s, end)) == NULL)
+      return 1;
+
+  return 0;
+}
@@ -0,0 +1,359 @@
+/*
+ *  ircd-hybrid: an advanced, lightweight Internet Relay Chat Daemon (ircd)
+ *
+ *  Copyright (c) 1997-2022 ircd-hybrid development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ *  USA
+ */
+
+/*! \file match_set.c
+ * \brief Sets of wildcard masks searched all at once.
+ * \version $Id$
+ *
+ * X-lines and RESVs are lists of masks of which the first one matching a
+ * real name, nick or channel name is wanted. Whatever a mask looks like,
+ * each run of plain characters between its wildcards has to show up in
+ * any string it matches. The longest such run of every mask is kept in a
+ * trie with Aho-Corasick failure links, so a single pass over the subject
+ * finds all masks whose fragment occurs in it; only those are then tried
+ * with match_compiled(). Masks without a fragment, or with backslash
+ * escapes, are always tried.
+ *
+ * Adding or removing a mask extends or prunes the trie in place. The
+ * failure links are rebuilt from it before the next lookup after a
+ * change, which takes time in the size of the trie, not the number of
+ * lookups, and leaves lookups themselves independent of the number of
+ * masks beyond those whose fragment does occur.
+ */
+
+#include "stdinc.h"
+#include "list.h"
+#include "irc_string.h"
+#include "memory.h"
+#include "match_set.h"
+
+struct match_set_node
+{
+  unsigned int child;  /**< First child, or 0 */
+  unsigned int sibling;  /**< Next child of the same parent, or 0; next free node if unused */
+  unsigned int parent;
+  unsigned int fail;  /**< Node of the longest proper suffix of this one's string */
+  unsigned int output;  /**< Nearest node along the failure links with entries, or 0 */
+  unsigned char c;
+  dlink_list entries;  /**< Entries whose fragment ends here */
+};
+
+
+/*! \brief Picks the fragment of a mask to index it under
+ * \param mask Mask as accepted by match()
+ * \param len  Set to the length of the fragment
+ * \return Pointer to the fragment within the mask, or NULL if there is none
+ */
+static const char *
+match_set_fragment(const char *mask, size_t *len)
+{
+  const char *best = NULL;
+
+  *len = 0;
+
+  /* Escaped characters compare case-sensitively; leave those to match() */
+  if (strchr(mask, '\\'))
+    return NULL;
+
+  for (const char *p = mask; *p; )
+  {
+    if (*p == '*' || *p == '?')
+    {
+      ++p;
+      continue;
+    }
+
+    const char *const start = p;
+
+    while (*p && *p != '*' && *p != '?')
+      ++p;
+
+    if ((size_t)(p - start) > *len)
+    {
+      best = start;
+      *len = p - start;
+    }
+  }
+
+  return best;
+}
+
+static unsigned int
+match_set_child(const struct match_set *set, unsigned int parent, unsigned char c)
+{
+  if (parent == 0)
+    return set->root[c];
+
+  for (unsigned int child = set->node[parent].child; child; child = set->node[child].sibling)
+    if (set->node[child].c == c)
+      return child;
+
+  return 0;
+}
+
+static unsigned int
+match_set_node_new(struct match_set *set, unsigned int parent, unsigned char c)
+{
+  unsigned int index = set->free;
+
+  if (index)
+    set->free = set->node[index].sibling;
+  else
+  {
+    if (set->nodes == set->size)
+    {
+      set->size = set->size ? set->size * 2 : 64;
+      set->node = xrealloc(set->node, set->size * sizeof(*set->node));
+    }
+
+    index = set->nodes++;
+  }
+
+  struct match_set_node *const node = &set->node[index];
+  memset(node, 0, sizeof(*node));
+  node->parent = parent;
+  node->c = c;
+
+  if (parent == 0)
+    set->root[c] = index;
+  else
+  {
+    node->sibling = set->node[parent].child;
+    set->node[parent].child = index;
+  }
+
+  return index;
+}
+
+/*! \brief Returns nodes to the free list, from a leaf that has become
+ *         unused up to the first ancestor still needed
+ */
+static void
+match_set_prune(struct match_set *set, unsigned int index)
+{
+  while (index && set->node[index].child == 0 && set->node[index].entries.head == NULL)
+  {
+    struct match_set_node *const node = &set->node[index];
+    const unsigned int parent = node->parent;
+
+    if (parent == 0)
+      set->root[node->c] = 0;
+    else
+    {
+      unsigned int *link = &set->node[parent].child;
+
+      while (*link != index)
+        link = &set->node[*link].sibling;
+      *link = node->sibling;
+    }
+
+    node->sibling = set->free;
+    set->free = index;
+    index = parent;
+  }
+}
+
+/*! \brief Recomputes failure and output links, breadth first */
+static void
+match_set_build(struct match_set *set)
+{
+  unsigned int *const queue = xcalloc(set->nodes * sizeof(*queue));
+  unsigned int head = 0, tail = 0;
+
+  for (unsigned int c = 0; c < 256; ++c)
+  {
+    const unsigned int child = set->root[c];
+
+    if (child)
+    {
+      set->node[child].fail = 0;
+      set->node[child].output = 0;
+      queue[tail++] = child;
+    }
+  }
+
+  while (head < tail)
+  {
+    const unsigned int index = queue[head++];
+
+    for (unsigned int child = set->node[index].child; child; child = set->node[child].sibling)
+    {
+      const unsigned char c = set->node[child].c;
+      unsigned int fail = set->node[index].fail, next;
+
+      while ((next = match_set_child(set, fail, c)) == 0 && fail)
+        fail = set->node[fail].fail;
+
+      set->node[child].fail = next;
+      set->node[child].output = set->node[next].entries.head ? next : set->node[next].output;
+      queue[tail++] = child;
+    }
+  }
+
+  xfree(queue);
+  set->dirty = false;
+}
+
+/*! \brief Adds a mask to a set
+ * \param set   Set to add to
+ * \param entry Entry to link; kept by the caller until match_set_del()
+ * \param mask  Mask as accepted by match()
+ * \param mm    The same mask compiled with match_compile()
+ * \param data  Item to be returned by match_set_find()
+ */
+void
+match_set_add(struct match_set *set, struct match_set_entry *entry, const char *mask,
+              const struct match_mask *mm, void *data)
+{
+  size_t len;
+  const char *const fragment = match_set_fragment(mask, &len);
+
+  entry->mask = mm;
+  entry->data = data;
+  entry->seq = ++set->seq;
+  entry->mark = 0;
+  entry->trie_node = 0;
+
+  if (fragment == NULL)
+  {
+    dlinkAdd(entry, &entry->node, &set->residual);
+    return;
+  }
+
+  if (set->nodes == 0)
+    match_set_node_new(set, 0, 0);  /* The root */
+
+  unsigned int index = 0;
+
+  for (size_t i = 0; i < len; ++i)
+  {
+    const unsigned char c = ToLower(fragment[i]);
+    unsigned int next = match_set_child(set, index, c);
+
+    if (next == 0)
+      next = match_set_node_new(set, index, c);
+    index = next;
+  }
+
+  dlinkAdd(entry, &entry->node, &set->node[index].entries);
+  entry->trie_node = index;
+  set->dirty = true;
+}
+
+/*! \brief Removes a mask added with match_set_add()
+ * \param set   Set the entry is in
+ * \param entry Entry to remove
+ */
+void
+match_set_del(struct match_set *set, struct match_set_entry *entry)
+{
+  if (entry->trie_node == 0)
+  {
+    dlinkDelete(&entry->node, &set->residual);
+    return;
+  }
+
+  dlinkDelete(&entry->node, &set->node[entry->trie_node].entries);
+
+  if (set->node[entry->trie_node].entries.head == NULL)
+  {
+    match_set_prune(set, entry->trie_node);
+    set->dirty = true;
+  }
+}
+
+/*! \brief Verifies an entry unless it has been already, or could not
+ *         replace the best match so far anyway
+ */
+static inline void
+match_set_try(struct match_set *set, struct match_set_entry *entry, const char *name,
+              struct match_set_entry **best)
+{
+  if (entry->mark == set->lookup)
+    return;
+
+  entry->mark = set->lookup;
+
+  if (*best && (*best)->seq > entry->seq)
+    return;
+
+  if (match_compiled(entry->mask, name) == 0)
+    *best = entry;
+}
+
+/*! \brief Finds the most recently added mask matching a string
+ * \param set  Set to search
+ * \param name String to check against the masks
+ * \return The data of the matching entry, or NULL if none matches
+ */
+void *
+match_set_find(struct match_set *set, const char *name)
+{
+  struct match_set_entry *best = NULL;
+  dlink_node *node;
+
+  ++set->lookup;
+
+  if (set->nodes)
+  {
+    if (set->dirty == true)
+      match_set_build(set);
+
+    unsigned int index = 0;
+
+    for (const char *p = name; *p; ++p)
+    {
+      const unsigned char c = ToLower(*p);
+      unsigned int next;
+
+      while ((next = match_set_child(set, index, c)) == 0 && index)
+        index = set->node[index].fail;
+      index = next;
+
+      for (unsigned int out = set->node[index].entries.head ? index : set->node[index].output; out;
+           out = set->node[out].output)
+        DLINK_FOREACH(node, set->node[out].entries.head)
+          match_set_try(set, node->data, name, &best);
+    }
+  }
+
+  DLINK_FOREACH(node, set->residual.head)
+    match_set_try(set, node->data, name, &best);
+
+  return best ? best->data : NULL;
+}
+
+/*! \brief Reports the memory taken up by a set's trie
+ * \param set   Set to report on
+ * \param count Set to the number of trie nodes in use
+ * \param bytes Set to the number of bytes allocated for them
+ */
+void
+match_set_count_memory(const struct match_set *set, unsigned int *const count, size_t *const bytes)
+{
+  unsigned int unused = 0;
+
+  for (unsigned int index = set->free; index; index = set->node[index].sibling)
+    ++unused;
+
+  *count = set->nodes - unused;
+  *bytes = set->size * sizeof(*set->node);
+}
@@ -26,8 +26,12 @@
 
 #include "stdinc.h"
 #include "irc_string.h"
+#include "list.h"
 #include "memory.h"
 #include "restart.h"
+#include "misc.h"
+
+#include <sys/mman.h>
 
 
 /*
@@ -90,6 +94,312 @@ xstrndup(const char *s, size_t len)
   return ret;
 }
 
+/*
+ * Slab allocator
+ *
+ * Objects of the types the ircd creates and destroys by the hundred
+ * thousand during net joins and splits are allocated from per-type caches.
+ * Each cache carves its objects out of SLAB_SIZE byte slabs obtained
+ * directly with mmap(), aligned to SLAB_SIZE so the slab an object belongs
+ * to can be found by masking its address. Slabs whose objects have all
+ * been freed are unmapped, which lets the process shrink again after a
+ * split instead of leaving a fragmented heap behind; a few of them are
+ * kept around to absorb churn until mem_cache_trim() is called.
+ *
+ * With assertions enabled, freed objects are filled with a poison
+ * pattern that is checked again when the object is handed out, so writes
+ * through dangling pointers and double frees are caught.
+ */
+enum
+{
+  SLAB_SIZE = 64 * 1024,
+  SLAB_ALIGN = 16,  /* Object alignment */
+  SLAB_EMPTY_MAX = 2,  /* Empty slabs a cache keeps before unmapping them */
+  SLAB_POISON = 0xdb
+};
+
+struct mem_slab
+{
+  dlink_node node;  /**< Link in one of the owning cache's slab lists */
+  struct mem_cache *cache;  /**< Cache the slab belongs to */
+  void *free_list;  /**< Free objects; the first word of each links to the next */
+  unsigned int used;  /**< Objects handed out */
+  unsigned int unused;  /**< Objects never handed out yet, at the end of the slab */
+};
+
+/* Objects start at the first suitably aligned address past the slab header */
+#define SLAB_FIRST(slab) ((char *)(slab) + (slab)->cache->offset)
+
+static dlink_list mem_cache_list;
+
+
+const dlink_list *
+mem_cache_get_list(void)
+{
+  return &mem_cache_list;
+}
+
+size_t
+mem_cache_slab_size(void)
+{
+  return SLAB_SIZE;
+}
+
+static void
+mem_cache_setup(struct mem_cache *cache)
+{
+  const size_t align = IRCD_MAX(cache->align, SLAB_ALIGN);
+
+  assert((align & (align - 1)) == 0);
+
+  cache->offset = (sizeof(struct mem_slab) + align - 1) & ~(align - 1);
+  cache->stride = (IRCD_MAX(cache->size, sizeof(void *)) + align - 1) & ~(align - 1);
+  cache->per_slab = (SLAB_SIZE - cache->offset) / cache->stride;
+
+  assert(cache->per_slab >= 8);
+  dlinkAddTail(cache, &cache->node, &mem_cache_list);
+}
+
+static struct mem_slab *
+mem_slab_map(struct mem_cache *cache)
+{
+  /* Map twice the size and trim, so the slab ends up aligned to its size */
+  char *map = mmap(NULL, SLAB_SIZE * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+  if (map == MAP_FAILED)
+    outofmemory();
+
+  char *base = (char *)(((uintptr_t)map + SLAB_SIZE - 1) & ~(uintptr_t)(SLAB_SIZE - 1));
+  if (base > map)
+    munmap(map, base - map);
+  munmap(base + SLAB_SIZE, map + SLAB_SIZE - base);
+
+  struct mem_slab *slab = (struct mem_slab *)base;
+  slab->cache = cache;
+  slab->unused = cache->per_slab;
+  return slab;
+}
+
+static void
+mem_slab_unmap(struct mem_slab *slab)
+{
+  munmap(slab, SLAB_SIZE);
+}
+
+#ifndef NDEBUG
+static void
+mem_poison(void *ptr, size_t size)
+{
+  /* The free list link lives in the first word and is left alone */
+  memset((char *)ptr + sizeof(void *), SLAB_POISON, size - sizeof(void *));
+}
+
+static bool
+mem_poisoned(const void *ptr, size_t size)
+{
+  for (const unsigned char *p = (const unsigned char *)ptr + sizeof(void *),
+                          *end = (const unsigned char *)ptr + size; p < end; ++p)
+    if (*p != SLAB_POISON)
+      return false;
+  return true;
+}
+#endif
+
+/*
+ * mem_cache_alloc - hand out a zeroed object from a cache
+ */
+void *
+mem_cache_alloc(struct mem_cache *cache)
+{
+  struct mem_slab *slab;
+  void *ptr;
+
+  if (cache->stride == 0)
+    mem_cache_setup(cache);
+
+  if (cache->partial.head)
+    slab = cache->partial.head->data;
+  else
+  {
+    if (cache->empty.head)
+    {
+      slab = cache->empty.head->data;
+      dlinkDelete(&slab->node, &cache->empty);
+    }
+    else
+      slab = mem_slab_map(cache);
+
+    dlinkAdd(slab, &slab->node, &cache->partial);
+  }
+
+  if (slab->free_list)
+  {
+    ptr = slab->free_list;
+    slab->free_list = *(void **)ptr;
+
+#ifndef NDEBUG
+    /* Somebody wrote to this object after it had been freed */
+    assert(mem_poisoned(ptr, cache->stride));
+#endif
+  }
+  else
+  {
+    assert(slab->unused);
+    ptr = SLAB_FIRST(slab) + (cache->per_slab - slab->unused--) * cache->stride;
+  }
+
+  if (++slab->used == cache->per_slab)
+  {
+    dlinkDelete(&slab->node, &cache->partial);
+    dlinkAdd(slab, &slab->node, &cache->full);
+  }
+
+  if (++cache->live > cache->peak)
+    cache->peak = cache->live;
+
+  memset(ptr, 0, cache->size);
+  return ptr;
+}
+
+/*
+ * mem_cache_free - return an object to the cache it was allocated from
+ */
+void
+mem_cache_free(struct mem_cache *cache, void *ptr)
+{
+  if (ptr == NULL)
+    return;
+
+  struct mem_slab *const slab = (struct mem_slab *)((uintptr_t)ptr & ~(uintptr_t)(SLAB_SIZE - 1));
+
+  assert(slab->cache == cache);
+  assert(((char *)ptr - SLAB_FIRST(slab)) % cache->stride == 0);
+  assert(slab->used);
+
+#ifndef NDEBUG
+  /*
+   * An object that is still poisoned in full was most likely freed
+   * already. A live object could in theory look like this, but none of
+   * the cached types ever does.
+   */
+  assert(mem_poisoned(ptr, cache->stride) == false);
+  mem_poison(ptr, cache->stride);
+#endif
+
+  *(void **)ptr = slab->free_list;
+  slab->free_list = ptr;
+  --cache->live;
+
+  if (slab->used-- == cache->per_slab)
+  {
+    dlinkDelete(&slab->node, &cache->full);
+    dlinkAdd(slab, &slab->node, &cache->partial);
+  }
+
+  if (slab->used == 0)
+  {
+    dlinkDelete(&slab->node, &cache->partial);
+
+    if (dlink_list_length(&cache->empty) < SLAB_EMPTY_MAX)
+    {
+      /* Hand out objects in address order again once the slab is reused */
+      slab->free_list = NULL;
+      slab->unused = cache->per_slab;
+      dlinkAdd(slab, &slab->node, &cache->empty);
+    }
+    else
+      mem_slab_unmap(slab);
+  }
+}
+
+/*
+ * mem_cache_trim - unmap the empty slabs every cache keeps in reserve.
+ *                  Called once a net split has freed its clients.
+ */
+void
+mem_cache_trim(void)
+{
+  dlink_node *node;
+
+  DLINK_FOREACH(node, mem_cache_list.head)
+  {
+    struct mem_cache *const cache = node->data;
+
+    while (cache->empty.head)
+    {
+      struct mem_slab *const slab = cache->empty.head->data;
+
+      dlinkDelete(&slab->node, &cache->empty);
+      mem_slab_unmap(slab);
+    }
+  }
+}
+
+/*
+ * Short strings that belong to long-lived objects are kept in string
+ * caches of MEM_STRING_STEP byte size classes, rather than in fixed size
+ * buffers sized for the longest value. This wastes less than a step per
+ * string and costs no allocator header.
+ */
+enum
+{
+  MEM_STRING_STEP = 16,
+  MEM_STRING_MAX = 256  /* Longest string that can be stored, including the NUL */
+};
+
+static struct mem_cache mem_string_cache[MEM_STRING_MAX / MEM_STRING_STEP] =
+{
+  { .name = "string16", .size = 16 }, { .name = "string32", .size = 32 },
+  { .name = "string48", .size = 48 }, { .name = "string64", .size = 64 },
+  { .name = "string80", .size = 80 }, { .name = "string96", .size = 96 },
+  { .name = "string112", .size = 112 }, { .name = "string128", .size = 128 },
+  { .name = "string144", .size = 144 }, { .name = "string160", .size = 160 },
+  { .name = "string176", .size = 176 }, { .name = "string192", .size = 192 },
+  { .name = "string208", .size = 208 }, { .name = "string224", .size = 224 },
+  { .name = "string240", .size = 240 }, { .name = "string256", .size = 256 }
+};
+
+/*
+ * mem_string_alloc - allocate size zeroed bytes from a string cache;
+ *                    size must not exceed MEM_STRING_MAX
+ */
+void *
+mem_string_alloc(size_t size)
+{
+  assert(size && size <= MEM_STRING_MAX);
+  return mem_cache_alloc(&mem_string_cache[(size - 1) / MEM_STRING_STEP]);
+}
+
+/*
+ * mem_strndup - copy at most len characters of s into a string cache;
+ *               len must be below MEM_STRING_MAX
+ */
+char *
+mem_strndup(const char *s, size_t len)
+{
+  assert(len < MEM_STRING_MAX);
+
+  len = strnlen(s, len);
+
+  char *ret = mem_string_alloc(len + 1);
+  memcpy(ret, s, len);
+
+  return ret;
+}
+
+/*
+ * mem_strfree - release memory obtained from mem_strndup() or
+ *               mem_string_alloc()
+ */
+void
+mem_strfree(const void *s)
+{
+  if (s == NULL)
+    return;
+
+  struct mem_slab *const slab = (struct mem_slab *)((uintptr_t)s & ~(uintptr_t)(SLAB_SIZE - 1));
+  mem_cache_free(slab->cache, (void *)s);
+}
+
 /* outofmemory()
  *
  * input        - NONE
@@ -75,17 +75,18 @@ monitor_count_memory(unsigned int *const count, size_t *const bytes)
 
 /*! \brief Looks up the monitor table for a given name
  * \param name Nick name to look up
+ * \param hash hash_string() of name
  */
 static struct Monitor *
-monitor_find_hash(const char *name)
+monitor_find_hash(const char *name, uint32_t hash)
 {
   dlink_node *node;
 
-  DLINK_FOREACH(node, monitor_hash[strhash(name)].head)
+  DLINK_FOREACH(node, monitor_hash[hash & (HASHSIZE - 1)].head)
   {
     struct Monitor *monitor = node->data;
 
-    if (irccmp(monitor->name, name) == 0)
+    if (monitor->hash_value == hash && irccmp(monitor->name, name) == 0)
       return monitor;
   }
 
@@ -104,7 +105,7 @@ monitor_signon(const struct Client *client)
 
   assert(IsClient(client));
 
-  struct Monitor *monitor = monitor_find_hash(client->name);
+  struct Monitor *monitor = monitor_find_hash(client->name, client->name_hash);
   if (monitor == NULL)
     return;  /* This name isn't on monitor */
 
@@ -127,7 +128,7 @@ monitor_signoff(const struct Client *client)
 
   assert(IsClient(client));
 
-  struct Monitor *monitor = monitor_find_hash(client->name);
+  struct Monitor *monitor = monitor_find_hash(client->name, client->name_hash);
   if (monitor == NULL)
     return;  /* This name isn't on monitor */
 
@@ -144,9 +145,9 @@ static void
 monitor_free(struct Monitor *monitor)
 {
   assert(monitor->monitored_by.head == NULL);
-  assert(dlinkFind(&monitor_hash[monitor->hash_value], monitor));
+  assert(dlinkFind(&monitor_hash[monitor->hash_value & (HASHSIZE - 1)], monitor));
 
-  dlinkDelete(&monitor->node, &monitor_hash[monitor->hash_value]);
+  dlinkDelete(&monitor->node, &monitor_hash[monitor->hash_value & (HASHSIZE - 1)]);
 
   xfree(monitor->name);
   xfree(monitor);
@@ -163,14 +164,15 @@ monitor_add_to_hash_table(const char *name, struct Client *client)
   dlink_node *node = NULL;
 
   /* If found NULL (no header for this name), make one... */
-  struct Monitor *monitor = monitor_find_hash(name);
+  const uint32_t hash = hash_string(name);
+  struct Monitor *monitor = monitor_find_hash(name, hash);
   if (monitor == NULL)
   {
     monitor = xcalloc(sizeof(*monitor));
     monitor->name = xstrdup(name);
-    monitor->hash_value = strhash(monitor->name);
+    monitor->hash_value = hash;
 
-    dlinkAdd(monitor, &monitor->node, &monitor_hash[monitor->hash_value]);
+    dlinkAdd(monitor, &monitor->node, &monitor_hash[monitor->hash_value & (HASHSIZE - 1)]);
   }
   else
   {
@@ -196,7 +198,7 @@ monitor_add_to_hash_table(const char *name, struct Client *client)
 void
 monitor_del_from_hash_table(const char *name, struct Client *client)
 {
-  struct Monitor *monitor = monitor_find_hash(name);
+  struct Monitor *monitor = monitor_find_hash(name, hash_string(name));
   if (monitor == NULL)
     return;  /* No header found for that name. i.e. it's not being monitored */
 
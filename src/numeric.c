@@ -49,7 +49,7 @@ static const char *const replies[] =
   /* 208 */  [RPL_TRACENEWTYPE] = "<newtype> 0 %s",
   /* 209 */  [RPL_TRACECLASS] = "Class %s %u",
   /* 211 */  [RPL_STATSLINKINFO] = "%s %u %u %ju %u %ju :%ju %ju %s",
-  /* 212 */  [RPL_STATSCOMMANDS] = "%s %u %ju %u %u",
+  /* 212 */  [RPL_STATSCOMMANDS] = "%s %u %ju %u %u %ju %ju",
   /* 213 */  [RPL_STATSCLINE] = "%c %s %s %s %u %s",
   /* 215 */  [RPL_STATSILINE] = "%c %s * %s@%s %u %s",
   /* 216 */  [RPL_STATSKLINE] = "%c %s * %s :%s",
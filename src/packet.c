@@ -38,11 +38,12 @@
 #include "memory.h"
 #include "send.h"
 #include "misc.h"
+#include "scan.h"
+#include <sys/uio.h>
 
 
-enum { READBUF_SIZE = 16384 };
-
-static char readBuf[READBUF_SIZE];
+/* Holds lines that straddle two recvq blocks */
+static char lineBuf[IRCD_BUFSIZE];
 
 
 /*
@@ -74,60 +75,132 @@ client_dopacket(struct Client *client, char *buffer, unsigned int length)
 /* extract_one_line()
  *
  * inputs       - pointer to a dbuf queue
- *              - pointer to buffer to copy data to
- * output       - length of <buffer>
- * side effects - one line is copied and removed from the dbuf
+ *              - pointer to where the length of the line is stored
+ *              - pointer to where the block holding the line is stored
+ * output       - pointer to the NUL terminated line, or NULL if there
+ *                is no complete line in the queue
+ * side effects - one line is removed from the dbuf. If the line is
+ *                contained in a single block, it is terminated and
+ *                returned in place, and a reference to that block is
+ *                stored in <block> which the caller must release with
+ *                dbuf_ref_free() once done with the line. Only lines
+ *                straddling two blocks are copied, into lineBuf.
  */
-static size_t
-extract_one_line(struct dbuf_queue *qptr, char *buffer)
+static char *
+extract_one_line(struct dbuf_queue *qptr, size_t *length, struct dbuf_block **block)
 {
-  size_t line_bytes = 0, eol_bytes = 0;
-  dlink_node *node;
-
-  DLINK_FOREACH(node, qptr->blocks.head)
+  while (dbuf_length(qptr))
   {
-    const struct dbuf_block *block = node->data;
-    unsigned int idx;
-
-    if (node == qptr->blocks.head)
-      idx = qptr->pos;
-    else
-      idx = 0;
+    size_t line_bytes = 0, eol_bytes = 0;
+    bool straddles = false;
 
-    for (; idx < block->size; ++idx)
+    for (unsigned int i = 0; i < dbuf_count(qptr); ++i)
     {
-      char c = block->data[idx];
+      const struct dbuf_block *b = dbuf_nth(qptr, i);
+      size_t idx = i ? 0 : qptr->pos;
 
-      if (IsEol(c))
+      if (eol_bytes == 0)
       {
-        ++eol_bytes;
+        const char *eol = scan_find(b->data + idx, b->size - idx, &scan_set_eol);
 
+        if (eol == NULL)
+        {
+          line_bytes += b->size - idx;
+          continue;
+        }
+
+        line_bytes += eol - (b->data + idx);
+        idx = eol - b->data;
+
+        /* The first eol byte has to be in the same block for the line to be terminated in place */
+        straddles = i != 0;
+      }
+
+      for (; idx < b->size; ++idx)
+      {
         /* Allow 2 eol bytes per message */
-        if (eol_bytes == 2)
+        if (!IsEol(b->data[idx]) || ++eol_bytes == 2)
           goto out;
       }
-      else if (eol_bytes)
-        goto out;
-      else if (line_bytes++ < IRCD_BUFSIZE - 2)
-        *buffer++ = c;
     }
-  }
 
 out:
+    /*
+     * Now, if we haven't found an EOL, ignore all line bytes
+     * that we have read, since this is a partial line case.
+     */
+    if (eol_bytes == 0)
+      return NULL;
 
-  /*
-   * Now, if we haven't found an EOL, ignore all line bytes
-   * that we have read, since this is a partial line case.
-   */
-  if (eol_bytes)
-    *buffer = '\0';
-  else
-    line_bytes = 0;
+    if (line_bytes == 0)
+    {
+      /* Empty line, skip it */
+      dbuf_delete(qptr, eol_bytes);
+      continue;
+    }
+
+    const size_t len = IRCD_MIN(line_bytes, IRCD_BUFSIZE - 2);
+    char *line;
+
+    if (straddles == false)
+    {
+      *block = dbuf_nth(qptr, 0);
+      (*block)->refs++;
+
+      line = (*block)->data + qptr->pos;
+    }
+    else
+    {
+      size_t copied = 0;
+
+      *block = NULL;
 
-  /* Remove what is now unnecessary */
-  dbuf_delete(qptr, line_bytes + eol_bytes);
+      for (unsigned int i = 0; copied < len; ++i)
+      {
+        const struct dbuf_block *b = dbuf_nth(qptr, i);
+        const size_t idx = i ? 0 : qptr->pos;
+        const size_t avail = IRCD_MIN(b->size - idx, len - copied);
+
+        memcpy(lineBuf + copied, b->data + idx, avail);
+        copied += avail;
+      }
+
+      line = lineBuf;
+    }
+
+    line[len] = '\0';
+    *length = len;
+
+    /* Remove what is now unnecessary */
+    dbuf_delete(qptr, line_bytes + eol_bytes);
 
-  return IRCD_MIN(line_bytes, IRCD_BUFSIZE - 2);
+    return line;
+  }
+
+  return NULL;
+}
+
+/*
+ * parse_one_line - parse a single line from the client's recvq
+ * output - false if there is no complete line to be parsed
+ */
+static bool
+parse_one_line(struct Client *client)
+{
+  struct dbuf_block *block;
+  size_t length;
+
+  char *line = extract_one_line(&client->connection->buf_recvq, &length, &block);
+  if (line == NULL)
+    return false;
+
+  /* The block is referenced until parse() is done; the client may be exited and its recvq cleared meanwhile */
+  client_dopacket(client, line, length);
+
+  if (block)
+    dbuf_ref_free(block);
+
+  return true;
 }
 
 /*
@@ -149,11 +222,8 @@ parse_client_queued(struct Client *client)
       if (i >= MAX_FLOOD)
         return;
 
-      size_t dolen = extract_one_line(&client->connection->buf_recvq, readBuf);
-      if (dolen == 0)
+      if (parse_one_line(client) == false)
         return;
-
-      client_dopacket(client, readBuf, dolen);
       ++i;
 
       /*
@@ -172,11 +242,8 @@ parse_client_queued(struct Client *client)
       if (IsDefunct(client))
         return;
 
-      size_t dolen = extract_one_line(&client->connection->buf_recvq, readBuf);
-      if (dolen == 0)
+      if (parse_one_line(client) == false)
         return;
-
-      client_dopacket(client, readBuf, dolen);
     }
   }
   else if (IsClient(client))
@@ -217,11 +284,8 @@ parse_client_queued(struct Client *client)
           (HasFlag(client, FLAGS_FLOODDONE) ? MAX_FLOOD : MAX_FLOOD_BURST))
           return;
 
-      size_t dolen = extract_one_line(&client->connection->buf_recvq, readBuf);
-      if (dolen == 0)
+      if (parse_one_line(client) == false)
         return;
-
-      client_dopacket(client, readBuf, dolen);
       ++client->connection->sent_parsed;
     }
   }
@@ -303,16 +367,25 @@ read_packet(fde_t *F, void *data)
    */
   while (true)
   {
+    /*
+     * Read straight into the recvq: whatever room is left in its last
+     * block, and a few more blocks, so that a burst is taken in with
+     * about as few reads as into one large buffer.
+     */
+    struct iovec iov[DBUF_SPARE_MAX + 1];
+
     if (tls_isusing(&F->tls))
     {
       bool want_write = false;
-      length = tls_read(&F->tls, readBuf, sizeof(readBuf), &want_write);
+
+      dbuf_map_free(&client->connection->buf_recvq, iov, 1);
+      length = tls_read(&F->tls, iov[0].iov_base, iov[0].iov_len, &want_write);
 
       if (want_write == true)
         comm_setselect(F, COMM_SELECT_WRITE, sendq_unblocked, client, 0);
     }
     else
-      length = recv(F->fd, readBuf, sizeof(readBuf), 0);
+      length = readv(F->fd, iov, dbuf_map_free(&client->connection->buf_recvq, iov, DBUF_SPARE_MAX + 1));
 
     if (length <= 0)
     {
@@ -327,7 +400,7 @@ read_packet(fde_t *F, void *data)
       return;
     }
 
-    dbuf_put(&client->connection->buf_recvq, readBuf, length);
+    dbuf_commit_free(&client->connection->buf_recvq, length);
 
     client->connection->last_ping = event_base->time.sec_monotonic;
     client->connection->last_data = event_base->time.sec_monotonic;
@@ -40,61 +40,41 @@
 #include "user.h"
 #include "server.h"
 #include "packet.h"
+#include "misc.h"
+#include "scan.h"
 
 
 /*
- * (based on orabidoo's parser code)
+ * Commands are kept in an array sorted by name, which is what STATS m
+ * walks, and looked up through a perfect hash built over that array.
+ * The command set only changes when modules are loaded or unloaded, so
+ * the hash is simply rebuilt by mod_add_cmd() and mod_del_cmd().
  *
- * This has always just been a trie. Look at volume III of Knuth ACP
- *
- *
- * ok, you start out with an array of pointers, each one corresponds
- * to a letter at the current position in the command being examined.
- *
- * so roughly you have this for matching 'trie' or 'tie'
- *
- * 't' points -> [MessageTree *] 'r' -> [MessageTree *] -> 'i'
- *   -> [MessageTree *] -> [MessageTree *] -> 'e' and matches
- *
- *                               'i' -> [MessageTree *] -> 'e' and matches
- *
- * BUGS (Limitations!)
- *
- * I designed this trie to parse ircd commands. Hence it currently
- * casefolds. This is trivial to fix by increasing MAXPTRLEN.
- * This trie also "folds" '{' etc. down. This means, the input to this
- * trie must be alpha tokens only. This again, is a limitation that
- * can be overcome by increasing MAXPTRLEN to include upper/lower case
- * at the expense of more memory. At the extreme end, you could make
- * MAXPTRLEN 128.
- *
- * This is also not a patricia trie. On short ircd tokens, this is
- * not likely going to matter.
- *
- * Diane Bruce (Dianora), June 6 2003
+ * The hash is of the hash-and-displace kind: the 64 bit FNV-1a hash of
+ * the upper-cased command picks a bucket with its upper half, and the
+ * bucket's seed, mixed with the lower half, picks the slot. Building the
+ * table assigns every bucket, largest first, the first seed that sends
+ * all of its commands into free slots. A lookup therefore hashes the
+ * command once, reads one seed and one slot, and does one compare.
  */
+enum
+{
+  MSG_SEED_TRIES = 1 << 16,
+  MSG_HASH_GROW_MAX = 4  /* Times the slot array is doubled before giving up */
+};
 
-/*
- * Must be a power of 2, and larger than 26 [a-z]|[A-Z]. It's used to allocate
- * the set of pointers at each node of the tree.
- * There are MAXPTRLEN pointers at each node. Obviously, there have to be more
- * pointers than ASCII letters. 32 is a nice number since there is then no need
- * to shift 'A'/'a' to base 0 index, at the expense of a few never used
- * pointers.
- * For a small parser like this, this is a good compromise and does
- * make it somewhat faster. - Dianora
- */
-enum { MAXPTRLEN = 32 };
-
+static struct Message **msg_list;  /* Sorted by command name */
+static unsigned int msg_list_count;
+static unsigned int msg_list_size;
 
-static struct MessageTree
+static struct
 {
-  int links; /* Count of all pointers (including msg) at this node
-              * used as reference count for deletion of _this_ node.
-              */
-  struct Message *msg;
-  struct MessageTree *pointers[MAXPTRLEN];
-} msg_tree;
+  struct Message **slot;
+  uint32_t *seed;
+  unsigned int mask;  /* Number of slots - 1 */
+  unsigned int buckets;
+  size_t maxlen;  /* Longest command name */
+} msg_hash;
 
 
 /* remove_unknown()
@@ -205,6 +185,21 @@ parse_handle_numeric(unsigned int numeric, struct Client *source, int parc, char
   }
 }
 
+/* parse_clock()
+ *
+ * inputs	- NONE
+ * output	- monotonic time in nanoseconds
+ * side effects	- none
+ */
+static uintmax_t
+parse_clock(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uintmax_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 /* handle_command()
  *
  * inputs       - pointer to message block
@@ -232,9 +227,43 @@ parse_handle_command(struct Message *message, struct Client *source,
   if (handler->args_min &&
       ((i < handler->args_min) ||
        (handler->empty_last_arg != true && EmptyString(para[handler->args_min - 1]))))
+  {
     sendto_one_numeric(source, &me, ERR_NEEDMOREPARAMS, message->cmd);
-  else
-    handler->handler(source, i, para);
+    return;
+  }
+
+  const uintmax_t start = parse_clock();
+  handler->handler(source, i, para);
+
+  ++message->dispatched;
+  message->dispatch_time += parse_clock() - start;
+}
+
+/* parse_token_end()
+ *
+ * inputs       - pointer into the buffer, pointer to its terminating NUL
+ * output       - pointer to the first space or NUL at or after s
+ * side effects - none
+ */
+static char *
+parse_token_end(char *s, char *bufend)
+{
+  char *p = (char *)scan_find(s, bufend - s, &scan_set_token);
+  return p ? p : bufend;
+}
+
+/* parse_find_space()
+ *
+ * inputs       - pointer into the buffer, pointer to its terminating NUL
+ * output       - pointer to the first space at or after s, or NULL if the
+ *                string ends first
+ * side effects - none
+ */
+static char *
+parse_find_space(char *s, char *bufend)
+{
+  char *p = parse_token_end(s, bufend);
+  return *p == ' ' ? p : NULL;
 }
 
 /*
@@ -271,7 +300,7 @@ parse(struct Client *client, char *pbuffer, char *bufend)
      */
     const char *const sender = ++ch;
 
-    if ((s = strchr(ch, ' ')))
+    if ((s = parse_find_space(ch, bufend)))
     {
       *s = '\0';
       ch = ++s;
@@ -339,7 +368,7 @@ parse(struct Client *client, char *pbuffer, char *bufend)
   }
   else
   {
-    if ((s = strchr(ch, ' ')))
+    if ((s = parse_find_space(ch, bufend)))
       *s++ = '\0';
 
     if ((message = find_command(ch)) == NULL)
@@ -415,8 +444,7 @@ parse(struct Client *client, char *pbuffer, char *bufend)
        if (parc >= paramcount)
          break;
 
-       while (*s && *s != ' ')
-         ++s;
+       s = parse_token_end(s, bufend);
     }
   }
 
@@ -428,145 +456,314 @@ parse(struct Client *client, char *pbuffer, char *bufend)
     parse_handle_numeric(numeric, from, parc, para);
 }
 
-/* add_msg_element()
+/* msg_hash_key()
  *
- * inputs	- pointer to MessageTree
- *		- pointer to Message to add for given command
- *		- pointer to current portion of command being added
- * output	- NONE
- * side effects	- recursively build the Message Tree ;-)
- */
-/*
- * How this works.
- *
- * The code first checks to see if its reached the end of the command
- * If so, that struct MessageTree has a msg pointer updated and the links
- * count incremented, since a msg pointer is a reference.
- * Then the code descends recursively, building the trie.
- * If a pointer index inside the struct MessageTree is NULL a new
- * child struct MessageTree has to be allocated.
- * The links (reference count) is incremented as they are created
- * in the parent.
+ * inputs	- command name
+ *		- pointer to hash value to fill in
+ * output	- false if the name can't be a command, true otherwise
+ * side effects	- none
  */
-static void
-add_msg_element(struct MessageTree *mtree_p, struct Message *msg_p,
-                const char *cmd)
+static bool
+msg_hash_key(const char *cmd, uint64_t *hash)
 {
-  if (*cmd == '\0')
+  uint64_t h = UINT64_C(0xcbf29ce484222325);
+  const char *p = cmd;
+
+  for (; *p; ++p)
   {
-    mtree_p->msg = msg_p;
-    mtree_p->links++;  /* Have msg pointer, so up ref count */
+    if (!IsAlpha(*p))
+      return false;
+
+    h ^= ToUpper(*p);
+    h *= UINT64_C(0x100000001b3);
   }
-  else
+
+  *hash = h;
+  return (size_t)(p - cmd) <= msg_hash.maxlen;
+}
+
+static inline unsigned int
+msg_hash_slot(uint64_t hash, uint32_t seed)
+{
+  uint32_t h = (uint32_t)hash ^ seed;
+
+  /* MurmurHash3 finalizer */
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+
+  return h & msg_hash.mask;
+}
+
+static inline unsigned int
+msg_hash_bucket(uint64_t hash)
+{
+  return (hash >> 32) % msg_hash.buckets;
+}
+
+/* msg_hash_place()
+ *
+ * inputs	- commands of one bucket, their hashes and count
+ * output	- true if a seed was found
+ * side effects	- the bucket's commands are stored in the slots the
+ *		  found seed sends them to
+ */
+static bool
+msg_hash_place(struct Message **msg, const uint64_t *hash, unsigned int count, unsigned int bucket)
+{
+  unsigned int slot[count];
+
+  for (uint32_t seed = 0; seed < MSG_SEED_TRIES; ++seed)
   {
-    /*
-     * *cmd & (MAXPTRLEN-1)
-     * convert the char pointed to at *cmd from ASCII to an integer
-     * between 0 and MAXPTRLEN.
-     * Thus 'A' -> 0x1 'B' -> 0x2 'c' -> 0x3 etc.
-     */
-    struct MessageTree *ntree_p = mtree_p->pointers[*cmd & (MAXPTRLEN - 1)];
-    if (ntree_p == NULL)
+    unsigned int i = 0;
+
+    for (; i < count; ++i)
     {
-      ntree_p = xcalloc(sizeof(*ntree_p));
-      mtree_p->pointers[*cmd & (MAXPTRLEN - 1)] = ntree_p;
+      slot[i] = msg_hash_slot(hash[i], seed);
 
-      mtree_p->links++;  /* Have new pointer, so up ref count */
+      if (msg_hash.slot[slot[i]])
+        break;
+
+      unsigned int j = 0;
+      while (j < i && slot[j] != slot[i])
+        ++j;
+      if (j < i)
+        break;
     }
 
-    add_msg_element(ntree_p, msg_p, cmd + 1);
+    if (i == count)
+    {
+      for (i = 0; i < count; ++i)
+        msg_hash.slot[slot[i]] = msg[i];
+
+      msg_hash.seed[bucket] = seed;
+      return true;
+    }
   }
+
+  return false;
 }
 
-/* del_msg_element()
+/* msg_hash_build()
  *
- * inputs	- Pointer to MessageTree to delete from
- *		- pointer to command name to delete
+ * inputs	- NONE
  * output	- NONE
- * side effects	- recursively deletes a token from the Message Tree ;-)
- */
-/*
- * How this works.
- *
- * Well, first off, the code recursively descends into the trie
- * until it finds the terminating letter of the command being removed.
- * Once it has done that, it marks the msg pointer as NULL then
- * reduces the reference count on that allocated struct MessageTree
- * since a command counts as a reference.
- *
- * Then it pops up the recurse stack. As it comes back up the recurse
- * The code checks to see if the child now has no pointers or msg
- * i.e. the links count has gone to zero. If it's no longer used, the
- * child struct MessageTree can be deleted. The parent reference
- * to this child is then removed and the parents link count goes down.
- * Thus, we continue to go back up removing all unused MessageTree(s)
+ * side effects	- the perfect hash is rebuilt from msg_list; if no
+ *		  seeds are found after MSG_HASH_GROW_MAX doublings, the
+ *		  hash is left empty and find_command() searches msg_list
  */
 static void
-del_msg_element(struct MessageTree *mtree_p, const char *cmd)
+msg_hash_build(void)
 {
-  /*
-   * In case this is called for a nonexistent command
-   * check that there is a msg pointer here, else links-- goes -ve
-   * -db
-   */
-  if (*cmd == '\0' && mtree_p->msg)
-  {
-    mtree_p->msg = NULL;
-    mtree_p->links--;
-  }
-  else
+  xfree(msg_hash.slot);
+  xfree(msg_hash.seed);
+  memset(&msg_hash, 0, sizeof(msg_hash));
+
+  if (msg_list_count == 0)
+    return;
+
+  const unsigned int count = msg_list_count;
+  struct Message **msg = xcalloc(sizeof(*msg) * count);
+  uint64_t *hash = xcalloc(sizeof(*hash) * count);
+  unsigned int *first = xcalloc(sizeof(*first) * (count + 1));
+  unsigned int *order = xcalloc(sizeof(*order) * count);
+  unsigned int size = 8;
+
+  while (size < count + count / 2)
+    size <<= 1;
+
+  msg_hash.maxlen = SIZE_MAX;
+  msg_hash.buckets = count / 2 + 1;
+
+  for (unsigned int grow = 0; ; ++grow)
   {
-    struct MessageTree *ntree_p = mtree_p->pointers[*cmd & (MAXPTRLEN - 1)];
-    if (ntree_p)
+    msg_hash.mask = size - 1;
+    msg_hash.slot = xcalloc(sizeof(*msg_hash.slot) * size);
+    msg_hash.seed = xcalloc(sizeof(*msg_hash.seed) * msg_hash.buckets);
+
+    /* Group the commands by bucket */
+    memset(first, 0, sizeof(*first) * (count + 1));
+
+    for (unsigned int i = 0; i < count; ++i)
     {
-      del_msg_element(ntree_p, cmd + 1);
+      msg_hash_key(msg_list[i]->cmd, &hash[i]);  /* Names are checked by mod_add_cmd() */
+      ++first[msg_hash_bucket(hash[i])];
+    }
 
-      if (ntree_p->links == 0)
+    for (unsigned int b = 0, sum = 0; b < msg_hash.buckets; ++b)
+    {
+      const unsigned int n = first[b];
+
+      first[b] = sum;
+      sum += n;
+    }
+
+    first[msg_hash.buckets] = count;
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+      const unsigned int b = msg_hash_bucket(hash[i]);
+      unsigned int pos = first[b];
+
+      while (msg[pos])
+        ++pos;
+
+      msg[pos] = msg_list[i];
+      order[pos] = i;
+    }
+
+    /* Then place the buckets, largest first */
+    bool done = true;
+
+    for (unsigned int n = count; n && done; --n)
+    {
+      for (unsigned int b = 0; b < msg_hash.buckets && done; ++b)
       {
-        mtree_p->pointers[*cmd & (MAXPTRLEN - 1)] = NULL;
-        mtree_p->links--;
-        xfree(ntree_p);
+        if (first[b + 1] - first[b] != n)
+          continue;
+
+        uint64_t bucket_hash[n];
+
+        for (unsigned int i = 0; i < n; ++i)
+          bucket_hash[i] = hash[order[first[b] + i]];
+
+        done = msg_hash_place(&msg[first[b]], bucket_hash, n, b);
       }
     }
+
+    if (done)
+      break;
+
+    xfree(msg_hash.slot);
+    xfree(msg_hash.seed);
+    msg_hash.slot = NULL;
+    msg_hash.seed = NULL;
+
+    /*
+     * Commands that share their full 64-bit hash can never be told apart
+     * by a seed, no matter how many slots there are
+     */
+    if (grow == MSG_HASH_GROW_MAX)
+    {
+      ilog(LOG_TYPE_IRCD, "Unable to build command hash for %u commands in %u slots -- "
+           "falling back to binary search", count, size);
+      break;
+    }
+
+    memset(msg, 0, sizeof(*msg) * count);
+    size <<= 1;
   }
+
+  msg_hash.maxlen = 0;
+  if (msg_hash.slot)
+    for (unsigned int i = 0; i < count; ++i)
+      msg_hash.maxlen = IRCD_MAX(msg_hash.maxlen, strlen(msg_list[i]->cmd));
+
+  xfree(msg);
+  xfree(hash);
+  xfree(first);
+  xfree(order);
 }
 
-/* msg_tree_parse()
+/* msg_list_cmp()
  *
- * inputs	- Pointer to command to find
- *		- Pointer to MessageTree root
- * output	- Find given command returning Message * if found NULL if not
+ * inputs	- two command names
+ * output	- <0, 0 or >0 as the first sorts before, equal to or after
+ *		  the second, ignoring case
  * side effects	- none
  */
-static struct Message *
-msg_tree_parse(const char *cmd)
+static int
+msg_list_cmp(const char *s1, const char *s2)
 {
-  struct MessageTree *mtree = &msg_tree;
+  const unsigned char *str1 = (const unsigned char *)s1;
+  const unsigned char *str2 = (const unsigned char *)s2;
 
-  assert(!EmptyString(cmd));
+  for (; ToUpper(*str1) == ToUpper(*str2); ++str1, ++str2)
+    if (*str1 == '\0')
+      return 0;
 
-  while (IsAlpha(*cmd) && (mtree = mtree->pointers[*cmd & (MAXPTRLEN - 1)]))
-    if (*++cmd == '\0')
-      return mtree->msg;
+  return ToUpper(*str1) - ToUpper(*str2);
+}
 
-  return NULL;
+/* msg_list_find()
+ *
+ * inputs	- command name
+ *		- pointer to index to fill in
+ * output	- true if the command is in msg_list
+ * side effects	- *index is set to the command's position, or to the
+ *		  position it would have to be inserted at
+ */
+static bool
+msg_list_find(const char *cmd, unsigned int *index)
+{
+  unsigned int low = 0, high = msg_list_count;
+
+  while (low < high)
+  {
+    const unsigned int mid = low + (high - low) / 2;
+    const int ret = msg_list_cmp(msg_list[mid]->cmd, cmd);
+
+    if (ret == 0)
+    {
+      *index = mid;
+      return true;
+    }
+
+    if (ret < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  *index = low;
+  return false;
 }
 
 /* mod_add_cmd()
  *
  * inputs	- pointer to struct Message
- * output	- none
+ * output	- false if the command name is not made up of letters only,
+ *		  true otherwise
  * side effects - load this one command name
  */
-void
+bool
 mod_add_cmd(struct Message *msg)
 {
+  unsigned int index;
+
   assert(msg);
   assert(msg->cmd);
 
+  /* The command hash can only deal with names made up of letters */
+  const char *p = msg->cmd;
+  while (IsAlpha(*p))
+    ++p;
+
+  if (p == msg->cmd || *p)
+  {
+    ilog(LOG_TYPE_IRCD, "Refusing to add command \"%s\" -- command names may only consist of letters",
+         msg->cmd);
+    return false;
+  }
+
   /* Command already added? */
-  if (msg_tree_parse(msg->cmd) == NULL)
-    add_msg_element(&msg_tree, msg, msg->cmd);
+  if (msg_list_find(msg->cmd, &index))
+    return true;
+
+  if (msg_list_count == msg_list_size)
+  {
+    msg_list_size = msg_list_size ? msg_list_size * 2 : 64;
+    msg_list = xrealloc(msg_list, sizeof(*msg_list) * msg_list_size);
+  }
+
+  memmove(&msg_list[index + 1], &msg_list[index], sizeof(*msg_list) * (msg_list_count - index));
+  msg_list[index] = msg;
+  ++msg_list_count;
+
+  msg_hash_build();
+  return true;
 }
 
 /* mod_del_cmd()
@@ -578,11 +775,18 @@ mod_add_cmd(struct Message *msg)
 void
 mod_del_cmd(struct Message *msg)
 {
+  unsigned int index;
+
   assert(msg);
   assert(msg->cmd);
 
-  if (msg_tree_parse(msg->cmd))
-    del_msg_element(&msg_tree, msg->cmd);
+  if (msg_list_find(msg->cmd, &index) == false)
+    return;
+
+  --msg_list_count;
+  memmove(&msg_list[index], &msg_list[index + 1], sizeof(*msg_list) * (msg_list_count - index));
+
+  msg_hash_build();
 }
 
 /* find_command()
@@ -594,23 +798,27 @@ mod_del_cmd(struct Message *msg)
 struct Message *
 find_command(const char *cmd)
 {
-  return msg_tree_parse(cmd);
-}
+  uint64_t hash;
 
-static void
-recurse_report_messages(struct Client *source, const struct MessageTree *mtree)
-{
-  if (mtree->msg)
-    sendto_one_numeric(source, &me, RPL_STATSCOMMANDS,
-                       mtree->msg->cmd,
-                       mtree->msg->count,
-                       mtree->msg->bytes,
-                       mtree->msg->rcount,
-                       mtree->msg->ecount);
-
-  for (unsigned int i = 0; i < MAXPTRLEN; ++i)
-    if (mtree->pointers[i])
-      recurse_report_messages(source, mtree->pointers[i]);
+  assert(!EmptyString(cmd));
+
+  if (msg_hash.slot == NULL)
+  {
+    unsigned int index;
+
+    if (msg_list_find(cmd, &index))
+      return msg_list[index];
+    return NULL;
+  }
+
+  if (msg_hash_key(cmd, &hash) == false)
+    return NULL;
+
+  struct Message *msg = msg_hash.slot[msg_hash_slot(hash, msg_hash.seed[msg_hash_bucket(hash)])];
+  if (msg && irccmp(msg->cmd, cmd) == 0)
+    return msg;
+
+  return NULL;
 }
 
 /* report_messages()
@@ -622,11 +830,19 @@ recurse_report_messages(struct Client *source, const struct MessageTree *mtree)
 void
 report_messages(struct Client *source)
 {
-  const struct MessageTree *const mtree = &msg_tree;
+  for (unsigned int i = 0; i < msg_list_count; ++i)
+  {
+    const struct Message *const msg = msg_list[i];
 
-  for (unsigned int i = 0; i < MAXPTRLEN; ++i)
-    if (mtree->pointers[i])
-      recurse_report_messages(source, mtree->pointers[i]);
+    sendto_one_numeric(source, &me, RPL_STATSCOMMANDS,
+                       msg->cmd,
+                       msg->count,
+                       msg->bytes,
+                       msg->rcount,
+                       msg->ecount,
+                       msg->dispatched,
+                       msg->dispatch_time / 1000);
+  }
 }
 
 /* m_not_oper()
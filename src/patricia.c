@@ -1009,4 +1009,50 @@ patricia_try_search_best_addr(patricia_tree_t *tree, struct sockaddr *addr, int
 
   return NULL;
 }
+
+/*
+ * Collects every prefix in the tree that contains the address, longest
+ * first, into 'nodes', which has room for PATRICIA_MAXBITS + 1 entries.
+ * Returns the number of prefixes found.
+ */
+int
+patricia_search_all_addr(patricia_tree_t *tree, struct sockaddr *addr, patricia_node_t **nodes)
+{
+  patricia_node_t *stack[PATRICIA_MAXBITS + 1];
+  prefix_t prefix;
+  int cnt = 0, found = 0;
+  void *dest;
+
+  if (addr->sa_family == AF_INET6)
+    dest = &((struct sockaddr_in6 *)addr)->sin6_addr;
+  else
+    dest = &((struct sockaddr_in *)addr)->sin_addr;
+
+  if (tree->head == NULL ||
+      New_Prefix2(addr->sa_family, dest, tree->maxbits, &prefix) == NULL)
+    return 0;
+
+  patricia_node_t *node = tree->head;
+  const unsigned char *const bytes = prefix_touchar(&prefix);
+
+  while (node && node->bit < prefix.bitlen)
+  {
+    if (node->prefix)
+      stack[cnt++] = node;
+
+    if (BIT_TEST(bytes[node->bit >> 3], 0x80 >> (node->bit & 0x07)))
+      node = node->r;
+    else
+      node = node->l;
+  }
+
+  if (node && node->prefix)
+    stack[cnt++] = node;
+
+  while (--cnt >= 0)
+    if (comp_with_mask(prefix_tochar(stack[cnt]->prefix), prefix_tochar(&prefix), stack[cnt]->prefix->bitlen))
+      nodes[found++] = stack[cnt];
+
+  return found;
+}
 /* } */
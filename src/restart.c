@@ -63,6 +63,7 @@ server_die(const char *message, bool restart)
     sendto_one_notice(node->data, &me, ":%s", buf);
 
   sendto_server(NULL, 0, 0, ":%s ERROR :%s", me.id, buf);
+  send_queued_all();
 
   ilog(LOG_TYPE_IRCD, "%s", buf);
 
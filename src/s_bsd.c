@@ -32,6 +32,7 @@
 #include "fdlist.h"
 #include "s_bsd.h"
 #include "client.h"
+#include "intern.h"
 #include "dbuf.h"
 #include "event.h"
 #include "irc_string.h"
@@ -46,6 +47,7 @@
 #include "server.h"
 #include "send.h"
 #include "memory.h"
+#include "misc.h"
 #include "user.h"
 
 
@@ -202,6 +204,7 @@ void
 add_connection(struct Listener *listener, struct irc_ssaddr *irn, int fd)
 {
   struct Client *client = client_make(NULL);
+  char buf[HOSTIPLEN + 1];
 
   client->connection->fd = fd_open(fd, true, listener_has_flag(listener, LISTENER_TLS) ?
                                    "Incoming TLS connection" : "Incoming connection");
@@ -213,17 +216,18 @@ add_connection(struct Listener *listener, struct irc_ssaddr *irn, int fd)
   client->ip = *irn;
 
   getnameinfo((const struct sockaddr *)&client->ip,
-              client->ip.ss_len, client->sockhost,
-              sizeof(client->sockhost), NULL, 0, NI_NUMERICHOST);
+              client->ip.ss_len, buf,
+              sizeof(buf), NULL, 0, NI_NUMERICHOST);
 
-  if (client->sockhost[0] == ':' &&
-      client->sockhost[1] == ':')
+  if (buf[0] == ':' &&
+      buf[1] == ':')
   {
-    memmove(client->sockhost + 1, client->sockhost, sizeof(client->sockhost) - 1);
-    client->sockhost[0] = '0';
+    memmove(buf + 1, buf, sizeof(buf) - 1);
+    buf[0] = '0';
   }
 
-  strlcpy(client->host, client->sockhost, sizeof(client->host));
+  intern_set(&client->sockhost, buf, HOSTIPLEN);
+  intern_set(&client->host, client->sockhost, HOSTLEN);
 
   client->connection->listener = listener;
   ++listener->ref_count;
@@ -271,10 +275,60 @@ comm_ignore_errno(int ierrno)
   }
 }
 
+/*
+ * comm_select_timeout() - figure out for how many milliseconds
+ * comm_select() may wait for network events, which is until the next
+ * event or timer is due
+ */
+int
+comm_select_timeout(void)
+{
+  uintmax_t timeout = IRCD_MIN(event_next(), timer_next());
+
+  /* Channel listings are continued from io_loop(); don't hold them up */
+  if (dlink_list_length(&listing_client_list))
+    timeout = IRCD_MIN(timeout, SELECT_DELAY);
+
+  return IRCD_MIN(timeout, INT_MAX);
+}
+
+/*
+ * comm_timeout_expired() - called from the timer wheel when the
+ * socket timeout has expired
+ */
+static void
+comm_timeout_expired(void *data)
+{
+  fde_t *F = data;
+  void (*hdl)(fde_t *, void *) = F->timeout_handler;
+  void *hdl_data = F->timeout_data;
+
+  F->timeout_handler = NULL;
+  F->timeout_data = NULL;
+  hdl(F, hdl_data);
+}
+
+/*
+ * comm_flush_expired() - called from the timer wheel when it's time
+ * to run the flush function
+ */
+static void
+comm_flush_expired(void *data)
+{
+  fde_t *F = data;
+  void (*hdl)(fde_t *, void *) = F->flush_handler;
+  void *hdl_data = F->flush_data;
+
+  F->flush_handler = NULL;
+  F->flush_data = NULL;
+  hdl(F, hdl_data);
+}
+
 /*
  * comm_settimeout() - set the socket timeout
  *
- * Set the timeout for the fd
+ * Set the timeout for the fd. The handler is called from timer_run()
+ * once 'timeout' seconds have passed; a timeout of 0 cancels it.
  */
 void
 comm_settimeout(fde_t *F, uintmax_t timeout, void (*callback)(fde_t *, void *), void *cbdata)
@@ -282,16 +336,20 @@ comm_settimeout(fde_t *F, uintmax_t timeout, void (*callback)(fde_t *, void *),
   assert(F);
   assert(F->flags.open == true);
 
-  F->timeout = timeout ? event_base->time.sec_monotonic + timeout : 0;
   F->timeout_handler = callback;
   F->timeout_data = cbdata;
+
+  if (timeout)
+    timer_add(&F->timeout, timeout * 1000, comm_timeout_expired, F);
+  else
+    timer_del(&F->timeout);
 }
 
 /*
  * comm_setflush() - set a flush function
  *
- * A flush function is simply a function called if found during
- * comm_timeouts(). Its basically a second timeout, except in this case
+ * A flush function is simply a function called from timer_run().
+ * Its basically a second timeout, except in this case
  * I'm too lazy to implement multiple timeout functions! :-)
  * its kinda nice to have it separate, since this is designed for
  * flush functions, and when comm_close() is implemented correctly
@@ -305,49 +363,13 @@ comm_setflush(fde_t *F, uintmax_t timeout, void (*callback)(fde_t *, void *), vo
   assert(F);
   assert(F->flags.open == true);
 
-  F->flush_timeout = timeout ? event_base->time.sec_monotonic + timeout : 0;
   F->flush_handler = callback;
   F->flush_data = cbdata;
-}
-
-/*
- * comm_checktimeouts() - check the socket timeouts
- *
- * All this routine does is call the given callback/cbdata, without closing
- * down the file descriptor. When close handlers have been implemented,
- * this will happen.
- */
-void
-comm_checktimeouts(void *unused)
-{
-  for (int fd = 0; fd <= highest_fd; ++fd)
-  {
-    fde_t *F = &fd_table[fd];
 
-    if (F->flags.open == false)
-      continue;
-
-    /* check flush functions */
-    if (F->flush_timeout && F->flush_timeout < event_base->time.sec_monotonic)
-    {
-      void (*hdl)(fde_t *, void *) = F->flush_handler;
-      void *data = F->flush_data;
-
-      comm_setflush(F, 0, NULL, NULL);
-      hdl(F, data);
-    }
-
-    /* check timeouts */
-    if (F->timeout && F->timeout < event_base->time.sec_monotonic)
-    {
-      /* Call timeout handler */
-      void (*hdl)(fde_t *, void *) = F->timeout_handler;
-      void *data = F->timeout_data;
-
-      comm_settimeout(F, 0, NULL, NULL);
-      hdl(F, data);
-    }
-  }
+  if (timeout)
+    timer_add(&F->flush, timeout * 1000, comm_flush_expired, F);
+  else
+    timer_del(&F->flush);
 }
 
 /*
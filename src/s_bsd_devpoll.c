@@ -79,6 +79,8 @@ devpoll_write_update(int fd, int events)
   pfd.fd = fd;
   pfd.events = events;
 
+  ++ServerStats.is_ctl;
+
   /* Write the thing to our poll fd */
   if (write(devpoll_fd, &pfd, sizeof(pfd)) != sizeof(pfd))
     ilog(LOG_TYPE_IRCD, "devpoll_write_update: dpfd write failed %d: %s",
@@ -116,11 +118,7 @@ comm_setselect(fde_t *F, unsigned int type, void (*handler)(fde_t *, void *),
     (F->write_handler ? POLLOUT : 0);
 
   if (timeout)
-  {
-    F->timeout = event_base->time.sec_monotonic + timeout;
-    F->timeout_handler = handler;
-    F->timeout_data = client_data;
-  }
+    comm_settimeout(F, timeout, handler, client_data);
 
   if (new_events != F->evcache)
   {
@@ -146,7 +144,7 @@ comm_select(void)
   struct dvpoll dopoll;
   void (*hdl)(fde_t *, void *);
 
-  dopoll.dp_timeout = SELECT_DELAY;
+  dopoll.dp_timeout = comm_select_timeout();
   dopoll.dp_nfds = 128;
   dopoll.dp_fds = &pollfds[0];
   num = ioctl(devpoll_fd, DP_POLL, &dopoll);
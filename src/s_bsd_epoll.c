@@ -22,10 +22,18 @@
 /*! \file s_bsd_epoll.c
  * \brief Linux epoll() compatible network routines.
  * \version $Id$
+ *
+ * Descriptors are registered edge-triggered for both directions the first
+ * time a handler is set, and stay registered until all interest is dropped
+ * (which is what fd_close() does).  Handlers therefore no longer cost an
+ * epoll_ctl() each time they are armed or fire; the one requirement is that
+ * a handler is only (re)armed after the descriptor reported EAGAIN for that
+ * direction, which all of our read and write handlers already do.
  */
 
 #include "stdinc.h"
-#if USE_IOPOLL_MECHANISM == __IOPOLL_MECHANISM_EPOLL
+#if USE_IOPOLL_MECHANISM == __IOPOLL_MECHANISM_EPOLL || \
+    USE_IOPOLL_MECHANISM == __IOPOLL_MECHANISM_IOURING
 #include "fdlist.h"
 #include "ircd.h"
 #include "s_bsd.h"
@@ -33,6 +41,13 @@
 #include "memory.h"
 #include <sys/epoll.h>
 
+#if USE_IOPOLL_MECHANISM == __IOPOLL_MECHANISM_IOURING
+/* We're the run-time fallback of s_bsd_iouring.c */
+#define comm_select_init comm_select_init_epoll
+#define comm_setselect comm_setselect_epoll
+#define comm_select comm_select_epoll
+#endif
+
 enum
 {
   INITIAL_NEVENT =   16,
@@ -102,34 +117,39 @@ comm_setselect(fde_t *F, unsigned int type, void (*handler)(fde_t *, void *),
     F->write_data = client_data;
   }
 
-  new_events = (F->read_handler ? EPOLLIN : 0) |
-    (F->write_handler ? EPOLLOUT : 0);
-
   if (timeout)
+    comm_settimeout(F, timeout, handler, client_data);
+
+  /*
+   * Only touch the kernel's interest list when the descriptor is seen for
+   * the first time, or when all interest in it has been dropped.
+   */
+  if (F->evcache == 0)
   {
-    F->timeout = event_base->time.sec_monotonic + timeout;
-    F->timeout_handler = handler;
-    F->timeout_data = client_data;
+    if (F->read_handler == NULL && F->write_handler == NULL)
+      return;
+
+    op = EPOLL_CTL_ADD;
+    new_events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  }
+  else if (handler == NULL && type == (COMM_SELECT_READ | COMM_SELECT_WRITE))
+  {
+    op = EPOLL_CTL_DEL;
+    new_events = 0;
   }
+  else
+    return;
 
-  if (new_events != F->evcache)
+  memset(&ep_event, 0, sizeof(ep_event));
+  ep_event.events = F->evcache = new_events;
+  ep_event.data.ptr = F;
+
+  ++ServerStats.is_ctl;
+
+  if (epoll_ctl(epollop->fd, op, F->fd, &ep_event))
   {
-    if (new_events == 0)
-      op = EPOLL_CTL_DEL;
-    else if (F->evcache == 0)
-      op = EPOLL_CTL_ADD;
-    else
-      op = EPOLL_CTL_MOD;
-
-    memset(&ep_event, 0, sizeof(ep_event));
-    ep_event.events = F->evcache = new_events;
-    ep_event.data.ptr = F;
-
-    if (epoll_ctl(epollop->fd, op, F->fd, &ep_event))
-    {
-      ilog(LOG_TYPE_IRCD, "comm_setselect: epoll_ctl() failed: %s", strerror(errno));
-      abort();
-    }
+    ilog(LOG_TYPE_IRCD, "comm_setselect: epoll_ctl() failed: %s", strerror(errno));
+    abort();
   }
 }
 
@@ -147,7 +167,7 @@ comm_select(void)
   int num;
   void (*hdl)(fde_t *, void *);
 
-  num = epoll_wait(epollop->fd, epollop->events, epollop->nevents, SELECT_DELAY);
+  num = epoll_wait(epollop->fd, epollop->events, epollop->nevents, comm_select_timeout());
   assert(num <= epollop->nevents);
 
   event_time_set();
@@ -166,7 +186,7 @@ comm_select(void)
     if (F->flags.open == false)
       continue;
 
-    if ((epollop->events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+    if ((epollop->events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
     {
       if ((hdl = F->read_handler))
       {
@@ -184,13 +204,8 @@ comm_select(void)
       {
         F->write_handler = NULL;
         hdl(F, F->write_data);
-
-        if (F->flags.open == false)
-          continue;
       }
     }
-
-    comm_setselect(F, 0, NULL, NULL, 0);
   }
 
   if (num == epollop->nevents && epollop->nevents < MAXIMUM_NEVENT)
@@ -0,0 +1,411 @@
+/*
+ *  ircd-hybrid: an advanced, lightweight Internet Relay Chat Daemon (ircd)
+ *
+ *  Copyright (c) 2022 ircd-hybrid development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ *  USA
+ */
+
+/*! \file s_bsd_iouring.c
+ * \brief Linux io_uring compatible network routines.
+ * \version $Id$
+ *
+ * Every descriptor gets one multishot poll request the first time a handler
+ * is set, much like the edge-triggered epoll code does.  Requests are only
+ * queued on the submission ring by comm_setselect(); they are handed to the
+ * kernel together with the wait for completions, so a loop iteration costs
+ * a single io_uring_enter().  Kernels without (a recent enough) io_uring
+ * make us fall back to the epoll code at run time.
+ */
+
+#include "stdinc.h"
+#if USE_IOPOLL_MECHANISM == __IOPOLL_MECHANISM_IOURING
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "fdlist.h"
+#include "ircd.h"
+#include "s_bsd.h"
+#include "log.h"
+#include "memory.h"
+#include "misc.h"
+
+enum
+{
+  URING_SQ_ENTRIES = 4096,
+  URING_CQ_ENTRIES = URING_SQ_ENTRIES * 4
+};
+
+/*
+ * The user_data of a poll request carries the descriptor in the lower and a
+ * generation tag in the upper half, so completions of requests that belong
+ * to a descriptor that since has been closed (and maybe reused) can be told
+ * apart.  Tag 0 is reserved for our own POLL_REMOVE requests.
+ */
+#define URING_DATA(fd, tag) (((uint64_t)(tag) << 32) | (uint32_t)(fd))
+#define URING_DATA_FD(data) ((int)((data) & 0xFFFFFFFF))
+#define URING_DATA_TAG(data) ((int)((data) >> 32))
+
+struct uringop
+{
+  int fd;
+  unsigned int to_submit;  /* entries queued but not handed to the kernel yet */
+  int tag;  /* last generation tag handed out */
+
+  void *sq_ring;
+  size_t sq_ring_size;
+  unsigned int *sq_head;
+  unsigned int *sq_tail;
+  unsigned int sq_mask;
+  unsigned int sq_entries;
+
+  void *cq_ring;
+  size_t cq_ring_size;
+  unsigned int *cq_head;
+  unsigned int *cq_tail;
+  unsigned int cq_mask;
+  struct io_uring_cqe *cqes;
+
+  struct io_uring_sqe *sqes;
+  size_t sqes_size;
+};
+
+static struct uringop *uringop;
+
+
+static int
+uring_enter(unsigned int to_submit, unsigned int min_complete, unsigned int flags,
+            struct __kernel_timespec *ts)
+{
+  struct io_uring_getevents_arg arg = { .ts = (uintptr_t)ts };
+
+  if (ts)
+    return syscall(__NR_io_uring_enter, uringop->fd, to_submit, min_complete,
+                   flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+  return syscall(__NR_io_uring_enter, uringop->fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+/*
+ * uring_submit
+ *
+ * Hands all queued submission entries to the kernel without waiting
+ * for any completions.
+ */
+static void
+uring_submit(void)
+{
+  while (uringop->to_submit)
+  {
+    int ret = uring_enter(uringop->to_submit, 0, 0, NULL);
+
+    if (ret < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      ilog(LOG_TYPE_IRCD, "uring_submit: io_uring_enter() failed: %s", strerror(errno));
+      abort();
+    }
+
+    uringop->to_submit -= ret;
+  }
+}
+
+static struct io_uring_sqe *
+uring_get_sqe(void)
+{
+  unsigned int tail = *uringop->sq_tail;
+
+  if (tail - __atomic_load_n(uringop->sq_head, __ATOMIC_ACQUIRE) == uringop->sq_entries)
+    uring_submit();  /* Ring is full; make room */
+
+  struct io_uring_sqe *sqe = &uringop->sqes[tail & uringop->sq_mask];
+  memset(sqe, 0, sizeof(*sqe));
+
+  __atomic_store_n(uringop->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ++uringop->to_submit;
+  ++ServerStats.is_ctl;
+
+  return sqe;
+}
+
+static void
+uring_poll_add(fde_t *F)
+{
+  uint32_t events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+
+  if (++uringop->tag == INT_MAX)
+    uringop->tag = 1;
+  F->comm_index = uringop->tag;
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+  events = (events << 16) | (events >> 16);
+#endif
+
+  struct io_uring_sqe *sqe = uring_get_sqe();
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = F->fd;
+  sqe->poll32_events = events;
+  sqe->len = IORING_POLL_ADD_MULTI;
+  sqe->user_data = URING_DATA(F->fd, F->comm_index);
+}
+
+static void
+uring_poll_remove(fde_t *F)
+{
+  struct io_uring_sqe *sqe = uring_get_sqe();
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = URING_DATA(F->fd, F->comm_index);
+  sqe->user_data = URING_DATA(F->fd, 0);
+
+  /* The cancelled request completes with -ECANCELED; make it look stale */
+  F->comm_index = 0;
+}
+
+/*
+ * comm_select_init
+ *
+ * This is a needed exported function which will be called to initialise
+ * the network loop code.
+ */
+void
+comm_select_init(void)
+{
+  struct io_uring_params p = { .flags = IORING_SETUP_CQSIZE, .cq_entries = URING_CQ_ENTRIES };
+
+  int fd = syscall(__NR_io_uring_setup, URING_SQ_ENTRIES, &p);
+  if (fd < 0)
+  {
+    ilog(LOG_TYPE_IRCD, "comm_select_init: couldn't set up io_uring (%s), using epoll",
+         strerror(errno));
+    comm_select_init_epoll();
+    return;
+  }
+
+  /*
+   * IORING_FEAT_RSRC_TAGS came with the same kernel release (5.13)
+   * that introduced multishot poll requests, which we depend on.
+   */
+  if (!(p.features & IORING_FEAT_NODROP) ||
+      !(p.features & IORING_FEAT_EXT_ARG) ||
+      !(p.features & IORING_FEAT_RSRC_TAGS))
+  {
+    ilog(LOG_TYPE_IRCD, "comm_select_init: io_uring is too old on this kernel, using epoll");
+    close(fd);
+    comm_select_init_epoll();
+    return;
+  }
+
+  fd_open(fd, false, "io_uring file descriptor");
+
+  uringop = xcalloc(sizeof(*uringop));
+  uringop->fd = fd;
+
+  uringop->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+  uringop->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  uringop->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+  if ((p.features & IORING_FEAT_SINGLE_MMAP))
+    uringop->sq_ring_size = uringop->cq_ring_size =
+      IRCD_MAX(uringop->sq_ring_size, uringop->cq_ring_size);
+
+  uringop->sq_ring = mmap(NULL, uringop->sq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if ((p.features & IORING_FEAT_SINGLE_MMAP))
+    uringop->cq_ring = uringop->sq_ring;
+  else
+    uringop->cq_ring = mmap(NULL, uringop->cq_ring_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  uringop->sqes = mmap(NULL, uringop->sqes_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+  if (uringop->sq_ring == MAP_FAILED || uringop->cq_ring == MAP_FAILED || uringop->sqes == MAP_FAILED)
+  {
+    ilog(LOG_TYPE_IRCD, "comm_select_init: couldn't map io_uring rings: %s",
+         strerror(errno));
+    exit(EXIT_FAILURE); /* Whee! */
+  }
+
+  char *sq = uringop->sq_ring;
+  uringop->sq_head = (unsigned int *)(sq + p.sq_off.head);
+  uringop->sq_tail = (unsigned int *)(sq + p.sq_off.tail);
+  uringop->sq_mask = *(unsigned int *)(sq + p.sq_off.ring_mask);
+  uringop->sq_entries = *(unsigned int *)(sq + p.sq_off.ring_entries);
+
+  /* Submission entries are always used in ring order */
+  unsigned int *array = (unsigned int *)(sq + p.sq_off.array);
+  for (unsigned int i = 0; i < uringop->sq_entries; ++i)
+    array[i] = i;
+
+  char *cq = uringop->cq_ring;
+  uringop->cq_head = (unsigned int *)(cq + p.cq_off.head);
+  uringop->cq_tail = (unsigned int *)(cq + p.cq_off.tail);
+  uringop->cq_mask = *(unsigned int *)(cq + p.cq_off.ring_mask);
+  uringop->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+}
+
+/*
+ * comm_setselect
+ *
+ * This is a needed exported function which will be called to register
+ * and deregister interest in a pending IO state for a given FD.
+ */
+void
+comm_setselect(fde_t *F, unsigned int type, void (*handler)(fde_t *, void *),
+               void *client_data, uintmax_t timeout)
+{
+  if (uringop == NULL)
+  {
+    comm_setselect_epoll(F, type, handler, client_data, timeout);
+    return;
+  }
+
+  assert(F);
+  assert(F->flags.open == true);
+
+  if ((type & COMM_SELECT_READ))
+  {
+    F->read_handler = handler;
+    F->read_data = client_data;
+  }
+
+  if ((type & COMM_SELECT_WRITE))
+  {
+    F->write_handler = handler;
+    F->write_data = client_data;
+  }
+
+  if (timeout)
+    comm_settimeout(F, timeout, handler, client_data);
+
+  if (F->evcache == 0)
+  {
+    if (F->read_handler == NULL && F->write_handler == NULL)
+      return;
+
+    F->evcache = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+    uring_poll_add(F);
+  }
+  else if (handler == NULL && type == (COMM_SELECT_READ | COMM_SELECT_WRITE))
+  {
+    F->evcache = 0;
+    uring_poll_remove(F);
+
+    /* A pending poll request pins the file; let go of it before close() */
+    uring_submit();
+  }
+}
+
+/*
+ * comm_select
+ *
+ * Called to do the new-style IO, courtesy of squid (like most of this
+ * new IO code). This routine handles the stuff we've hidden in
+ * comm_setselect and fd_table[] and calls callbacks for IO ready
+ * events.
+ */
+void
+comm_select(void)
+{
+  const int timeout = comm_select_timeout();
+  struct __kernel_timespec ts = { .tv_sec = timeout / 1000,
+                                  .tv_nsec = (timeout % 1000) * 1000000 };
+  void (*hdl)(fde_t *, void *);
+  int ret;
+
+  if (uringop == NULL)
+  {
+    comm_select_epoll();
+    return;
+  }
+
+  /* Submit whatever is queued, and wait for completions, in one go */
+  ret = uring_enter(uringop->to_submit, 1, IORING_ENTER_GETEVENTS, &ts);
+
+  event_time_set();
+
+  if (ret < 0)
+  {
+    if (errno != ETIME && errno != EINTR)
+    {
+      const struct timespec req = { .tv_sec = 0, .tv_nsec = 50000000 };
+      nanosleep(&req, NULL);  /* Avoid 99% CPU in comm_select */
+      return;
+    }
+  }
+  else
+    uringop->to_submit -= ret;
+
+  unsigned int head = *uringop->cq_head;
+  const unsigned int tail = __atomic_load_n(uringop->cq_tail, __ATOMIC_ACQUIRE);
+
+  for (; head != tail; ++head)
+  {
+    const struct io_uring_cqe *cqe = &uringop->cqes[head & uringop->cq_mask];
+    const uint64_t data = cqe->user_data;
+    const unsigned int flags = cqe->flags;
+    const int res = cqe->res;
+
+    __atomic_store_n(uringop->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    if (URING_DATA_TAG(data) == 0)
+      continue;  /* Completion of a POLL_REMOVE */
+
+    fde_t *F = &fd_table[URING_DATA_FD(data)];
+
+    if (F->flags.open == false || F->comm_index != URING_DATA_TAG(data))
+      continue;  /* Stale; the descriptor has been closed or its poll removed meanwhile */
+
+    if (res < 0)
+    {
+      ilog(LOG_TYPE_IRCD, "comm_select: poll request for fd %d failed: %s",
+           F->fd, strerror(-res));
+      F->evcache = 0;
+      continue;
+    }
+
+    /*
+     * The kernel may end a multishot request at any time, e.g. if the
+     * completion ring overflowed. Arm a new one in that case.
+     */
+    if (!(flags & IORING_CQE_F_MORE))
+      uring_poll_add(F);
+
+    if ((res & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+    {
+      if ((hdl = F->read_handler))
+      {
+        F->read_handler = NULL;
+        hdl(F, F->read_data);
+
+        if (F->flags.open == false)
+          continue;
+      }
+    }
+
+    if ((res & (EPOLLOUT | EPOLLHUP | EPOLLERR)))
+    {
+      if ((hdl = F->write_handler))
+      {
+        F->write_handler = NULL;
+        hdl(F, F->write_data);
+      }
+    }
+  }
+}
+#endif
@@ -68,6 +68,7 @@ kq_update_events(fde_t *F, int filter, int what)
   struct kevent *kep = kq_fdlist + kqoff;
 
   EV_SET(kep, (uintptr_t) F->fd, (short) filter, what, 0, 0, F);
+  ++ServerStats.is_ctl;
 
   if (++kqoff == KE_LENGTH)
   {
@@ -110,11 +111,7 @@ comm_setselect(fde_t *F, unsigned int type, void (*handler)(fde_t *, void *),
                (F->write_handler ? COMM_SELECT_WRITE : 0);
 
   if (timeout)
-  {
-    F->timeout = event_base->time.sec_monotonic + timeout;
-    F->timeout_handler = handler;
-    F->timeout_data = client_data;
-  }
+    comm_settimeout(F, timeout, handler, client_data);
 
   diff = new_events ^ F->evcache;
 
@@ -147,8 +144,10 @@ comm_select(void)
    * why jlemon used a timespec, but hey, he wrote the interface, not I
    *   -- Adrian
    */
-  poll_time.tv_sec = 0;
-  poll_time.tv_nsec = SELECT_DELAY * 1000000;
+  const int timeout = comm_select_timeout();
+
+  poll_time.tv_sec = timeout / 1000;
+  poll_time.tv_nsec = (timeout % 1000) * 1000000;
   num = kevent(kqueue_fd, kq_fdlist, kqoff, ke, KE_LENGTH, &poll_time);
   kqoff = 0;
 
@@ -91,11 +91,7 @@ comm_setselect(fde_t *F, unsigned int type, void (*handler)(fde_t *, void *),
                (F->write_handler ? POLLWRNORM : 0);
 
   if (timeout)
-  {
-    F->timeout = event_base->time.sec_monotonic + timeout;
-    F->timeout_handler = handler;
-    F->timeout_data = client_data;
-  }
+    comm_settimeout(F, timeout, handler, client_data);
 
   if (new_events != F->evcache)
   {
@@ -152,7 +148,7 @@ comm_select(void)
   int num;
   void (*hdl)(fde_t *, void *);
 
-  num = poll(pollfds, pollnum, SELECT_DELAY);
+  num = poll(pollfds, pollnum, comm_select_timeout());
 
   event_time_set();
 
@@ -0,0 +1,401 @@
+/*
+ *  ircd-hybrid: an advanced, lightweight Internet Relay Chat Daemon (ircd)
+ *
+ *  Copyright (c) 1997-2022 ircd-hybrid development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ *  USA
+ */
+
+/*! \file scan.c
+ * \brief Byte scanning kernels with vectorized implementations.
+ * \version $Id$
+ *
+ * Every kernel has a portable scalar implementation. On x86 the SSSE3
+ * and AVX2 variants are compiled in as well and the best one the CPU
+ * supports is picked by scan_init().
+ *
+ * The vectorized set membership test splits each byte into its nibbles.
+ * A shuffle indexed by the low nibble fetches a mask with one bit for
+ * every high nibble that completes a member of the set, and a second
+ * shuffle turns the high nibble into that bit. Separate low nibble tables
+ * are kept for bytes below and above 0x80, which lets arbitrary sets be
+ * represented exactly: pshufb yields zero for any index with the top bit
+ * set, so each table only ever answers for its own half.
+ */
+
+#include "stdinc.h"
+#include "irc_string.h"
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+struct scan_set scan_set_eol;
+struct scan_set scan_set_token;
+struct scan_set scan_set_nick;
+struct scan_set scan_set_user;
+struct scan_set scan_set_ident;
+struct scan_set scan_set_ident_special;
+
+struct scan_kernel
+{
+  const char *name;
+  const char *(*find)(const char *, size_t, const struct scan_set *);
+  size_t (*span)(const char *, size_t, const struct scan_set *);
+  const char *(*find_ctrl)(const char *, size_t);
+  bool (*supported)(void);
+};
+
+
+/*! \brief Adds a byte to a set
+ * \param set Pointer to the set to modify
+ * \param c   Byte to add
+ */
+void
+scan_set_add(struct scan_set *set, unsigned char c)
+{
+  set->map[c] = 1;
+
+  if (c < 0x80)
+    set->low_ascii[c & 0x0f] |= 1 << (c >> 4);
+  else
+    set->low_high[c & 0x0f] |= 1 << ((c >> 4) & 0x07);
+}
+
+/*! \brief Adds every byte with any of the given CharAttrs bits to a set
+ * \param set   Pointer to the set to modify
+ * \param attrs Mask of *_C character attributes
+ */
+void
+scan_set_add_attr(struct scan_set *set, unsigned int attrs)
+{
+  for (unsigned int c = 0; c < 256; ++c)
+    if (CharAttrs[c] & attrs)
+      scan_set_add(set, c);
+}
+
+static const char *
+scan_find_generic(const char *s, size_t len, const struct scan_set *set)
+{
+  for (size_t i = 0; i < len; ++i)
+    if (set->map[(unsigned char)s[i]])
+      return s + i;
+
+  return NULL;
+}
+
+static size_t
+scan_span_generic(const char *s, size_t len, const struct scan_set *set)
+{
+  size_t i = 0;
+
+  while (i < len && set->map[(unsigned char)s[i]])
+    ++i;
+
+  return i;
+}
+
+static const char *
+scan_find_ctrl_generic(const char *s, size_t len)
+{
+  for (size_t i = 0; i < len; ++i)
+    if ((unsigned char)s[i] < 0x20)
+      return s + i;
+
+  return NULL;
+}
+
+static bool
+scan_supported_generic(void)
+{
+  return true;
+}
+
+#ifdef SCAN_X86
+/*
+ * The SSSE3 and SSE2 loops also finish off what is left over by the AVX2
+ * ones. They are always inlined, so that they get VEX encoded there; calling
+ * into legacy SSE code with the upper halves of the ymm registers dirty
+ * costs more than the whole scan.
+ */
+
+/*
+ * Returns a 16 bit mask with a bit set for every byte in the vector that is
+ * *not* a member of the set.
+ */
+__attribute__((target("ssse3")))
+static inline unsigned int
+scan_classify_ssse3(__m128i v, __m128i low_ascii, __m128i low_high, __m128i high_bit)
+{
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  const __m128i high = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+  const __m128i low = _mm_or_si128(_mm_shuffle_epi8(low_ascii, v),
+                                   _mm_shuffle_epi8(low_high, _mm_xor_si128(v, _mm_set1_epi8((char)0x80))));
+  const __m128i hit = _mm_and_si128(low, _mm_shuffle_epi8(high_bit, high));
+
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(hit, _mm_setzero_si128()));
+}
+
+__attribute__((target("ssse3"), always_inline))
+static inline size_t
+scan_ssse3(const char *s, size_t len, const struct scan_set *set, bool span)
+{
+  const __m128i low_ascii = _mm_loadu_si128((const __m128i *)set->low_ascii);
+  const __m128i low_high = _mm_loadu_si128((const __m128i *)set->low_high);
+  const __m128i high_bit = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+  size_t i = 0;
+
+  for (; i + 16 <= len; i += 16)
+  {
+    unsigned int mask = scan_classify_ssse3(_mm_loadu_si128((const __m128i *)(s + i)),
+                                            low_ascii, low_high, high_bit);
+    if (span == false)
+      mask ^= 0xffff;
+
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+
+  for (; i < len; ++i)
+    if ((set->map[(unsigned char)s[i]] != 0) != span)
+      break;
+
+  return i;
+}
+
+__attribute__((target("ssse3")))
+static const char *
+scan_find_ssse3(const char *s, size_t len, const struct scan_set *set)
+{
+  const size_t i = scan_ssse3(s, len, set, false);
+  return i < len ? s + i : NULL;
+}
+
+__attribute__((target("ssse3")))
+static size_t
+scan_span_ssse3(const char *s, size_t len, const struct scan_set *set)
+{
+  return scan_ssse3(s, len, set, true);
+}
+
+__attribute__((target("sse2"), always_inline))
+static inline const char *
+scan_find_ctrl_sse2(const char *s, size_t len)
+{
+  const __m128i limit = _mm_set1_epi8(0x1f);
+  size_t i = 0;
+
+  for (; i + 16 <= len; i += 16)
+  {
+    const __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    const unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, limit), v));
+
+    if (mask)
+      return s + i + __builtin_ctz(mask);
+  }
+
+  return scan_find_ctrl_generic(s + i, len - i);
+}
+
+static bool
+scan_supported_ssse3(void)
+{
+  return __builtin_cpu_supports("ssse3");
+}
+
+__attribute__((target("avx2")))
+static size_t
+scan_avx2(const char *s, size_t len, const struct scan_set *set, bool span)
+{
+  if (len < 32)
+    return scan_ssse3(s, len, set, span);
+
+  const __m256i low_ascii = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)set->low_ascii));
+  const __m256i low_high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)set->low_high));
+  const __m256i high_bit = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                            1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  const __m256i top = _mm256_set1_epi8((char)0x80);
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32)
+  {
+    const __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+    const __m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+    const __m256i low = _mm256_or_si256(_mm256_shuffle_epi8(low_ascii, v),
+                                        _mm256_shuffle_epi8(low_high, _mm256_xor_si256(v, top)));
+    const __m256i hit = _mm256_and_si256(low, _mm256_shuffle_epi8(high_bit, high));
+    uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(hit, _mm256_setzero_si256()));
+
+    if (span == false)
+      mask = ~mask;
+
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+
+  return i + scan_ssse3(s + i, len - i, set, span);
+}
+
+static const char *
+scan_find_avx2(const char *s, size_t len, const struct scan_set *set)
+{
+  const size_t i = scan_avx2(s, len, set, false);
+  return i < len ? s + i : NULL;
+}
+
+static size_t
+scan_span_avx2(const char *s, size_t len, const struct scan_set *set)
+{
+  return scan_avx2(s, len, set, true);
+}
+
+__attribute__((target("avx2")))
+static const char *
+scan_find_ctrl_avx2(const char *s, size_t len)
+{
+  const __m256i limit = _mm256_set1_epi8(0x1f);
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32)
+  {
+    const __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+    const uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(v, limit), v));
+
+    if (mask)
+      return s + i + __builtin_ctz(mask);
+  }
+
+  return scan_find_ctrl_sse2(s + i, len - i);
+}
+
+static bool
+scan_supported_avx2(void)
+{
+  return __builtin_cpu_supports("avx2");
+}
+#endif  /* SCAN_X86 */
+
+/* Ordered by preference */
+static const struct scan_kernel scan_kernel_tab[] =
+{
+#ifdef SCAN_X86
+  { "avx2", scan_find_avx2, scan_span_avx2, scan_find_ctrl_avx2, scan_supported_avx2 },
+  { "ssse3", scan_find_ssse3, scan_span_ssse3, scan_find_ctrl_sse2, scan_supported_ssse3 },
+#endif
+  { "generic", scan_find_generic, scan_span_generic, scan_find_ctrl_generic, scan_supported_generic },
+  { NULL, NULL, NULL, NULL, NULL }
+};
+
+static const struct scan_kernel *scan_kernel = &scan_kernel_tab[sizeof(scan_kernel_tab) / sizeof(scan_kernel_tab[0]) - 2];
+
+
+/*! \brief Finds the first byte of a buffer that is a member of a set
+ * \param s   Buffer to scan
+ * \param len Number of bytes in the buffer
+ * \param set Pointer to the set to look for
+ * \return Pointer to the first matching byte, or NULL if there is none
+ */
+const char *
+scan_find(const char *s, size_t len, const struct scan_set *set)
+{
+  return scan_kernel->find(s, len, set);
+}
+
+/*! \brief Computes the length of the leading run of bytes that are members of a set
+ * \param s   Buffer to scan
+ * \param len Number of bytes in the buffer
+ * \param set Pointer to the set of accepted bytes
+ * \return Number of leading bytes in the set; equals len if all of them are
+ */
+size_t
+scan_span(const char *s, size_t len, const struct scan_set *set)
+{
+  return scan_kernel->span(s, len, set);
+}
+
+/*! \brief Finds the first control byte (0x00-0x1f) of a buffer
+ * \param s   Buffer to scan
+ * \param len Number of bytes in the buffer
+ * \return Pointer to the first control byte, or NULL if there is none
+ */
+const char *
+scan_find_ctrl(const char *s, size_t len)
+{
+  return scan_kernel->find_ctrl(s, len);
+}
+
+/*! \brief Returns the name of the kernel implementation in use */
+const char *
+scan_get_kernel(void)
+{
+  return scan_kernel->name;
+}
+
+/*! \brief Selects a kernel implementation by name
+ * \param name Name of the implementation, e.g. "generic"
+ * \return true if the implementation exists and is supported by the CPU
+ */
+bool
+scan_set_kernel(const char *name)
+{
+  for (const struct scan_kernel *tab = scan_kernel_tab; tab->name; ++tab)
+  {
+    if (strcmp(tab->name, name) == 0 && tab->supported())
+    {
+      scan_kernel = tab;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void
+scan_init(void)
+{
+#ifdef SCAN_X86
+  __builtin_cpu_init();
+#endif
+
+  for (const struct scan_kernel *tab = scan_kernel_tab; tab->name; ++tab)
+  {
+    if (tab->supported())
+    {
+      scan_kernel = tab;
+      break;
+    }
+  }
+
+  scan_set_add_attr(&scan_set_eol, EOL_C);
+
+  scan_set_add(&scan_set_token, ' ');
+  scan_set_add(&scan_set_token, '\0');
+
+  scan_set_add_attr(&scan_set_nick, NICK_C);
+  scan_set_add_attr(&scan_set_user, USER_C);
+
+  scan_set_add_attr(&scan_set_ident, USER2_C);
+  scan_set_add(&scan_set_ident, '-');
+  scan_set_add(&scan_set_ident, '_');
+  scan_set_add(&scan_set_ident, '.');
+
+  scan_set_add(&scan_set_ident_special, '-');
+  scan_set_add(&scan_set_ident_special, '_');
+  scan_set_add(&scan_set_ident_special, '.');
+}
@@ -37,21 +37,36 @@
 #include "conf_class.h"
 #include "log.h"
 
+#include <sys/uio.h>
+
+#if defined(IOV_MAX)
+#define SEND_IOV_MAX IOV_MAX
+#elif defined(UIO_MAXIOV)
+#define SEND_IOV_MAX UIO_MAXIOV
+#else
+#define SEND_IOV_MAX 16  /* _XOPEN_IOV_MAX */
+#endif
+
+#define SEND_FLUSH_SIZE 16384  /* Queued bytes past which a connection is written to right away */
+
 
 static uintmax_t current_serial;
+static dlink_list flush_list;  /* Connections with data queued since the last send_queued_all() */
 
 
-/* send_format()
+/* send_format_at()
  *
  * inputs
  *		- buffer
+ *		- offset into buffer at which the message starts
  *		- format pattern to use
  *		- var args
- * output	- number of bytes formatted output
- * side effects	- modifies sendbuf
+ * output	- none
+ * side effects	- appends the formatted and CR-LF terminated message
+ *		  to buffer
  */
 static void
-send_format(struct dbuf_block *buffer, const char *pattern, va_list args)
+send_format_at(struct dbuf_block *buffer, size_t start, const char *pattern, va_list args)
 {
   /*
    * from rfc1459
@@ -67,13 +82,87 @@ send_format(struct dbuf_block *buffer, const char *pattern, va_list args)
    */
   dbuf_put_args(buffer, pattern, args);
 
-  if (buffer->size > IRCD_BUFSIZE - 2)
-    buffer->size = IRCD_BUFSIZE - 2;
+  if (buffer->size - start > IRCD_BUFSIZE - 2)
+    buffer->size = start + IRCD_BUFSIZE - 2;
 
   buffer->data[buffer->size++] = '\r';
   buffer->data[buffer->size++] = '\n';
 }
 
+static void
+send_format(struct dbuf_block *buffer, const char *pattern, va_list args)
+{
+  send_format_at(buffer, 0, pattern, args);
+}
+
+/*
+ ** send_sendq_exceeded
+ **      Checks whether queueing another 'size' bytes would exceed the
+ **      connection's sendq limit, and if so, drops the connection.
+ */
+static bool
+send_sendq_exceeded(struct Client *to, size_t size)
+{
+  if (dbuf_length(&to->connection->buf_sendq) + size <= get_sendq(&to->connection->confs))
+    return false;
+
+  if (IsServer(to))
+    sendto_realops_flags(UMODE_SERVNOTICE, L_ALL, SEND_NOTICE,
+                         "Max SendQ limit exceeded for %s: %zu > %u",
+                         client_get_name(to, HIDE_IP),
+                         (dbuf_length(&to->connection->buf_sendq) + size),
+                         get_sendq(&to->connection->confs));
+
+  if (IsClient(to))
+    AddFlag(to, FLAGS_SENDQEX);
+
+  dead_link_on_write(to, 0);
+  return true;
+}
+
+/*
+ ** send_message_queued
+ **      Accounts for a message that has been appended to the sendq
+ **      and schedules the connection for the next flush, or writes
+ **      the sendq out right away once enough has piled up.
+ */
+static void
+send_message_queued(struct Client *to)
+{
+  /*
+   * Update statistics. The following is slightly incorrect because
+   * it counts messages even if queued, but bytes only really sent.
+   * Queued bytes get updated in send_queued_write().
+   */
+  ++to->connection->send.messages;
+  ++me.connection->send.messages;
+
+  /*
+   * Once a burst or a long reply has piled up, write it out instead of
+   * letting it run into the sendq limit before the socket ever had a
+   * chance to take any of it.
+   */
+  unsigned int threshold = get_sendq(&to->connection->confs) / 2;
+  if (threshold > SEND_FLUSH_SIZE)
+    threshold = SEND_FLUSH_SIZE;
+
+  if (dbuf_length(&to->connection->buf_sendq) >= threshold)
+  {
+    send_queued_write(to);
+    return;
+  }
+
+  /*
+   * Don't write now. Everything queued up for this connection until the
+   * next send_queued_all() goes out with as few send() calls as possible.
+   */
+  if (!HasFlag(to, FLAGS_FLUSH))
+  {
+    AddFlag(to, FLAGS_FLUSH);
+    dlinkAddTail(to, &to->connection->flush_node, &flush_list);
+  }
+}
+
 /*
  ** send_message
  **      Internal utility which appends given buffer to the sockets
@@ -86,33 +175,50 @@ send_message(struct Client *to, struct dbuf_block *buffer)
   assert(to != &me);
   assert(MyConnect(to));
 
-  if (dbuf_length(&to->connection->buf_sendq) + buffer->size > get_sendq(&to->connection->confs))
-  {
-    if (IsServer(to))
-      sendto_realops_flags(UMODE_SERVNOTICE, L_ALL, SEND_NOTICE,
-                           "Max SendQ limit exceeded for %s: %zu > %u",
-                           client_get_name(to, HIDE_IP),
-                           (dbuf_length(&to->connection->buf_sendq) + buffer->size),
-                           get_sendq(&to->connection->confs));
-
-    if (IsClient(to))
-      AddFlag(to, FLAGS_SENDQEX);
-
-    dead_link_on_write(to, 0);
+  if (send_sendq_exceeded(to, buffer->size))
     return;
-  }
 
   dbuf_add(&to->connection->buf_sendq, buffer);
+  send_message_queued(to);
+}
 
-  /*
-   * Update statistics. The following is slightly incorrect because
-   * it counts messages even if queued, but bytes only really sent.
-   * Queued bytes get updated in send_queued_write().
-   */
-  ++to->connection->send.messages;
-  ++me.connection->send.messages;
+/*
+ ** send_unicast_begin
+ **      Returns the block at the end of the sendq that a message for a
+ **      single recipient is to be formatted into. Its current size is
+ **      stored in 'start'.
+ */
+static struct dbuf_block *
+send_unicast_begin(struct Client *to, size_t *start)
+{
+  assert(!IsMe(to));
+  assert(to != &me);
+  assert(MyConnect(to));
+
+  struct dbuf_block *block = dbuf_tail(&to->connection->buf_sendq, IRCD_BUFSIZE);
+  *start = block->size;
+
+  return block;
+}
 
-  send_queued_write(to);
+/*
+ ** send_unicast_end
+ **      Makes the message formatted into 'block' at offset 'start'
+ **      part of the sendq, or discards it if the sendq is full.
+ */
+static void
+send_unicast_end(struct Client *to, struct dbuf_block *block, size_t start)
+{
+  size_t size = block->size - start;
+
+  block->size = start;
+
+  if (send_sendq_exceeded(to, size))
+    return;
+
+  block->size += size;
+  dbuf_commit(&to->connection->buf_sendq, size);
+  send_message_queued(to);
 }
 
 /* send_message_remote()
@@ -169,6 +275,12 @@ send_queued_write(struct Client *to)
 {
   ssize_t retlen;
 
+  if (HasFlag(to, FLAGS_FLUSH))
+  {
+    DelFlag(to, FLAGS_FLUSH);
+    dlinkDelete(&to->connection->flush_node, &flush_list);
+  }
+
   /*
    * Once socket is marked dead, we cannot start writing to it,
    * even if the error is removed...
@@ -180,7 +292,7 @@ send_queued_write(struct Client *to)
   while (dbuf_length(&to->connection->buf_sendq))
   {
     bool want_read = false;
-    const struct dbuf_block *first = to->connection->buf_sendq.blocks.head->data;
+    const struct dbuf_block *first = dbuf_nth(&to->connection->buf_sendq, 0);
 
     if (tls_isusing(&to->connection->fd->tls))
     {
@@ -191,8 +303,11 @@ send_queued_write(struct Client *to)
         return;  /* Retry later, don't register for write events */
     }
     else
-      retlen = send(to->connection->fd->fd, first->data + to->connection->buf_sendq.pos,
-                                            first->size - to->connection->buf_sendq.pos, 0);
+    {
+      /* Hand as much of the queue as we can to the kernel in one go */
+      struct iovec iov[SEND_IOV_MAX];
+      retlen = writev(to->connection->fd->fd, iov, dbuf_map(&to->connection->buf_sendq, iov, SEND_IOV_MAX));
+    }
 
     if (retlen <= 0)
     {
@@ -215,6 +330,19 @@ send_queued_write(struct Client *to)
   }
 }
 
+/*
+ ** send_queued_all
+ **      Writes out the send queues of all connections which have had
+ **      data queued since the last call. Called once per I/O loop
+ **      iteration.
+ */
+void
+send_queued_all(void)
+{
+  while (flush_list.head)
+    send_queued_write(flush_list.head->data);
+}
+
 /* sendto_one()
  *
  * inputs	- pointer to destination client
@@ -230,16 +358,14 @@ sendto_one(struct Client *to, const char *pattern, ...)
   if (IsDead(to->from))
     return;  /* This socket has already been marked as dead */
 
-  va_start(args, pattern);
-
-  struct dbuf_block *buffer = dbuf_alloc();
-  send_format(buffer, pattern, args);
+  size_t start;
+  struct dbuf_block *buffer = send_unicast_begin(to->from, &start);
 
+  va_start(args, pattern);
+  send_format_at(buffer, start, pattern, args);
   va_end(args);
 
-  send_message(to->from, buffer);
-
-  dbuf_ref_free(buffer);
+  send_unicast_end(to->from, buffer, start);
 }
 
 void
@@ -254,7 +380,8 @@ sendto_one_numeric(struct Client *to, const struct Client *from, enum irc_numeri
   if (EmptyString(dest))
     dest = "*";
 
-  struct dbuf_block *buffer = dbuf_alloc();
+  size_t start;
+  struct dbuf_block *buffer = send_unicast_begin(to->from, &start);
   dbuf_put_fmt(buffer, ":%s %03d %s ", ID_or_name(from, to), numeric & ~SND_EXPLICIT, dest);
 
   va_start(args, numeric);
@@ -265,12 +392,10 @@ sendto_one_numeric(struct Client *to, const struct Client *from, enum irc_numeri
   else
     numstr = numeric_form(numeric);
 
-  send_format(buffer, numstr, args);
+  send_format_at(buffer, start, numstr, args);
   va_end(args);
 
-  send_message(to->from, buffer);
-
-  dbuf_ref_free(buffer);
+  send_unicast_end(to->from, buffer, start);
 }
 
 void
@@ -285,16 +410,15 @@ sendto_one_notice(struct Client *to, const struct Client *from, const char *patt
   if (EmptyString(dest))
     dest = "*";
 
-  struct dbuf_block *buffer = dbuf_alloc();
+  size_t start;
+  struct dbuf_block *buffer = send_unicast_begin(to->from, &start);
   dbuf_put_fmt(buffer, ":%s NOTICE %s ", ID_or_name(from, to), dest);
 
   va_start(args, pattern);
-  send_format(buffer, pattern, args);
+  send_format_at(buffer, start, pattern, args);
   va_end(args);
 
-  send_message(to->from, buffer);
-
-  dbuf_ref_free(buffer);
+  send_unicast_end(to->from, buffer, start);
 }
 
 /* sendto_channel_butone()
@@ -538,21 +662,39 @@ sendto_channel_local(const struct Client *one, struct Channel *channel, unsigned
  **
  */
 
+/*! \brief The last string match_it() matched and the result */
+struct match_it_cache
+{
+  const char *value;
+  bool result;
+};
+
 /* match_it()
  *
  * inputs	- client pointer to match on
  *		- actual mask to match
  *		- what to match on, HOST or SERVER
+ *		- result of the previous call
  * output	- 1 or 0 if match or not
- * side effects	- NONE
+ * side effects	- cache is updated
+ *
+ * Hosts are interned and all local clients share one server name, so
+ * clients in a row often carry the very same string; the previous
+ * result is reused for those instead of calling match() again.
  */
 static bool
-match_it(const struct Client *one, const char *mask, unsigned int what)
+match_it(const struct Client *one, const char *mask, unsigned int what,
+         struct match_it_cache *cache)
 {
-  if (what == MATCH_HOST)
-    return match(mask, one->host) == 0;
+  const char *const value = what == MATCH_HOST ? one->host : one->servptr->name;
+
+  if (cache->value != value)
+  {
+    cache->value = value;
+    cache->result = match(mask, value) == 0;
+  }
 
-  return match(mask, one->servptr->name) == 0;
+  return cache->result;
 }
 
 /* sendto_match_butone()
@@ -570,6 +712,7 @@ sendto_match_butone(const struct Client *one, const struct Client *from,
   dlink_node *node;
   struct dbuf_block *buffer_l = dbuf_alloc();
   struct dbuf_block *buffer_r = dbuf_alloc();
+  struct match_it_cache cache = { .value = NULL };
 
   dbuf_put_fmt(buffer_l, ":%s!%s@%s ", from->name, from->username, from->host);
   dbuf_put_fmt(buffer_r, ":%s ", from->id);
@@ -592,7 +735,7 @@ sendto_match_butone(const struct Client *one, const struct Client *from,
     if (one && (client == one->from))
       continue;
 
-    if (match_it(client, mask, what) == false)
+    if (match_it(client, mask, what, &cache) == false)
       continue;
 
     send_message(client, buffer_l);
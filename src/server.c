@@ -27,6 +27,7 @@
 #include "stdinc.h"
 #include "list.h"
 #include "client.h"
+#include "intern.h"
 #include "event.h"
 #include "hash.h"
 #include "irc_string.h"
@@ -422,11 +423,11 @@ server_connect(struct MaskItem *conf, struct Client *by)
   struct Client *client = client_make(NULL);
 
   /* Copy in the server, hostname, fd */
-  strlcpy(client->name, conf->name, sizeof(client->name));
-  strlcpy(client->host, conf->host, sizeof(client->host));
+  client_set_name(client, conf->name);
+  intern_set(&client->host, conf->host, HOSTLEN);
 
   /* We already converted the ip once, so lets use it - stu */
-  strlcpy(client->sockhost, buf, sizeof(client->sockhost));
+  intern_set(&client->sockhost, buf, HOSTIPLEN);
 
   client->ip = *conf->addr;
   client->connection->fd = fd_open(fd, true, NULL);
@@ -0,0 +1,239 @@
+/*
+ *  ircd-hybrid: an advanced, lightweight Internet Relay Chat Daemon (ircd)
+ *
+ *  Copyright (c) 1997-2022 ircd-hybrid development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ *  USA
+ */
+
+/*! \file timer.c
+ * \brief A hierarchical timer wheel with millisecond resolution.
+ * \version $Id$
+ *
+ * The wheel consists of a root level of 256 one millisecond buckets,
+ * followed by four levels of 64 buckets each, every level covering
+ * 64 times the span of the one below it. A timer is linked into the
+ * bucket of the lowest level whose span covers its expiry time, so adding
+ * and deleting it is O(1). Whenever the root level wraps around, the next
+ * bucket of the level above is emptied and its timers are redistributed
+ * into the levels below. timer_run() only ever looks at the buckets whose
+ * time has come.
+ */
+
+#include "stdinc.h"
+#include "list.h"
+#include "timer.h"
+#include "event.h"
+#include "misc.h"
+
+
+enum
+{
+  TIMER_ROOT_BITS = 8,
+  TIMER_LEVEL_BITS = 6,
+  TIMER_ROOT_SIZE = 1 << TIMER_ROOT_BITS,
+  TIMER_LEVEL_SIZE = 1 << TIMER_LEVEL_BITS,
+  TIMER_LEVELS = 4
+};
+
+/* Timers can't be set further in the future than the wheel covers, roughly 49 days */
+static const uintmax_t TIMER_SPAN_MAX = ((uintmax_t)1 << (TIMER_ROOT_BITS + TIMER_LEVELS * TIMER_LEVEL_BITS)) - 1;
+
+static dlink_list timer_root[TIMER_ROOT_SIZE];
+static dlink_list timer_level[TIMER_LEVELS][TIMER_LEVEL_SIZE];
+static uintmax_t timer_clock;  /* Time of the next root bucket to be run */
+static unsigned int timer_count;  /* Number of timers linked into the wheel */
+
+
+static void
+timer_link(struct timer *timer)
+{
+  const uintmax_t delta = timer->expires - timer_clock;
+  dlink_list *list;
+
+  if (delta < TIMER_ROOT_SIZE)
+    list = &timer_root[timer->expires & (TIMER_ROOT_SIZE - 1)];
+  else
+  {
+    unsigned int level = 0;
+    unsigned int shift = TIMER_ROOT_BITS;
+
+    while (level < TIMER_LEVELS - 1 && (delta >> (shift + TIMER_LEVEL_BITS)))
+    {
+      ++level;
+      shift += TIMER_LEVEL_BITS;
+    }
+
+    list = &timer_level[level][(timer->expires >> shift) & (TIMER_LEVEL_SIZE - 1)];
+  }
+
+  timer->bucket = list;
+  dlinkAdd(timer, &timer->node, list);
+}
+
+/*
+ * timer_cascade
+ *      Redistributes the timers of the given bucket of 'level' into the
+ *      levels below. Returns the index of that bucket, which is zero when
+ *      'level' itself has wrapped around.
+ */
+static unsigned int
+timer_cascade(unsigned int level)
+{
+  const unsigned int shift = TIMER_ROOT_BITS + level * TIMER_LEVEL_BITS;
+  const unsigned int index = (timer_clock >> shift) & (TIMER_LEVEL_SIZE - 1);
+  dlink_list *const list = &timer_level[level][index];
+
+  while (list->head)
+  {
+    struct timer *timer = list->head->data;
+
+    dlinkDelete(&timer->node, list);
+    timer_link(timer);
+  }
+
+  return index;
+}
+
+/*
+ * timer_add
+ *      Arms 'timer' to call handler(data) once 'delay' milliseconds have
+ *      passed. A timer that is already active is re-armed.
+ */
+void
+timer_add(struct timer *timer, uintmax_t delay, void (*handler)(void *), void *data)
+{
+  timer_del(timer);
+
+  /* Never link into the bucket that is currently being run */
+  if (delay == 0)
+    delay = 1;
+  if (delay > TIMER_SPAN_MAX)
+    delay = TIMER_SPAN_MAX;
+
+  timer->handler = handler;
+  timer->data = data;
+  timer->expires = IRCD_MAX(timer_clock, event_base->time.msec_monotonic) + delay;
+
+  timer_link(timer);
+  ++timer_count;
+}
+
+void
+timer_del(struct timer *timer)
+{
+  if (timer->bucket == NULL)
+    return;
+
+  dlinkDelete(&timer->node, timer->bucket);
+  timer->bucket = NULL;
+  --timer_count;
+}
+
+/*
+ * timer_run
+ *      Advances the wheel up to the current time and calls the handlers
+ *      of all timers that have expired on the way.
+ */
+void
+timer_run(void)
+{
+  const uintmax_t now = event_base->time.msec_monotonic;
+
+  while (timer_clock <= now)
+  {
+    if (timer_count == 0)
+    {
+      /* Nothing to cascade or run; skip ahead */
+      timer_clock = now + 1;
+      break;
+    }
+
+    const unsigned int index = timer_clock & (TIMER_ROOT_SIZE - 1);
+
+    if (index == 0)
+      for (unsigned int level = 0; level < TIMER_LEVELS; ++level)
+        if (timer_cascade(level))
+          break;
+
+    /* Timers armed by the handlers below can't end up in this bucket anymore */
+    ++timer_clock;
+
+    dlink_list *const list = &timer_root[index];
+    while (list->head)
+    {
+      struct timer *timer = list->head->data;
+
+      timer_del(timer);
+      timer->handler(timer->data);
+    }
+  }
+}
+
+/*
+ * timer_next
+ *      Returns the number of milliseconds until timer_run() has work to
+ *      do: either a non-empty root bucket comes up, or timers have to be
+ *      cascaded down from the levels above. Returns UINTMAX_MAX if no
+ *      timer is armed at all.
+ */
+uintmax_t
+timer_next(void)
+{
+  if (timer_count == 0)
+    return UINTMAX_MAX;
+
+  uintmax_t next = UINTMAX_MAX;
+
+  /* Timers in the root level all expire within one rotation */
+  for (uintmax_t t = timer_clock; t < timer_clock + TIMER_ROOT_SIZE; ++t)
+  {
+    if (timer_root[t & (TIMER_ROOT_SIZE - 1)].head)
+    {
+      next = t;
+      break;
+    }
+  }
+
+  /*
+   * Find the next time the root level wraps around and has something to
+   * cascade. Anything above the first level only ever gets cascaded when
+   * the first level wraps around as well.
+   */
+  uintmax_t wrap = (timer_clock + TIMER_ROOT_SIZE - 1) & ~(uintmax_t)(TIMER_ROOT_SIZE - 1);
+
+  for (; wrap < next; wrap += TIMER_ROOT_SIZE)
+  {
+    const unsigned int index = (wrap >> TIMER_ROOT_BITS) & (TIMER_LEVEL_SIZE - 1);
+
+    if (index == 0 || timer_level[0][index].head)
+    {
+      next = wrap;
+      break;
+    }
+  }
+
+  if (next <= event_base->time.msec_monotonic)
+    return 0;
+
+  return next - event_base->time.msec_monotonic;
+}
+
+void
+timer_init(void)
+{
+  timer_clock = event_base->time.msec_monotonic;
+}
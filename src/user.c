@@ -30,6 +30,7 @@
 #include "channel.h"
 #include "channel_mode.h"
 #include "client.h"
+#include "intern.h"
 #include "hash.h"
 #include "id.h"
 #include "irc_string.h"
@@ -51,6 +52,7 @@
 #include "isupport.h"
 #include "tls.h"
 #include "patchlevel.h"
+#include "scan.h"
 
 static char umode_buffer[UMODE_MAX_STR];
 
@@ -304,7 +306,7 @@ register_local_user(struct Client *client)
 
   if (valid_username(client->username, true) == false)
   {
-    char buf[sizeof("Invalid username []") + sizeof(client->username)];
+    char buf[sizeof("Invalid username []") + USERLEN];
 
     sendto_realops_flags(UMODE_REJ, L_ALL, SEND_NOTICE,
                          "Invalid username: %s (%s@%s)",
@@ -392,6 +394,7 @@ register_local_user(struct Client *client)
   }
 
   SetClient(client);
+  client_ping_schedule(client);
 
   client->servptr = &me;
   client->connection->last_privmsg = event_base->time.sec_monotonic;
@@ -522,31 +525,29 @@ valid_username(const char *username, bool local)
   if (!IsAlNum(*p))
     return false;
 
+  const size_t len = strlen(p);
+
+  if ((size_t)(p - username) + len > USERLEN)
+    return false;
+
   if (local)
   {
     unsigned int special = 0;
 
-    while (*p)
-    {
-      if (*p == '-' || *p == '_' || *p == '.')
-      {
-        if (ConfigGeneral.specials_in_ident < ++special)
-          return false;
-      }
-      else if (!IsUser2Char(*p))
-        return false;
+    if (scan_span(p, len, &scan_set_ident) != len)
+      return false;
 
-      ++p;
-    }
+    for (const char *end = p + len; (p = scan_find(p, end - p, &scan_set_ident_special)); ++p)
+      if (ConfigGeneral.specials_in_ident < ++special)
+        return false;
   }
   else
   {
-    while (*++p)
-      if (!IsUserChar(*p))
-        return false;
+    if (scan_span(p + 1, len - 1, &scan_set_user) != len - 1)
+      return false;
   }
 
-  return p - username <= USERLEN;
+  return true;
 }
 
 /* clean_nick_name()
@@ -569,11 +570,12 @@ valid_nickname(const char *nickname, bool local)
   if (EmptyString(p) || *p == '-' || (IsDigit(*p) && local))
     return false;
 
-  for (; *p; ++p)
-    if (!IsNickChar(*p))
-      return false;
+  const size_t len = strlen(p);
 
-  return p - nickname <= NICKLEN;
+  if (len > NICKLEN)
+    return false;
+
+  return scan_span(p, len, &scan_set_nick) == len;
 }
 
 /*! \brief Builds a mode change string to buffer pointed by \a buf
@@ -660,13 +662,11 @@ user_set_hostmask(struct Client *client, const char *hostname)
                                client->name, client->username,
                                client->host, client->username, hostname);
 
-  strlcpy(client->host, hostname, sizeof(client->host));
+  intern_set(&client->host, hostname, HOSTLEN);
+  clear_ban_cache_client(client);
 
   if (MyConnect(client))
-  {
     sendto_one_numeric(client, &me, RPL_VISIBLEHOST, client->host);
-    clear_ban_cache_list(&client->channel);
-  }
 
   if (ConfigGeneral.cycle_on_host_change == 0)
     return;
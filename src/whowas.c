@@ -22,6 +22,17 @@
 /*! \file whowas.c
  * \brief WHOWAS user cache.
  * \version $Id$
+ *
+ * The history is a ring of ConfigGeneral.whowas_history_length entries
+ * allocated up front; every nick change or quit overwrites the oldest
+ * one. Entries are numbered in the order they were made, and an entry
+ * numbered seq lives in slot seq % capacity, so the ring never has to be
+ * searched and entries can refer to each other by number: each one holds
+ * the number of the previous entry for the same name, and a number whose
+ * slot has since been overwritten simply ends the chain.
+ *
+ * The newest entry of every name is indexed in a table in hash.c. Strings
+ * are interned, so an entry is small and needs no allocation.
  */
 
 #include "stdinc.h"
@@ -33,78 +44,122 @@
 #include "irc_string.h"
 #include "ircd.h"
 #include "conf.h"
+#include "misc.h"
+#include "intern.h"
 
 
-static dlink_list whowas_list;  /*! Chain of struct Whowas pointers */
-static dlink_list whowas_hash[HASHSIZE];
+static struct Whowas *whowas_ring;
+static unsigned int whowas_capacity;  /* Number of slots in whowas_ring */
+static unsigned int whowas_count;  /* Number of slots in use */
+static uintmax_t whowas_seq;  /* Whowas::seq of the newest entry */
 
 
-/*! \brief Returns a slot of the whowas_hash by the hash value associated with it.
- * \param hash_value Hash value.
+/*! \brief Returns the entry numbered seq, or NULL if it has been overwritten
+ * \param seq Whowas::seq of the entry
  */
-const dlink_list *
-whowas_get_hash(unsigned int hash_value)
+static struct Whowas *
+whowas_lookup(uintmax_t seq)
 {
-  if (hash_value >= HASHSIZE)
+  if (seq == 0)
+    return NULL;
+
+  struct Whowas *whowas = &whowas_ring[seq % whowas_capacity];
+  if (whowas->seq != seq)
     return NULL;
 
-  return &whowas_hash[hash_value];
+  return whowas;
 }
 
-/*! \brief Unlinks a Whowas struct from its associated lists.
- * \param whowas Pointer to Whowas struct to be unlinked.
+/*! \brief Makes an entry the newest one for its name in the index.
+ * \param whowas Pointer to Whowas struct
  */
-static struct Whowas *
-whowas_unlink(struct Whowas *whowas)
+static void
+whowas_link(struct Whowas *whowas)
 {
-  if (whowas->client)
-    dlinkDelete(&whowas->client_list_node, &whowas->client->whowas_list);
+  struct Whowas *prev = hash_find_whowas(whowas->name);
 
-  dlinkDelete(&whowas->hash_node, &whowas_hash[whowas->hash_value]);
-  dlinkDelete(&whowas->list_node, &whowas_list);
+  if (prev)
+  {
+    whowas->next = prev->seq;
+    hash_del_whowas(prev);
+  }
+  else
+    whowas->next = 0;
 
-  return whowas;
+  hash_add_whowas(whowas);
+
+  if (whowas->client)
+    dlinkAdd(whowas, &whowas->client_list_node, &whowas->client->whowas_list);
 }
 
-/*! \brief Unlinks a Whowas struct from its associated lists
- *         and frees memory.
- * \param whowas Pointer to Whowas struct to be unlinked and freed.
+/*! \brief Removes an entry from the index and from its client's list.
+ * \param whowas Pointer to Whowas struct
  */
 static void
-whowas_free(struct Whowas *whowas)
+whowas_unlink(struct Whowas *whowas)
 {
-  whowas_unlink(whowas);
-  xfree(whowas);
+  if (hash_find_whowas(whowas->name) == whowas)
+    hash_del_whowas(whowas);
+
+  if (whowas->client)
+    dlinkDelete(&whowas->client_list_node, &whowas->client->whowas_list);
 }
 
-/*! \brief Returns a Whowas struct for further use. Either allocates
- *         a new one, or returns the oldest entry from the whowas_list
- *         if it ran over ConfigGeneral.whowas_history_length
+/*! \brief Drops the references a Whowas struct holds on interned strings.
+ * \param whowas Pointer to Whowas struct
  */
-static struct Whowas *
-whowas_make(void)
+static void
+whowas_release(struct Whowas *whowas)
 {
-  struct Whowas *whowas;
-
-  if (dlink_list_length(&whowas_list) &&
-      dlink_list_length(&whowas_list) >= ConfigGeneral.whowas_history_length)
-    whowas = whowas_unlink(whowas_list.tail->data);  /* Re-use oldest item */
-  else
-    whowas = xcalloc(sizeof(*whowas));
-
-  return whowas;
+  intern_release(whowas->name);
+  intern_release(whowas->account);
+  intern_release(whowas->username);
+  intern_release(whowas->hostname);
+  intern_release(whowas->realhost);
+  intern_release(whowas->sockhost);
+  intern_release(whowas->realname);
+  intern_release(whowas->servername);
 }
 
-/*! \brief Trims the whowas_list if necessary until there are no
- *         more than ConfigGeneral.whowas_history_length Whowas
- *         struct items.
+/*! \brief Resizes the ring to ConfigGeneral.whowas_history_length entries,
+ *         keeping as many of the newest entries as fit.
  */
 void
-whowas_trim(void)
+whowas_resize(void)
 {
-  while (dlink_list_length(&whowas_list) &&
-         dlink_list_length(&whowas_list) >= ConfigGeneral.whowas_history_length)
-    whowas_free(whowas_list.tail->data);
+  const unsigned int capacity = IRCD_MAX(ConfigGeneral.whowas_history_length, 1);
+
+  if (capacity == whowas_capacity)
+    return;
+
+  const unsigned int keep = IRCD_MIN(whowas_count, capacity);
+  struct Whowas *ring = xcalloc(capacity * sizeof(*ring));
+
+  for (uintmax_t seq = whowas_seq - whowas_count + 1; seq <= whowas_seq; ++seq)
+  {
+    struct Whowas *whowas = whowas_lookup(seq);
+
+    whowas_unlink(whowas);
+
+    if (seq + keep <= whowas_seq)
+      whowas_release(whowas);
+  }
+
+  for (uintmax_t seq = whowas_seq - keep + 1; seq <= whowas_seq; ++seq)
+  {
+    struct Whowas *whowas = &ring[seq % capacity];
+
+    *whowas = whowas_ring[seq % whowas_capacity];
+    whowas->client_list_node.prev = whowas->client_list_node.next = NULL;
+  }
+
+  xfree(whowas_ring);
+  whowas_ring = ring;
+  whowas_capacity = capacity;
+  whowas_count = keep;
+
+  for (uintmax_t seq = whowas_seq - keep + 1; seq <= whowas_seq; ++seq)
+    whowas_link(whowas_lookup(seq));
 }
 
 /*! \brief Adds the currently defined name of the client to history.
@@ -116,33 +171,35 @@ whowas_trim(void)
 void
 whowas_add_history(struct Client *client, bool online)
 {
-  struct Whowas *whowas = whowas_make();
-
   assert(IsClient(client));
+  assert(whowas_capacity);
 
-  whowas->hash_value = strhash(client->name);
-  whowas->logoff = event_base->time.sec_real;
-  whowas->server_hidden = IsHidden(client->servptr) != 0;
-
-  strlcpy(whowas->account, client->account, sizeof(whowas->account));
-  strlcpy(whowas->name, client->name, sizeof(whowas->name));
-  strlcpy(whowas->username, client->username, sizeof(whowas->username));
-  strlcpy(whowas->hostname, client->host, sizeof(whowas->hostname));
-  strlcpy(whowas->realhost, client->realhost, sizeof(whowas->realhost));
-  strlcpy(whowas->sockhost, client->sockhost, sizeof(whowas->sockhost));
-  strlcpy(whowas->realname, client->info, sizeof(whowas->realname));
-  strlcpy(whowas->servername, client->servptr->name, sizeof(whowas->servername));
+  struct Whowas *whowas = &whowas_ring[++whowas_seq % whowas_capacity];
 
-  if (online == true)
+  if (whowas->seq)
   {
-    whowas->client = client;
-    dlinkAdd(whowas, &whowas->client_list_node, &client->whowas_list);
+    whowas_unlink(whowas);
+    whowas_release(whowas);
   }
   else
-    whowas->client = NULL;
+    ++whowas_count;
 
-  dlinkAdd(whowas, &whowas->hash_node, &whowas_hash[whowas->hash_value]);
-  dlinkAdd(whowas, &whowas->list_node, &whowas_list);
+  whowas->seq = whowas_seq;
+  whowas->hash = client->name_hash;
+  whowas->logoff = event_base->time.sec_real;
+  whowas->server_hidden = IsHidden(client->servptr) != 0;
+
+  whowas->name = intern_string(client->name, NICKLEN);
+  whowas->account = intern_ref(client->account);
+  whowas->username = intern_ref(client->username);
+  whowas->hostname = intern_ref(client->host);
+  whowas->realhost = intern_ref(client->realhost);
+  whowas->sockhost = intern_ref(client->sockhost);
+  whowas->realname = intern_string(client->info, REALLEN);
+  whowas->servername = intern_string(client->servptr->name, HOSTLEN);
+  whowas->client = online == true ? client : NULL;
+
+  whowas_link(whowas);
 }
 
 /*! \brief This must be called when the client structure is about to
@@ -171,29 +228,44 @@ whowas_off_history(struct Client *client)
 struct Client *
 whowas_get_history(const char *name, uintmax_t timelimit)
 {
-  dlink_node *node;
+  const struct Whowas *whowas = hash_find_whowas(name);
 
-  timelimit = event_base->time.sec_real - timelimit;
+  if (whowas == NULL || whowas->logoff < event_base->time.sec_real - timelimit)
+    return NULL;
 
-  DLINK_FOREACH(node, whowas_hash[strhash(name)].head)
-  {
-    struct Whowas *whowas = node->data;
+  return whowas->client;
+}
 
-    if (whowas->logoff < timelimit)
-      continue;
-    if (irccmp(name, whowas->name))
-      continue;
-    return whowas->client;
-  }
+/*! \brief Returns the newest entry for a nick name, or NULL if there is none.
+ * \param name Name of the nick
+ */
+const struct Whowas *
+whowas_find(const char *name)
+{
+  return hash_find_whowas(name);
+}
 
-  return NULL;
+/*! \brief Returns the entry made for the same nick name before the given
+ *         one, or NULL if there is none left.
+ * \param whowas Pointer to Whowas struct
+ */
+const struct Whowas *
+whowas_next(const struct Whowas *whowas)
+{
+  return whowas_lookup(whowas->next);
 }
 
-/*! \brief For debugging. Counts allocated structures stored in whowas_list
+/*! \brief For debugging. Counts the entries in use and the memory taken
+ *         by the ring and its index; the strings are counted by the
+ *         intern pool.
  */
 void
 whowas_count_memory(unsigned int *const count, size_t *const bytes)
 {
-  (*count) = dlink_list_length(&whowas_list);
-  (*bytes) = dlink_list_length(&whowas_list) * sizeof(struct Whowas);
+  struct hash_stats stats;
+
+  hash_get_stats(HASH_TYPE_WHOWAS, &stats);
+
+  (*count) = whowas_count;
+  (*bytes) = whowas_capacity * sizeof(struct Whowas) + stats.memory;
 }
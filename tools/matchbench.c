@@ -0,0 +1,365 @@
+/*
+ *  ircd-hybrid: an advanced, lightweight Internet Relay Chat Daemon (ircd)
+ *
+ *  Copyright (c) 1997-2022 ircd-hybrid development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ *  USA
+ */
+
+
+/*! \file matchbench.c
+ * \brief Checks match_compiled() against match() and times both.
+ * \version $Id$
+ *
+ * Build with "make matchbench" in this directory; the program is not
+ * installed. Random masks and subjects are first run through both
+ * functions, which must agree, then both are timed on masks shaped like
+ * the ircd's own: channel bans, K-lines, X-lines and RESVs, against
+ * nicks, hosts and real names. Finally match_set_find() is checked
+ * against a walk of the same masks, and both are timed on growing
+ * numbers of X-lines.
+ */
+
+#include "stdinc.h"
+#include "irc_string.h"
+#include "memory.h"
+#include "match_set.h"
+
+enum { CHECK_ROUNDS = 2000000 };
+enum { SET_MAX = 20000 };
+
+/*
+ * match_mask.c and match_set.c allocate and link through these; the rest
+ * of memory.c and list.c isn't needed here
+ */
+void *
+xcalloc(size_t size)
+{
+  void *ret = calloc(1, size);
+
+  if (ret == NULL)
+    abort();
+
+  return ret;
+}
+
+void *
+xrealloc(void *ptr, size_t size)
+{
+  void *ret = realloc(ptr, size);
+
+  if (ret == NULL)
+    abort();
+
+  return ret;
+}
+
+void
+xfree(void *ptr)
+{
+  free(ptr);
+}
+
+void
+dlinkAdd(void *data, dlink_node *m, dlink_list *list)
+{
+  m->data = data;
+  m->prev = NULL;
+  m->next = list->head;
+
+  if (list->head)
+    list->head->prev = m;
+  else
+    list->tail = m;
+
+  list->head = m;
+  ++list->length;
+}
+
+void
+dlinkDelete(dlink_node *m, dlink_list *list)
+{
+  if (m->next)
+    m->next->prev = m->prev;
+  else
+    list->tail = m->prev;
+
+  if (m->prev)
+    m->prev->next = m->next;
+  else
+    list->head = m->next;
+
+  m->next = m->prev = NULL;
+  --list->length;
+}
+
+/* An X-line as far as the set is concerned */
+struct set_item
+{
+  struct match_set_entry entry;
+  struct match_mask *mm;
+  char mask[32];
+  bool used;
+};
+
+static struct set_item set_items[SET_MAX];
+
+static double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+random_string(char *s, size_t len, const char *alphabet)
+{
+  const size_t n = strlen(alphabet);
+
+  for (size_t i = 0; i < len; ++i)
+    s[i] = alphabet[rand() % n];
+  s[len] = '\0';
+}
+
+static bool
+check(void)
+{
+  char mask[32], name[32];
+
+  for (unsigned int round = 0; round < CHECK_ROUNDS; ++round)
+  {
+    /* Small alphabets, so that masks and subjects actually overlap */
+    random_string(mask, rand() % 12, round & 1 ? "ab*?A[{" : "aB*?.\\");
+    random_string(name, rand() % 16, "abAB[{.*?\\");
+
+    /* match() reads past the end of a mask ending in a lone backslash */
+    for (size_t len = strlen(mask); len && mask[len - 1] == '\\'; --len)
+      mask[len - 1] = '\0';
+
+    struct match_mask *mm = match_compile(mask);
+    const bool expected = match(mask, name) == 0;
+    const bool got = match_compiled(mm, name) == 0;
+
+    match_mask_free(mm);
+
+    if (expected != got)
+    {
+      fprintf(stderr, "mismatch: mask \"%s\" name \"%s\": match() %d, match_compiled() %d\n",
+              mask, name, expected, got);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/*! \brief Returns what match_set_find() should: the match added last */
+static struct set_item *
+set_walk(unsigned int count, const char *name)
+{
+  struct set_item *found = NULL;
+
+  for (unsigned int i = 0; i < count; ++i)
+    if (set_items[i].used && match_compiled(set_items[i].mm, name) == 0)
+      if (found == NULL || set_items[i].entry.seq > found->entry.seq)
+        found = &set_items[i];
+
+  return found;
+}
+
+static void
+set_put(struct match_set *set, struct set_item *item, const char *mask)
+{
+  snprintf(item->mask, sizeof(item->mask), "%s", mask);
+  item->mm = match_compile(item->mask);
+  item->used = true;
+  match_set_add(set, &item->entry, item->mask, item->mm, item);
+}
+
+static void
+set_drop(struct match_set *set, struct set_item *item)
+{
+  match_set_del(set, &item->entry);
+  match_mask_free(item->mm);
+  item->used = false;
+}
+
+static bool
+set_check(void)
+{
+  struct match_set set = { .node = NULL };
+  const unsigned int count = 300;
+  char mask[24], name[32];
+
+  for (unsigned int round = 0; round < CHECK_ROUNDS / 4; ++round)
+  {
+    struct set_item *const item = &set_items[rand() % count];
+
+    /* Keep adding, replacing and removing masks while checking */
+    if (item->used)
+      set_drop(&set, item);
+
+    if (rand() % 4)
+    {
+      random_string(mask, rand() % 8, round & 1 ? "abc*?" : "aBc*?.\\");
+
+      for (size_t len = strlen(mask); len && mask[len - 1] == '\\'; --len)
+        mask[len - 1] = '\0';
+
+      set_put(&set, item, mask);
+    }
+
+    random_string(name, rand() % 20, "abcABC.*?\\");
+
+    const struct set_item *const expected = set_walk(count, name);
+    const struct set_item *const got = match_set_find(&set, name);
+
+    if (expected != got)
+    {
+      fprintf(stderr, "mismatch: name \"%s\": walk \"%s\", match_set_find() \"%s\"\n",
+              name, expected ? expected->mask : "", got ? got->mask : "");
+      return false;
+    }
+  }
+
+  for (unsigned int i = 0; i < count; ++i)
+    if (set_items[i].used)
+      set_drop(&set, &set_items[i]);
+
+  xfree(set.node);
+  return true;
+}
+
+static void
+set_bench(const char *const *names)
+{
+  static const char *const words[] =
+  {
+    "spam", "join", "free", "casino", "bot", "warez", "click", "prize", "irc",
+    "crypto", "deal", "offer", "win", "cash", "now", "here", "best", "xxx", NULL
+  };
+
+  const unsigned int rounds = 200000;
+  unsigned int words_count = 0, names_count = 0, sink = 0;
+  struct match_set set = { .node = NULL };
+
+  while (words[words_count])
+    ++words_count;
+  while (names[names_count])
+    ++names_count;
+
+  printf("\nns/op      %-28s %8s %8s %8s\n", "X-lines", "walk", "set", "speedup");
+
+  for (unsigned int count = 0, step = 10; step <= SET_MAX; step *= 10)
+  {
+    for (; count < step; ++count)
+    {
+      char mask[32];
+
+      snprintf(mask, sizeof(mask), "*%s%u*%s*", words[rand() % words_count], count,
+               words[rand() % words_count]);
+      set_put(&set, &set_items[count], mask);
+    }
+
+    double start = now();
+    for (unsigned int i = 0; i < rounds / step * 10; ++i)
+      sink += set_walk(count, names[i % names_count]) != NULL;
+    const double walk = (now() - start) * 1e9 / (rounds / step * 10);
+
+    start = now();
+    for (unsigned int i = 0; i < rounds; ++i)
+      sink += match_set_find(&set, names[i % names_count]) != NULL;
+    const double found = (now() - start) * 1e9 / rounds;
+
+    printf("%-10s %-28u %8.1f %8.1f %7.1fx\n", "xline", count, walk, found, walk / found);
+  }
+
+  if (sink == UINT_MAX)
+    puts("");
+}
+
+static void
+bench(const char *what, const char *mask, const char *const *names)
+{
+  const unsigned int rounds = 5000000;
+  struct match_mask *mm = match_compile(mask);
+  unsigned int count = 0, sink = 0;
+  double start, interp, compiled;
+
+  while (names[count])
+    ++count;
+
+  start = now();
+  for (unsigned int i = 0; i < rounds; ++i)
+    sink += match(mask, names[i % count]);
+  interp = (now() - start) * 1e9 / rounds;
+
+  start = now();
+  for (unsigned int i = 0; i < rounds; ++i)
+    sink += match_compiled(mm, names[i % count]);
+  compiled = (now() - start) * 1e9 / rounds;
+
+  printf("%-10s %-28s %8.1f %8.1f %7.1fx\n", what, mask, interp, compiled, interp / compiled);
+
+  match_mask_free(mm);
+
+  if (sink == UINT_MAX)
+    puts("");
+}
+
+int
+main(void)
+{
+  static const char *const nicks[] =
+  {
+    "Hybrid", "someone", "Guest12345", "[bot]irc", "nickserv", "Zz_sleepy", NULL
+  };
+
+  static const char *const hosts[] =
+  {
+    "cpe-98-76-54-32.res.example.com", "user/someone/cloak", "203.0.113.77",
+    "2001:db8:1234:5678:9abc:def0:1234:5678", "host-9.dsl.provider.example.net",
+    "irc.example.org", NULL
+  };
+
+  static const char *const gecos[] =
+  {
+    "Some Person", "https://example.com/spam/join-now", "ircII 20210314",
+    "*Unknown*", "realname of a very long winded user with many words", NULL
+  };
+
+  if (check() == false || set_check() == false)
+    return EXIT_FAILURE;
+
+  printf("ns/op      %-28s %8s %8s %8s\n", "mask", "match", "compiled", "speedup");
+
+  bench("ban nick", "*", nicks);
+  bench("ban nick", "Guest*", nicks);
+  bench("ban host", "*.example.com", hosts);
+  bench("ban host", "203.0.113.*", hosts);
+  bench("kline", "*.dsl.provider.example.net", hosts);
+  bench("kline", "irc.example.org", hosts);
+  bench("kline", "*cpe-*.res.*", hosts);
+  bench("xline", "*spam*join*", gecos);
+  bench("xline", "*Unknown?", gecos);
+  bench("resv", "#*warez*", nicks);
+
+  set_bench(gecos);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+/*
+ *  ircd-hybrid: an advanced, lightweight Internet Relay Chat Daemon (ircd)
+ *
+ *  Copyright (c) 1997-2022 ircd-hybrid development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ *  USA
+ */
+
+/*! \file scanbench.c
+ * \brief Checks the scan.c kernels against each other and times them.
+ * \version $Id$
+ *
+ * Build with "make scanbench" in this directory; the program is not
+ * installed. Every kernel supported by the CPU is first compared with the
+ * generic one on random input, then timed on buffers shaped like the
+ * ircd's own workload: whole recvq blocks searched for an EOL, protocol
+ * lines split into tokens, channel messages checked for control codes,
+ * and nicknames validated.
+ */
+
+#include "stdinc.h"
+#include "irc_string.h"
+#include "scan.h"
+
+enum { BUFFER_SIZE = 4096 };
+enum { CHECK_ROUNDS = 200000 };
+
+static const char *const kernels[] = { "generic", "ssse3", "avx2", NULL };
+
+static char buffer[BUFFER_SIZE + 1];
+
+static double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+fill(char *s, size_t len, const char *alphabet)
+{
+  const size_t n = strlen(alphabet);
+
+  for (size_t i = 0; i < len; ++i)
+    s[i] = alphabet[rand() % n];
+}
+
+static bool
+check(const char *kernel)
+{
+  const struct scan_set *const sets[] =
+  {
+    &scan_set_eol, &scan_set_token, &scan_set_nick, &scan_set_user,
+    &scan_set_ident, &scan_set_ident_special
+  };
+
+  for (unsigned int round = 0; round < CHECK_ROUNDS; ++round)
+  {
+    const size_t len = rand() % 200;
+    const size_t off = rand() % 32;
+    const struct scan_set *set = sets[rand() % (sizeof(sets) / sizeof(sets[0]))];
+    const unsigned int bias = rand() % 4;
+
+    for (size_t i = 0; i < len; ++i)
+      buffer[off + i] = bias ? "abcXYZ019[]-_. \r\n\001\033:"[rand() % 21] : rand();
+
+    scan_set_kernel("generic");
+    const char *find = scan_find(buffer + off, len, set);
+    const size_t span = scan_span(buffer + off, len, set);
+    const char *ctrl = scan_find_ctrl(buffer + off, len);
+
+    scan_set_kernel(kernel);
+    if (scan_find(buffer + off, len, set) != find ||
+        scan_span(buffer + off, len, set) != span ||
+        scan_find_ctrl(buffer + off, len) != ctrl)
+    {
+      fprintf(stderr, "%s: mismatch at round %u (len %zu, offset %zu)\n", kernel, round, len, off);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void
+bench(const char *kernel)
+{
+  const unsigned int rounds = 2000000;
+  size_t sink = 0;
+  double start;
+
+  scan_set_kernel(kernel);
+  printf("%-8s", kernel);
+
+  /* EOL search over a full recvq block holding one long line */
+  fill(buffer, BUFFER_SIZE, "abcdefghijklmnopqrstuvwxyz :#");
+  buffer[BUFFER_SIZE - 2] = '\r';
+  start = now();
+  for (unsigned int i = 0; i < rounds / 8; ++i)
+    sink += scan_find(buffer + (i & 7), BUFFER_SIZE - 8, &scan_set_eol) - buffer;
+  printf(" %10.1f", (now() - start) * 1e9 / (rounds / 8));
+
+  /* Tokenizing a server-to-server PRIVMSG */
+  strcpy(buffer, ":0AAAAAAAB PRIVMSG #somechannel :the quick brown fox jumps over the lazy dog "
+                 "the quick brown fox jumps over the lazy dog the quick brown fox jumps over");
+  const size_t line_len = strlen(buffer);
+  start = now();
+  for (unsigned int i = 0; i < rounds; ++i)
+  {
+    const char *p = buffer, *end = buffer + line_len;
+
+    for (unsigned int tok = 0; tok < 3; ++tok)
+    {
+      p = scan_find(p, end - p, &scan_set_token);
+      sink += p - buffer;
+      ++p;
+    }
+  }
+  printf(" %10.1f", (now() - start) * 1e9 / rounds);
+
+  /* Control code check on a 400 byte channel message */
+  fill(buffer, 400, "abcdefghijklmnopqrstuvwxyz ,.!?");
+  start = now();
+  for (unsigned int i = 0; i < rounds; ++i)
+    sink += scan_find_ctrl(buffer, 400 - (i & 1)) == NULL;
+  printf(" %10.1f", (now() - start) * 1e9 / rounds);
+
+  /* Nickname validation */
+  strcpy(buffer, "Some_Long[Nick]name");
+  start = now();
+  for (unsigned int i = 0; i < rounds; ++i)
+    sink += scan_span(buffer, 19 - (i & 1), &scan_set_nick);
+  printf(" %10.1f\n", (now() - start) * 1e9 / rounds);
+
+  if (sink == 0)
+    puts("");
+}
+
+int
+main(void)
+{
+  scan_init();
+  printf("selected kernel: %s\n\n", scan_get_kernel());
+
+  for (const char *const *kernel = kernels; *kernel; ++kernel)
+  {
+    if (scan_set_kernel(*kernel) == false)
+      continue;
+
+    if (check(*kernel) == false)
+      return EXIT_FAILURE;
+  }
+
+  printf("ns/op    %10s %10s %10s %10s\n", "eol/4k", "tokens", "ctrl/400", "nick/19");
+
+  for (const char *const *kernel = kernels; *kernel; ++kernel)
+    if (scan_set_kernel(*kernel))
+      bench(*kernel);
+
+  return EXIT_SUCCESS;
+}